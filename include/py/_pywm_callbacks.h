@@ -2,6 +2,24 @@
 #define _PYWM_CALLBACKS_H
 
 #include <Python.h>
+#include <stdint.h>
+
+#include "py/_pywm_queue.h"
+
+/* Power of two */
+#define _PYWM_KEYS_QUEUE_SIZE 64
+#define _PYWM_KEYS_LENGTH 256
+
+/* Slots only releases may use - presses of bound keys are passed on to clients if they would need them */
+#define _PYWM_KEYS_QUEUE_RESERVED 16
+
+/* Keys matching a keybinding - handed to python without waiting for it */
+struct _pywm_key_event {
+    uint32_t time_msec;
+    uint32_t keycode;
+    int state;
+    char keysyms[_PYWM_KEYS_LENGTH];
+};
 
 struct _pywm_callbacks {
     PyObject* ready;
@@ -12,6 +30,8 @@ struct _pywm_callbacks {
     PyObject* key;
     PyObject* modifiers;
     PyObject* gesture;
+    PyObject* idle;
+    PyObject* render_quality;
 
     PyObject* update_view;
     PyObject* destroy_view;
@@ -22,6 +42,8 @@ struct _pywm_callbacks {
     PyObject* query_destroy_widget;
 
     PyObject* update;
+
+    struct _pywm_queue keys; // _pywm_key_event
 };
 
 void _pywm_callbacks_init();
@@ -29,4 +51,7 @@ PyObject** _pywm_callbacks_get(const char* name);
 
 struct _pywm_callbacks* _pywm_callbacks_get_all();
 
+/* Python thread holding the GIL - list of (time_msec, keycode, state, keysyms) as passed to the key callback */
+PyObject* _pywm_callbacks_pop_keys();
+
 #endif
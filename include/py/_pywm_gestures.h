@@ -0,0 +1,77 @@
+#ifndef _PYWM_GESTURES_H
+#define _PYWM_GESTURES_H
+
+#include <Python.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "py/_pywm_queue.h"
+
+/* Power of two */
+#define _PYWM_GESTURES_QUEUE_SIZE 256
+
+enum _pywm_gesture_kind {
+    _PYWM_GESTURE_PINCH,
+    _PYWM_GESTURE_SWIPE,
+    _PYWM_GESTURE_HOLD,
+
+    _PYWM_GESTURE_N
+};
+
+enum _pywm_gesture_phase {
+    _PYWM_GESTURE_BEGIN,
+    _PYWM_GESTURE_UPDATE,
+    _PYWM_GESTURE_END,
+};
+
+struct _pywm_gesture_event {
+    enum _pywm_gesture_kind kind;
+    enum _pywm_gesture_phase phase;
+    uint32_t time_msec;
+
+    /* begin / update */
+    int fingers;
+
+    /* update */
+    double dx;
+    double dy;
+    double rotation;
+    double scale;
+
+    /* end */
+    int cancelled;
+};
+
+/* Gestures of queued kinds never wait for the GIL */
+struct _pywm_gestures {
+    /* Set from python */
+    atomic_bool queued[_PYWM_GESTURE_N];
+    atomic_bool consume[_PYWM_GESTURE_N];
+
+    struct _pywm_queue queue; // _pywm_gesture_event
+
+    /* Compositor thread only - UPDATEs merged while the queue is short of space */
+    struct _pywm_gesture_event merged[_PYWM_GESTURE_N];
+    bool has_merged[_PYWM_GESTURE_N];
+
+    /* Compositor thread only - BEGIN did not fit, the rest of the gesture is dropped as well */
+    bool dropping[_PYWM_GESTURE_N];
+};
+
+void _pywm_gestures_init();
+
+/* Returns -1 on unknown kind */
+int _pywm_gestures_kind(const char* name);
+void _pywm_gestures_set_queued(enum _pywm_gesture_kind kind, bool queued, bool consume);
+
+bool _pywm_gestures_is_queued(enum _pywm_gesture_kind kind);
+
+/* Compositor thread - returns whether the event is consumed */
+bool _pywm_gestures_push(struct _pywm_gesture_event* event);
+
+/* Python thread holding the GIL - list of (kind, time_msec, *args) as passed to the gesture callback */
+PyObject* _pywm_gestures_pop();
+int _pywm_gestures_get_fd();
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _PYWM_QUEUE_H
+#define _PYWM_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Single producer (compositor thread), single consumer (python, serialized by the GIL)
+ * ring buffer of fixed size elements - the producer never waits
+ */
+struct _pywm_queue {
+    /* Power of two */
+    size_t capacity;
+    size_t element_size;
+    char* elements;
+
+    atomic_size_t head;
+    atomic_size_t tail;
+
+    atomic_long n_dropped;
+
+    /* eventfd - readable as long as elements are pending */
+    int fd;
+};
+
+void _pywm_queue_init(struct _pywm_queue* queue, size_t capacity, size_t element_size);
+
+/* Compositor thread - returns false if the queue is full and the element has been dropped */
+bool _pywm_queue_push(struct _pywm_queue* queue, const void* element);
+
+/* Compositor thread - number of elements which can be pushed without dropping */
+size_t _pywm_queue_free(struct _pywm_queue* queue);
+
+/* Consumer - the n pending elements are _pywm_queue_at(queue, 0..n-1) until released */
+size_t _pywm_queue_acquire(struct _pywm_queue* queue);
+void* _pywm_queue_at(struct _pywm_queue* queue, size_t i);
+void _pywm_queue_release(struct _pywm_queue* queue, size_t n);
+
+#endif
@@ -7,9 +7,12 @@
 #include <wlr/types/wlr_pointer.h>
 #include <wlr/types/wlr_pointer_gestures_v1.h>
 
+#include "wm/wm_keybindings.h"
+
 struct wm_view;
 struct wm_server;
 struct wm_layout;
+struct wm_output;
 struct wm_widget;
 
 #define WM_CURSOR_MIN -1000000
@@ -17,6 +20,9 @@ struct wm_widget;
 struct wm {
     struct wm_server* server;
 
+    /* Keys decided on without calling back - only touch from the compositor thread */
+    struct wm_keybindings keybindings;
+
     void (*callback_layout_change)(struct wm_layout*);
     bool (*callback_key)(struct wlr_event_keyboard_key*, const char* keysyms);
     bool (*callback_modifiers)(struct wlr_keyboard_modifiers*);
@@ -37,6 +43,12 @@ struct wm {
     void (*callback_destroy_view)(struct wm_view*);
     void (*callback_view_event)(struct wm_view*, const char* event);
 
+    /* Transitions only: elapsed == 0 on activity after idle, otherwise a configured timeout has passed */
+    void (*callback_idle)(double elapsed, bool inhibited);
+
+    /* Render governor changed the effect quality level of an output, 0 being full quality */
+    void (*callback_render_quality)(struct wm_output* output, int level);
+
     /* Once the server is ready, and we can create new threads */
     void (*callback_ready)(void);
 
@@ -93,6 +105,9 @@ void wm_callback_init_view(struct wm_view* view);
 void wm_callback_destroy_view(struct wm_view* view);
 void wm_callback_view_event(struct wm_view* view, const char* event);
 
+void wm_callback_idle(double elapsed, bool inhibited);
+void wm_callback_render_quality(struct wm_output* output, int level);
+
 void wm_callback_update_view(struct wm_view* view);
 void wm_callback_update();
 void wm_callback_ready();
@@ -0,0 +1,74 @@
+#ifndef WM_ATLAS_H
+#define WM_ATLAS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/util/box.h>
+
+struct wm_renderer;
+
+#define WM_ATLAS_PAGE_SIZE 1024
+
+/* Larger buffers get their own wlr_texture */
+#define WM_ATLAS_MAX_WIDTH 512
+#define WM_ATLAS_MAX_HEIGHT 128
+
+/* Spacing between regions, so linear filtering does not bleed */
+#define WM_ATLAS_GUTTER 1
+
+struct wm_atlas_page {
+    struct wl_list link; // wm_atlas::pages
+
+    uint32_t format;
+    struct wlr_texture* wlr_texture;
+
+    /* Shelf packing */
+    int shelf_x;
+    int shelf_y;
+    int shelf_height;
+
+    int n_regions;
+    int used_area;
+};
+
+struct wm_atlas_region {
+    struct wl_list link; // wm_atlas::regions
+
+    struct wm_atlas_page* page;
+    struct wlr_box box;
+    uint32_t format;
+
+    /* Tightly packed copy, needed to move the region on compaction */
+    void* data;
+};
+
+struct wm_atlas {
+    struct wm_renderer* wm_renderer;
+
+    struct wl_list pages;   // wm_atlas_page::link
+    struct wl_list regions; // wm_atlas_region::link
+};
+
+void wm_atlas_init(struct wm_atlas* atlas, struct wm_renderer* renderer);
+void wm_atlas_destroy(struct wm_atlas* atlas);
+
+/* NULL if the buffer is too large to be packed (or on failure) */
+struct wm_atlas_region* wm_atlas_add(struct wm_atlas* atlas, uint32_t format, uint32_t stride, uint32_t width, uint32_t height, const void* data);
+
+/* Update in place - false if format or size do not match */
+bool wm_atlas_update(struct wm_atlas* atlas, struct wm_atlas_region* region, uint32_t format, uint32_t stride, uint32_t width, uint32_t height, const void* data);
+
+void wm_atlas_remove(struct wm_atlas* atlas, struct wm_atlas_region* region);
+
+/* Repack all regions into as few pages as possible - on failure, all regions stay where they were */
+void wm_atlas_compact(struct wm_atlas* atlas, uint32_t format);
+
+static inline struct wlr_texture* wm_atlas_region_get_texture(struct wm_atlas_region* region){
+    return region->page->wlr_texture;
+}
+
+void wm_atlas_region_get_source_box(struct wm_atlas_region* region, struct wlr_fbox* box);
+
+#endif
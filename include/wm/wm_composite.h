@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <wayland-server.h>
 #include <pixman.h>
+#include <wlr/util/box.h>
 
 #include "wm_content.h"
 
@@ -29,20 +30,46 @@ struct wm_composite {
 void wm_composite_init(struct wm_composite* comp, struct wm_server* server);
 void wm_composite_set_type(struct wm_composite* comp, const char* type, int n_params_int, int* params_int, int n_params_float, float* params_float);
 
-void wm_composite_on_damage_below(struct wm_composite* comp, struct wm_output* output, struct wm_content* from, pixman_region32_t* damage);
+/* Region the composite needs to redraw (added to result), given damage below it */
+void wm_composite_on_damage_below(struct wm_composite* comp, struct wm_output* output, pixman_region32_t* damage, pixman_region32_t* result);
 bool wm_content_is_composite(struct wm_content* content);
-void wm_composite_apply(struct wm_composite* composite, struct wm_output* output, pixman_region32_t* damage, struct timespec now);
+void wm_composite_apply(struct wm_composite* composite, struct wm_output* output, struct wlr_box* box, pixman_region32_t* damage, struct timespec now);
 
 struct wm_compose_chain {
+    /* Nodes active in the current frame */
     struct wm_compose_chain* lower;
     struct wm_compose_chain* higher;
+
     struct wm_composite* composite;
     double z_index;
     pixman_region32_t damage;
     pixman_region32_t composite_output;
+
+    /* Effective box and damage extend of composite on the output */
+    struct wlr_box box;
+    int extend;
+};
+
+/*
+ * Per output - nodes[0] is the root above all contents, followed by one node per composite from top to bottom.
+ * Rebuilt only if composites change, per frame only damages are reset and active nodes linked
+ */
+struct wm_compose_chains {
+    bool valid;
+
+    int n_nodes;
+    int capacity;
+    struct wm_compose_chain* nodes;
 };
 
 struct wm_compose_chain* wm_compose_chain_from_damage(struct wm_server* server, struct wm_output* output, pixman_region32_t* damage);
-void wm_compose_chain_free(struct wm_compose_chain* chain);
+
+/* Part of the damage of chain composites read from or write to - everything else can be rendered directly */
+void wm_compose_chain_offscreen(struct wm_compose_chain* chain, pixman_region32_t* offscreen);
+
+void wm_compose_chains_destroy(struct wm_compose_chains* chains);
+
+/* Set, z-index or geometry of composites have changed */
+void wm_compose_chains_invalidate(struct wm_server* server);
 
 #endif
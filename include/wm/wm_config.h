@@ -8,9 +8,22 @@
 
 #define WM_CONFIG_POS_MIN -1000000
 #define WM_CONFIG_STRLEN 100
+#define WM_CONFIG_IDLE_TIMEOUTS 32
 
 struct wm_server;
 
+/* Drawn in place of a view while the client has not caught up with a requested size */
+enum wm_config_resize_placeholder {
+    /* Stretch the client's current buffers */
+    WM_CONFIG_RESIZE_NONE,
+
+    /* Stretch a snapshot taken once when the resize started */
+    WM_CONFIG_RESIZE_SNAPSHOT,
+
+    /* Opaque box */
+    WM_CONFIG_RESIZE_SOLID,
+};
+
 struct wm_config_output {
     struct wl_list link; // wm_config::outputs
 
@@ -31,6 +44,26 @@ struct wm_config_output {
     enum wl_output_transform transform;
 };
 
+/* Parts of the compositor reloaded on reconfigure - settings read on use are not listed */
+enum wm_config_subsystem {
+    WM_CONFIG_KEYBOARDS,
+    WM_CONFIG_POINTERS,
+    WM_CONFIG_CURSOR,
+    WM_CONFIG_OUTPUTS,
+    WM_CONFIG_DECORATIONS,
+    WM_CONFIG_IDLE,
+    WM_CONFIG_TEXTURE_SHADERS,
+    WM_CONFIG_RENDERER_MODE,
+
+    WM_CONFIG_N_SUBSYSTEMS
+};
+
+/* Outcome of the last reconfigure */
+struct wm_config_reload {
+    bool reloaded[WM_CONFIG_N_SUBSYSTEMS];
+    double msec[WM_CONFIG_N_SUBSYSTEMS];
+};
+
 struct wm_config {
     /* Excluded from runtime update */
     bool enable_xwayland;
@@ -44,6 +77,23 @@ struct wm_config {
     char texture_shaders[WM_CONFIG_STRLEN];
     char renderer_mode[WM_CONFIG_STRLEN];
 
+    /* Degrade effects on outputs which exceed their refresh interval */
+    bool render_governor;
+
+    /* Render cacheable contents (layer surfaces, primitive widgets) from retained textures */
+    bool render_cache;
+
+    char resize_placeholder[WM_CONFIG_STRLEN];
+
+    /* Surfaces drawn at less than this fraction of their buffer size are sampled from reduced copies - 0 to disable */
+    double downscale_threshold;
+
+    /* Draw surfaces within a pixel of their buffer size 1:1 instead of resampling them */
+    bool native_buffer_scale;
+
+    /* Wait at most this long for clients to ack and commit configures before applying a layout change - 0 to disable */
+    int transaction_timeout_ms;
+
     struct wl_list outputs;
 
     const char *xcursor_theme;
@@ -58,12 +108,32 @@ struct wm_config {
     bool tap_to_click;
     bool natural_scroll;
 
+    /* Hand motion to python once per frame instead of per event */
+    bool coalesce_motion;
+
+    /* Seconds of inactivity after which python is notified - defaults to 5s steps up to a minute, 30s steps up to
+     * ten minutes, half an hour and an hour, close to the former periodic notifications */
+    double idle_timeouts[WM_CONFIG_IDLE_TIMEOUTS];
+    int n_idle_timeouts;
+
     bool debug;
+
+    struct wm_config_reload last_reload;
+};
+
+/* Copy to diff against after an update - outputs are diffed per wm_output */
+struct wm_config_previous {
+    struct wm_config config;
+    char xcursor_theme[WM_CONFIG_STRLEN];
 };
 
 void wm_config_init_default(struct wm_config *config);
 void wm_config_reset_default(struct wm_config* config);
-void wm_config_reconfigure(struct wm_config* config, struct wm_server* server);
+void wm_config_save_previous(struct wm_config* config, struct wm_config_previous* previous);
+
+/* Reload subsystems affected by changes since previous - all of them if previous is NULL */
+void wm_config_reconfigure(struct wm_config* config, struct wm_config_previous* previous, struct wm_server* server);
+const char* wm_config_subsystem_name(enum wm_config_subsystem subsystem);
 void wm_config_set_xcursor_theme(struct wm_config* config, const char* xcursor_theme);
 void wm_config_set_xcursor_size(struct wm_config* config, int xcursor_size);
 void wm_config_add_output(struct wm_config *config, const char *name,
@@ -74,5 +144,6 @@ struct wm_config_output *wm_config_find_output(struct wm_config *config,
 void wm_config_destroy(struct wm_config *config);
 
 enum wm_renderer_mode wm_config_get_renderer_mode(struct wm_config* config);
+enum wm_config_resize_placeholder wm_config_get_resize_placeholder(struct wm_config* config);
 
 #endif
@@ -8,6 +8,7 @@
 #include <wlr/util/log.h>
 
 struct wm_output;
+struct wm_renderer_cache;
 
 struct wm_content_vtable;
 
@@ -43,6 +44,10 @@ struct wm_content {
 
     /* Accepts input and is displayed clearly during lock - careful */
     bool lock_enabled;
+
+    /* Render through a retained texture while unchanged, if enabled in config */
+    bool cacheable;
+    struct wm_renderer_cache* render_cache;
 };
 
 void wm_content_init(struct wm_content* content, struct wm_server* server);
@@ -56,6 +61,9 @@ bool wm_content_has_workspace(struct wm_content* content);
 bool wm_content_is_on_output(struct wm_content* content, struct wm_output* output);
 
 void wm_content_set_box(struct wm_content* content, double x, double y, double width, double height);
+
+/* Like wm_content_set_box, but damages old and new box as one region - only for contents which draw inside their box */
+void wm_content_move_box(struct wm_content* content, double x, double y, double width, double height);
 void wm_content_get_box(struct wm_content* content, double* display_x, double* display_y, double* display_width, double* display_height);
 
 void wm_content_set_mask(struct wm_content* content, double mask_x, double mask_y, double mask_w, double mask_h);
@@ -71,6 +79,12 @@ double wm_content_get_opacity(struct wm_content* content);
 
 void wm_content_set_lock_enabled(struct wm_content* content, bool lock_enabled);
 
+void wm_content_set_cacheable(struct wm_content* content, bool cacheable);
+void wm_content_invalidate_render_cache(struct wm_content* content);
+
+/* Recreated on the next cached render */
+void wm_content_free_render_cache(struct wm_content* content);
+
 struct wm_content_vtable {
     void (*destroy)(struct wm_content* content);
     void (*render)(struct wm_content* content, struct wm_output* output, pixman_region32_t* output_damage, struct timespec now);
@@ -78,6 +92,9 @@ struct wm_content_vtable {
     /* origin == NULL means damage whole */
     void (*damage_output)(struct wm_content* content, struct wm_output* output, struct wlr_surface* origin);
 
+    /* Add output coordinates render may draw to, disregarding workspace - NULL means box */
+    void (*extents)(struct wm_content* content, struct wm_output* output, pixman_region32_t* region);
+
     void (*printf)(FILE* file, struct wm_content* content);
 };
 
@@ -95,6 +112,16 @@ static inline void wm_content_damage_output(struct wm_content* content, struct w
     }
 }
 
+void wm_content_extents_base(struct wm_content* content, struct wm_output* output, pixman_region32_t* region);
+
+static inline void wm_content_extents(struct wm_content* content, struct wm_output* output, pixman_region32_t* region){
+    if(content->vtable->extents){
+        (*content->vtable->extents)(content, output, region);
+    }else{
+        wm_content_extents_base(content, output, region);
+    }
+}
+
 static inline void wm_content_printf(FILE* file, struct wm_content* content){
     (*content->vtable->printf)(file, content);
 }
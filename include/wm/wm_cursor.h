@@ -3,15 +3,46 @@
 
 #include <wayland-server.h>
 #include <wlr/types/wlr_cursor.h>
+#include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_pointer_gestures_v1.h>
 #include <wlr/types/wlr_xcursor_manager.h>
 
+#include "wm_content.h"
+
+/* Software cursor is drawn above everything else */
+#define WM_CURSOR_Z_INDEX 1000000.
+
+/* Coalesced motion is handed to python at the latest after roughly one frame */
+#define WM_CURSOR_COALESCE_MOTION_MS 16
+
 struct wm_cursor;
 struct wm_seat;
 struct wm_layout;
 struct wm_output;
 struct wm_pointer;
 
+struct wm_cursor_output {
+    struct wl_list link; // wm_cursor::outputs
+
+    struct wm_cursor* wm_cursor;
+    struct wm_output* wm_output;
+    struct wlr_output_cursor* wlr_output_cursor;
+
+    struct wl_listener destroy;
+
+    /* Cursor image could be put onto a hardware plane, otherwise it is drawn by wm_cursor_content */
+    bool hardware;
+
+    /* Software xcursor image uploaded for the output scale */
+    struct wlr_texture* texture;
+};
+
+/* Software cursor as part of the scene - damage tracked like any other content */
+struct wm_cursor_content {
+    struct wm_content super;
+    struct wm_cursor* wm_cursor;
+};
+
 struct wm_cursor {
     struct wm_seat* wm_seat;
 
@@ -24,6 +55,7 @@ struct wm_cursor {
     struct wl_listener axis;
     struct wl_listener frame;
     struct wl_listener surface_destroy;
+    struct wl_listener surface_commit;
 
 	struct wlr_pointer_gestures_v1 *pointer_gestures;
 	struct wl_listener pinch_begin;
@@ -39,14 +71,34 @@ struct wm_cursor {
 
     uint32_t msec_delta;
 
+    /* Opt-in (coalesce_motion): cursor and clients follow every event, python gets motion summed up once
+     * per frame */
+    struct {
+        bool pending;
+        double delta_x;
+        double delta_y;
+        uint32_t time_msec;
+
+        /* Python consumed the last motion - deliver synchronously until it lets motion pass again */
+        bool synchronous;
+
+        struct wl_event_source* timer;
+    } coalesced_motion;
+
     /* Set from python - final say about whether a cursor is displayed */
     int cursor_visible;
 
+    /* xcursor image name, if no client image is set */
+    char* image;
+
     struct {
         struct wlr_surface* surface;
         int32_t hotspot_x;
         int32_t hotspot_y;
     } client_image;
+
+    struct wl_list outputs; // wm_cursor_output::link
+    struct wm_cursor_content* software;
 };
 
 void wm_cursor_init(struct wm_cursor* cursor, struct wm_seat* seat, struct wm_layout* layout);
@@ -61,7 +113,15 @@ void wm_cursor_destroy(struct wm_cursor* cursor);
 void wm_cursor_add_pointer(struct wm_cursor* cursor, struct wm_pointer* pointer);
 void wm_cursor_update(struct wm_cursor* cursor);
 
+/* Hand pending coalesced motion to python */
+void wm_cursor_flush_motion(struct wm_cursor* cursor);
+
 void wm_cursor_reconfigure(struct wm_cursor* cursor);
 
+/* Removed on wlr_output destroy */
+void wm_cursor_add_output(struct wm_cursor* cursor, struct wm_output* output);
+
+bool wm_content_is_cursor(struct wm_content* content);
+
 
 #endif
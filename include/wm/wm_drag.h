@@ -11,6 +11,8 @@ struct wm_drag {
     struct wm_content super;
 
     struct wm_seat* wm_seat;
+    struct wl_list link_seat; // wm_seat::wm_drags
+
     struct wlr_drag* wlr_drag;
 
     struct wl_listener destroy;
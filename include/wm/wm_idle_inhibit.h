@@ -1,6 +1,9 @@
 #ifndef WM_IDLE_INHIBIT_H
 #define WM_IDLE_INHIBIT_H
 
+#include <stdbool.h>
+#include <time.h>
+#include <wayland-server.h>
 #include <wlr/types/wlr_idle_inhibit_v1.h>
 
 struct wm_server;
@@ -20,6 +23,17 @@ void wm_idle_inhibitor_destroy(struct wm_idle_inhibitor* inhibitor);
 struct wm_idle_inhibit {
     struct wm_server* wm_server;
 
+    /* Inhibitors attached to a view */
+    int n_inhibitors;
+
+    struct timespec last_activity;
+
+    /* Largest configured timeout reported to python since the last activity, 0 while active */
+    double idle_timeout;
+
+    /* Armed for the next configured timeout - re-armed lazily on activity */
+    struct wl_event_source* timer;
+
     struct wlr_idle_inhibit_manager_v1* wlr_idle_inhibit_manager;
     struct wl_listener new_idle_inhibitor;
 };
@@ -27,4 +41,10 @@ struct wm_idle_inhibit {
 void wm_idle_inhibit_init(struct wm_idle_inhibit* inhibit, struct wm_server* server);
 void wm_idle_inhibit_destroy(struct wm_idle_inhibit* inhibit);
 
+/* Input activity - cheap, to be called per event */
+void wm_idle_inhibit_notify_activity(struct wm_idle_inhibit* inhibit);
+
+void wm_idle_inhibit_reconfigure(struct wm_idle_inhibit* inhibit);
+bool wm_idle_inhibit_is_inhibited(struct wm_idle_inhibit* inhibit);
+
 #endif
@@ -0,0 +1,38 @@
+#ifndef WM_KEYBINDINGS_H
+#define WM_KEYBINDINGS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <xkbcommon/xkbcommon.h>
+
+/* Binding matches regardless of modifiers */
+#define WM_KEYBINDING_ANY_MODIFIERS UINT32_MAX
+
+struct wm_keybinding {
+    /* Depressed modifiers (WLR_MODIFIER_*) */
+    uint32_t modifiers;
+
+    /* Level 0 keysym, i.e. the keysym names passed to python */
+    xkb_keysym_t keysym;
+};
+
+/*
+ * If enabled, only keys matching a binding are passed to python,
+ * all other keys go to the clients directly
+ */
+struct wm_keybindings {
+    bool enabled;
+
+    int n_bindings;
+    struct wm_keybinding* bindings;
+};
+
+/* Takes ownership of bindings; n_bindings < 0 disables the table */
+void wm_keybindings_set(struct wm_keybindings* keybindings, int n_bindings, struct wm_keybinding* bindings);
+void wm_keybindings_destroy(struct wm_keybindings* keybindings);
+
+bool wm_keybindings_match(struct wm_keybindings* keybindings, uint32_t modifiers,
+        const xkb_keysym_t* keysyms, size_t n_keysyms);
+
+#endif
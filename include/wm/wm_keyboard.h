@@ -6,6 +6,8 @@
 
 struct wm_seat;
 
+#define WM_KEYBOARD_KEYCODES 256
+
 struct wm_keyboard {
     struct wl_list link;   // wm_seat::wm_keyboards
     struct wm_seat* wm_seat;
@@ -15,6 +17,9 @@ struct wm_keyboard {
     struct wl_listener destroy;
     struct wl_listener key;
     struct wl_listener modifiers;
+
+    /* Keys (by keycode) pressed while matching a keybinding - their release goes to python as well */
+    uint32_t bound_keys[WM_KEYBOARD_KEYCODES / 32];
 };
 
 void wm_keyboard_init(struct wm_keyboard* keyboard, struct wm_seat* seat, struct wlr_input_device* input_device);
@@ -0,0 +1,27 @@
+#ifndef WM_LAYER_ARRANGE_H
+#define WM_LAYER_ARRANGE_H
+
+#include <stdbool.h>
+
+struct wm_layout;
+struct wm_output;
+struct wm_view_layer;
+
+/*
+ * Native placement of layer shell surfaces (anchors, margins, exclusive zones)
+ * - configures clients and keeps wm_output::usable_area up to date
+ */
+
+/* Returns true if the usable area of output has changed */
+bool wm_layer_arrange_output(struct wm_output* output);
+
+/* On layout change - does not notify, as the layout change itself is passed on */
+void wm_layer_arrange_layout(struct wm_layout* layout);
+
+/* After layer surface state has changed - rearranges its output, notifies of a changed usable area and updates moved surfaces */
+void wm_layer_arrange_view(struct wm_view_layer* view);
+
+/* Output is going away - close its layer surfaces */
+void wm_layer_arrange_remove_output(struct wm_output* output);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef WM_LAYOUT_H
 #define WM_LAYOUT_H
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <wayland-server.h>
 #include <wlr/types/wlr_output.h>
@@ -29,15 +30,21 @@ void wm_layout_destroy(struct wm_layout* layout);
 void wm_layout_add_output(struct wm_layout* layout, struct wlr_output* output);
 void wm_layout_remove_output(struct wm_layout* layout, struct wm_output* output);
 
-void wm_layout_reconfigure(struct wm_layout* layout);
+/* Returns false if no output needed to be touched */
+bool wm_layout_reconfigure(struct wm_layout* layout);
 
 /* Damage whole output layout */
 void wm_layout_damage_whole(struct wm_layout* layout);
 
 /* Calls wm_content_damage_output, expects calls to wm_layout_damage_output */
 void wm_layout_damage_from(struct wm_layout* layout, struct wm_content* content, struct wlr_surface* origin);
+
+/* Damage is only collected here and resolved in wm_layout_flush_damage */
 void wm_layout_damage_output(struct wm_layout* layout, struct wm_output* output, pixman_region32_t* damage, struct wm_content* from);
 
+/* Propagate collected damage to composites and pass it to wlr_output_damage - call at frame start */
+void wm_layout_flush_damage(struct wm_layout* layout, struct wm_output* output);
+
 void wm_layout_start_update(struct wm_layout* layout);
 int wm_layout_get_refresh_output(struct wm_layout* layout);
 
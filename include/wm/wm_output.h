@@ -2,11 +2,40 @@
 #define WM_OUTPUT_H
 
 #include <wayland-server.h>
+#include <pixman.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_output_damage.h>
+#include <wlr/util/box.h>
+
+#include "wm/wm_config.h"
 
 struct wm_layout;
 struct wm_renderer_buffers;
+struct wm_compose_chains;
+
+/* Damage accumulated until the next frame, per z-index of the damaging content */
+struct wm_output_pending_damage {
+    struct wl_list link; // wm_output::pending_damage - ascending z-index
+
+    double z_index;
+    pixman_region32_t damage;
+};
+
+/* Steps effects down while frames exceed the refresh interval, level 0 is full quality */
+#define WM_OUTPUT_GOVERNOR_LEVELS 5
+
+struct wm_output_governor {
+    int level;
+
+    /* Moving average of render and commit */
+    double render_msec;
+
+    /* Consecutive frames over / well under budget */
+    int n_over;
+    int n_under;
+
+    bool animating;
+};
 
 struct wm_output {
     struct wm_server* wm_server;
@@ -18,9 +47,21 @@ struct wm_output {
 
     int key; // Unique key in a layout - update on layout change
 
+    /* Output-local, logical - excluding exclusive zones of layer surfaces */
+    struct wlr_box usable_area;
+
     struct wlr_output* wlr_output;
     struct wlr_output_damage* wlr_output_damage;
 
+    /* Config as last applied - reconfigures are skipped if it is unchanged */
+    bool configured;
+    bool configured_has_config;
+    struct wm_config_output configured_config;
+
+    /* Position as last placed - below WM_CONFIG_POS_MIN if placed automatically */
+    int placed_x;
+    int placed_y;
+
     struct wl_listener destroy;
     struct wl_listener commit;
     struct wl_listener mode;
@@ -31,6 +72,12 @@ struct wm_output {
     bool expecting_frame;
     struct timespec last_frame;
 
+    struct wl_list pending_damage; // wm_output_pending_damage::link
+
+    struct wm_compose_chains* compose_chains;
+
+    struct wm_output_governor governor;
+
 #if WM_CUSTOM_RENDERER
     struct wm_renderer_buffers* renderer_buffers;
 #endif
@@ -39,7 +86,18 @@ struct wm_output {
 void wm_output_init(struct wm_output* output, struct wm_server* server, struct wm_layout* layout, struct wlr_output* out);
 void wm_output_destroy(struct wm_output* output);
 
-void wm_output_reconfigure(struct wm_output* output);
+/* Mode, scale and transform are only touched if the config of this output has changed - returns false otherwise */
+bool wm_output_reconfigure(struct wm_output* output);
+
+/*
+ * Output-local logical box to output pixels - snapped in fixed point, so identical inputs always hit identical
+ * pixels, and independently for position and size, so moving contents are not resampled
+ */
+void wm_output_snap_box(struct wm_output* output, double x, double y, double width, double height, struct wlr_box* box);
+
+/* Governed effect quality - passes are clamped, corners may be skipped during animations */
+int wm_output_blur_passes(struct wm_output* output, int passes);
+bool wm_output_renders_corners(struct wm_output* output);
 
 
 /*
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/util/box.h>
 #include <pixman.h>
 
 
@@ -22,6 +23,7 @@ struct wm_renderer_texture_shader {
     GLint alpha;
     GLint pos_attrib;
     GLint tex_attrib;
+    GLuint vao;
 
     GLint offset_x;
     GLint offset_y;
@@ -56,6 +58,7 @@ struct wm_renderer_primitive_shader {
     GLint alpha;
     GLint pos_attrib;
     GLint tex_attrib;
+    GLuint vao;
 
     GLint width;
     GLint height;
@@ -65,6 +68,40 @@ struct wm_renderer_primitive_shader {
     int n_params_float;
     GLint params_float;
     GLint params_int;
+
+    /* Instanced variant (shader == 0 if not available) */
+    struct {
+        GLuint shader;
+
+        GLint proj;
+        GLint pos_attrib;
+        GLint tex_attrib;
+        GLuint vao;
+
+        GLint box_attrib;
+        GLint misc_attrib;
+        GLint params_float_attrib[2];
+        GLint params_int_attrib;
+        GLint clip_attrib;
+    } instanced;
+};
+
+/* box(4), misc(4), params_float(8), params_int(4), clip(4) */
+#define WM_RENDERER_PRIMITIVE_INSTANCE_SIZE 24
+
+/*
+ * Consecutive primitives of the same shader are collected and submitted as one
+ * instanced draw - every instance is clipped to its own damage in the fragment shader
+ */
+struct wm_renderer_primitive_batch {
+    struct wm_renderer_primitive_shader* shader;
+
+    /* Union of the clips of all instances */
+    pixman_region32_t damage;
+
+    int n_instances;
+    int capacity;
+    GLfloat* data;
 };
 
 #define WM_RENDERER_DOWNSAMPLE_BUFFERS 4
@@ -84,6 +121,10 @@ struct wm_renderer_buffers {
 
     int downsample_buffers_width[WM_RENDERER_DOWNSAMPLE_BUFFERS];
     int downsample_buffers_height[WM_RENDERER_DOWNSAMPLE_BUFFERS];
+
+    /* RGBA scratch buffer to fill render caches - 0 until first used */
+    GLuint cache_buffer;
+    GLuint cache_buffer_tex;
 };
 
 void wm_renderer_buffers_init(struct wm_renderer_buffers* buffers, struct wm_renderer* renderer, int width, int height);
@@ -100,10 +141,33 @@ enum wm_renderer_mode {
     WM_RENDERER_PYWM,
 };
 
+struct wm_atlas;
+struct wm_output;
+
+/* Retained rendering of a single content (see wm_content_set_cacheable) */
+struct wm_renderer_cache {
+    bool valid;
+
+    /* Rendered for - output is only compared */
+    struct wm_output* output;
+    struct wlr_box box;
+    int quality_level;
+    bool corners;
+
+#ifdef WM_CUSTOM_RENDERER
+    GLuint texture;
+    int texture_width;
+    int texture_height;
+#endif
+};
+
 struct wm_renderer {
     struct wm_server* wm_server;
     struct wlr_renderer* wlr_renderer;
 
+    /* Shared pages for small widget textures */
+    struct wm_atlas* wm_atlas;
+
     struct wm_output* current;
 
     enum wm_renderer_mode mode;
@@ -117,12 +181,14 @@ struct wm_renderer {
         GLint tex;
         GLint pos_attrib;
         GLint tex_attrib;
+        GLuint vao;
     } quad_shader;
     struct {
         GLuint shader;
         GLint tex;
         GLint pos_attrib;
         GLint tex_attrib;
+        GLuint vao;
 
         GLint halfpixel;
         GLint offset;
@@ -132,6 +198,7 @@ struct wm_renderer {
         GLint tex;
         GLint pos_attrib;
         GLint tex_attrib;
+        GLuint vao;
 
         GLint halfpixel;
         GLint offset;
@@ -151,6 +218,23 @@ struct wm_renderer {
     struct wm_renderer_texture_shaders* texture_shaders_selected;
     struct wm_renderer_primitive_shader* primitive_shader_selected;
 
+    bool primitive_instancing;
+    struct wm_renderer_primitive_batch primitive_batch;
+
+    /* Vertex array objects and buffer mapping (GLES 3) - otherwise attributes are set up per draw */
+    bool vertex_arrays;
+
+    /* Offscreen buffer is copied out with glBlitFramebuffer (GLES 3) - otherwise drawn as a quad */
+    bool framebuffer_blits;
+
+    /* Quad geometry shared by all shaders */
+    GLuint static_buffer;
+
+    /* Per-draw vertex and instance data - sub-allocated, orphaned once per frame or when full */
+    GLuint stream_buffer;
+    GLsizeiptr stream_size;
+    GLintptr stream_offset;
+
     unsigned int selected_buffer;
 #endif
 };
@@ -170,7 +254,9 @@ void wm_renderer_add_texture_shaders(struct wm_renderer* renderer, const char* n
 
 void wm_renderer_init_primitive_shaders(struct wm_renderer* renderer, int n_shaders);
 void wm_renderer_add_primitive_shader(struct wm_renderer* renderer, const char* name,
-        const GLchar* vert_src, const GLchar* frag_src, int n_params_int, int n_params_float);
+        const GLchar* vert_src, const GLchar* frag_src,
+        const GLchar* vert_src_instanced, const GLchar* frag_src_instanced,
+        int n_params_int, int n_params_float);
 
 #endif
 
@@ -180,6 +266,9 @@ bool wm_renderer_check_primitive_params(struct wm_renderer* renderer, int n_int,
 
 void wm_renderer_to_buffer(struct wm_renderer* renderer, unsigned int buffer);
 
+/* Copy damage from the offscreen buffer to the output, and continue rendering there */
+void wm_renderer_present_buffer(struct wm_renderer* renderer, pixman_region32_t* damage);
+
 void wm_renderer_begin(struct wm_renderer *renderer, struct wm_output *output);
 void wm_renderer_end(struct wm_renderer *renderer, pixman_region32_t *damage,
                      struct wm_output *output);
@@ -191,6 +280,15 @@ void wm_renderer_render_texture_at(struct wm_renderer *renderer,
                                    struct wlr_box *mask,
                                    double corner_radius, double lock_perc);
 
+/* Render only source box of texture (e.g. an atlas region) */
+void wm_renderer_render_subtexture_at(struct wm_renderer *renderer,
+                                      pixman_region32_t *damage,
+                                      struct wlr_texture *texture,
+                                      const struct wlr_fbox *source,
+                                      struct wlr_box *box, double opacity,
+                                      struct wlr_box *mask,
+                                      double corner_radius, double lock_perc);
+
 void wm_renderer_render_primitive(struct wm_renderer* renderer,
                                   pixman_region32_t* damage,
                                   struct wlr_box* box,
@@ -208,6 +306,21 @@ void wm_renderer_clear(struct wm_renderer* renderer,
                        pixman_region32_t* damage,
                        float* color);
 
+/* Redirect rendering of box into cache until wm_renderer_cache_end - false if not supported */
+bool wm_renderer_cache_begin(struct wm_renderer* renderer, struct wm_renderer_cache* cache, struct wlr_box* box);
+void wm_renderer_cache_end(struct wm_renderer* renderer, struct wm_renderer_cache* cache);
+void wm_renderer_render_cache(struct wm_renderer* renderer,
+                              pixman_region32_t* damage,
+                              struct wm_renderer_cache* cache);
+void wm_renderer_cache_destroy(struct wm_renderer* renderer, struct wm_renderer_cache* cache);
+
+/* Like wm_renderer_cache_begin, but box ends up in a new texture owned by the caller - false if not supported */
+bool wm_renderer_snapshot_begin(struct wm_renderer* renderer, struct wlr_box* box);
+struct wlr_texture* wm_renderer_snapshot_end(struct wm_renderer* renderer, struct wlr_box* box);
+
+/* New texture of 1/2^level the size of texture, owned by the caller - NULL if not supported */
+struct wlr_texture* wm_renderer_downscale_texture(struct wm_renderer* renderer, struct wlr_texture* texture, int level);
+
 void wm_renderer_ensure_mode(struct wm_renderer* renderer, enum wm_renderer_mode mode);
 
 #endif
@@ -19,6 +19,9 @@ struct wm_seat{
     struct wl_list wm_keyboards;
     struct wl_list wm_pointers;
 
+    /* Active drags - followed by the cursor */
+    struct wl_list wm_drags;
+
     struct wl_listener request_start_drag;
     struct wl_listener start_drag;
     struct wl_listener request_set_selection;
@@ -52,5 +55,7 @@ void wm_seat_dispatch_axis(struct wm_seat* seat, struct wlr_event_pointer_axis*
 void wm_seat_kill_seatop(struct wm_seat* seat);
 
 void wm_seat_reconfigure(struct wm_seat* seat);
+void wm_seat_reconfigure_keyboards(struct wm_seat* seat);
+void wm_seat_reconfigure_pointers(struct wm_seat* seat);
 
 #endif
@@ -18,6 +18,12 @@ struct wm_layout;
 struct wm_renderer;
 struct wm_output;
 struct wm_idle_inhibit;
+struct wm_texture_cache;
+struct wm_transaction;
+struct wm_xwayland_index;
+
+/* Rate of frame callbacks for views which are not rendered */
+#define WM_SERVER_HIDDEN_FRAME_DONE_MS 1000
 
 struct wm_server{
     struct wm_config* wm_config;
@@ -38,6 +44,7 @@ struct wm_server{
     struct wlr_xdg_decoration_manager_v1* wlr_xdg_decoration_manager;
 #ifdef WM_HAS_XWAYLAND
     struct wlr_xwayland* wlr_xwayland;
+    struct wm_xwayland_index* wm_xwayland_index;
 #endif
     struct wlr_xcursor_manager* wlr_xcursor_manager;
     struct wlr_virtual_keyboard_manager_v1* wlr_virtual_keyboard_manager;
@@ -48,6 +55,8 @@ struct wm_server{
     struct wm_seat* wm_seat;
     struct wm_layout* wm_layout;
     struct wm_idle_inhibit* wm_idle_inhibit;
+    struct wm_texture_cache* wm_texture_cache;
+    struct wm_transaction* wm_transaction;
 
     /* Sorted by z-index (highest first) */
     struct wl_list wm_contents;  // wm_content::link
@@ -67,6 +76,13 @@ struct wm_server{
 
     int constant_damage_mode;
     struct wl_event_source* callback_timer;
+
+    struct wl_event_source* hidden_frame_done_timer;
+    bool hidden_frame_done_armed;
+
+    /* Set when geometry, stacking, opacity or mapping of views, root surface sizes / opaque regions, outputs or
+     * the lock change - wm_view::visible is recomputed before the next frame */
+    bool visibility_dirty;
 };
 
 void wm_server_init(struct wm_server* server, struct wm_config* config);
@@ -78,6 +94,10 @@ struct wm_view* wm_server_view_for_surface(struct wm_server* server, struct wlr_
 
 void wm_server_update_contents(struct wm_server* server);
 
+/* Recompute wm_view::visible if invalidated, notify of changes and throttle frame callbacks of hidden views */
+void wm_server_update_visibility(struct wm_server* server);
+void wm_server_invalidate_visibility(struct wm_server* server);
+
 void wm_server_open_virtual_output(struct wm_server* server, const char* name);
 void wm_server_close_virtual_output(struct wm_server* server, const char* name);
 
@@ -94,5 +114,7 @@ void wm_server_printf(FILE* file, struct wm_server* server);
 
 /* Update after new wm_config key-vals where suitable */
 void wm_server_reconfigure(struct wm_server* server);
+void wm_server_reconfigure_decorations(struct wm_server* server);
+void wm_server_reconfigure_xcursor(struct wm_server* server);
 
 #endif
@@ -0,0 +1,88 @@
+#ifndef WM_TEXTURE_CACHE_H
+#define WM_TEXTURE_CACHE_H
+
+#include <stdbool.h>
+#include <time.h>
+#include <wayland-server.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/addon.h>
+
+struct wm_server;
+
+/* Clients usually cycle a swapchain of 2-3 buffers */
+#define WM_TEXTURE_CACHE_SIZE 4
+
+/* Reduced copies go down to 1/2^WM_TEXTURE_CACHE_MAX_LEVEL */
+#define WM_TEXTURE_CACHE_MAX_LEVEL 6
+
+/* Surfaces which committed more recently (video, animations) are sampled directly - a copy would not last */
+#define WM_TEXTURE_CACHE_STATIC_MSEC 100
+
+struct wm_texture_cache_stats {
+    long n_commits;
+
+    /* Buffer has been imported into a new texture */
+    long n_imports;
+    long long import_nsec;
+    long long import_nsec_max;
+
+    /* Texture known for buffer, or damage written into the existing texture */
+    long n_reuses;
+    long long reuse_nsec;
+
+    /* Reduced copies created for minified rendering */
+    long n_downscales;
+};
+
+struct wm_texture_cache_surface {
+    struct wl_list link; // wm_texture_cache::surfaces
+
+    struct wm_texture_cache* cache;
+    struct wlr_surface* wlr_surface;
+
+    /* Textures of the buffers last attached, most recently used first */
+    struct wlr_texture* textures[WM_TEXTURE_CACHE_SIZE];
+    int n_textures;
+
+    /* Reduced copy of reduced_source, dropped on commit - NULL with reduced_source set if not supported */
+    struct wlr_texture* reduced_source;
+    struct wlr_texture* reduced;
+    int reduced_level;
+
+    /* Last buffer commit */
+    struct timespec committed;
+
+    /* wlr_surface::addons */
+    struct wlr_addon addon;
+
+    struct wl_listener commit;
+    struct wl_listener destroy;
+};
+
+struct wm_texture_cache {
+    struct wm_server* wm_server;
+
+    struct wl_list surfaces; // wm_texture_cache_surface::link
+
+    struct wm_texture_cache_stats stats;
+
+    /* Start of the wl_surface.commit request currently being handled */
+    struct wl_resource* pending_commit;
+    struct timespec pending_commit_start;
+
+    /* Only with debug set - otherwise timings stay 0 */
+    struct wl_protocol_logger* wl_protocol_logger;
+    struct wl_listener new_surface;
+};
+
+void wm_texture_cache_init(struct wm_texture_cache* cache, struct wm_server* server);
+void wm_texture_cache_destroy(struct wm_texture_cache* cache);
+
+void wm_texture_cache_reset_stats(struct wm_texture_cache* cache);
+
+/* During rendering - texture as currently attached to surface, reduced by 1/2^level, or NULL */
+struct wlr_texture* wm_texture_cache_get_reduced(struct wm_texture_cache* cache, struct wlr_surface* surface,
+        struct wlr_texture* texture, int level);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef WM_TRANSACTION_H
+#define WM_TRANSACTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <wayland-server.h>
+
+struct wm_server;
+struct wm_content;
+struct wm_view;
+
+/* Only transactions which had to wait for clients */
+struct wm_transaction_stats {
+    long n_transactions;
+    long n_timeouts;
+
+    /* From the first configure committed until the boxes are applied */
+    long long latency_nsec;
+    long long latency_nsec_max;
+};
+
+struct wm_transaction_entry {
+    struct wm_content* content;
+
+    bool box_pending;
+    double x;
+    double y;
+    double width;
+    double height;
+
+    /* Configure sent, waiting for the client to ack and commit it */
+    bool waiting;
+    uint32_t serial;
+};
+
+/*
+ * Boxes set during one update from python are applied in one go, once every view which has been
+ * sent a configure has committed a buffer matching it - or after wm_config::transaction_timeout_ms
+ */
+struct wm_transaction {
+    struct wm_server* wm_server;
+
+    /* Between begin and commit */
+    bool collecting;
+
+    struct wm_transaction_entry* entries;
+    int n_entries;
+    int capacity;
+    int n_waiting;
+
+    /* Waiting for clients, timeout running */
+    bool armed;
+    struct timespec committed;
+    struct wl_event_source* timeout;
+
+    struct wm_transaction_stats stats;
+};
+
+void wm_transaction_init(struct wm_transaction* transaction, struct wm_server* server);
+void wm_transaction_destroy(struct wm_transaction* transaction);
+
+void wm_transaction_begin(struct wm_transaction* transaction);
+void wm_transaction_commit(struct wm_transaction* transaction);
+
+/* Applied immediately if no transaction is collecting or waiting */
+void wm_transaction_set_box(struct wm_transaction* transaction, struct wm_content* content,
+        double x, double y, double width, double height);
+
+/* Called from the view once it has scheduled a configure */
+void wm_transaction_add_configure(struct wm_transaction* transaction, struct wm_view* view, uint32_t serial);
+
+/* Called from the view on commit with the serial of the latest configure acked */
+void wm_transaction_view_committed(struct wm_transaction* transaction, struct wm_view* view, uint32_t serial);
+
+/* Unmapped views will not commit a configure - their box is still applied with the transaction */
+void wm_transaction_view_unmapped(struct wm_transaction* transaction, struct wm_view* view);
+
+void wm_transaction_remove_content(struct wm_transaction* transaction, struct wm_content* content);
+
+void wm_transaction_reset_stats(struct wm_transaction* transaction);
+
+#endif
@@ -15,6 +15,48 @@ struct wm_view_vtable;
 typedef void (*wm_surface_iterator_func_t)(struct wlr_surface *surface,
 	int sx, int sy, bool constrained, void *data);
 
+struct wm_view_input_entry {
+    struct wlr_surface* surface;
+
+    /* Surface box relative to the view's root surface */
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+/* Surface tree flattened topmost first - rebuilt on the first query after the tree changed */
+struct wm_view_input_map {
+    bool valid;
+
+    struct wm_view_input_entry* entries;
+    int n_entries;
+    int capacity;
+};
+
+/* Size requested from the client which it has not yet committed */
+struct wm_view_resize {
+    bool pending;
+    int width;
+    int height;
+
+    /* Contents before the resize - taken on first render, NULL if not (yet) available */
+    struct wlr_texture* snapshot;
+    bool snapshot_failed;
+
+    /* Copy of snapshot reduced by 1/2^reduced_level for minified rendering, NULL if not needed */
+    struct wlr_texture* reduced;
+    int reduced_level;
+};
+
+/* Root surface state at the last commit whose changes affect occlusion of other views */
+struct wm_view_occlusion {
+    int width;
+    int height;
+    int surface_width;
+    int surface_height;
+};
+
 struct wm_view {
     struct wm_content super;
 
@@ -22,7 +64,15 @@ struct wm_view {
     bool mapped;
     bool inhibiting_idle;
 
+    /* Off-screen, outside its workspace, transparent or covered - see wm_server_update_visibility */
+    bool visible;
+    bool visible_changed;
+    struct wm_view_occlusion occlusion;
+
     bool accepts_input;
+    struct wm_view_input_map input_map;
+
+    struct wm_view_resize resize;
 
     /* defaults to false; if by means of wlr_server_decoration or wlr_toplevel_decoration we know the view is decorated: true */
     bool shows_csd;
@@ -40,13 +90,36 @@ void wm_view_base_init(struct wm_view* view, struct wm_server* server);
 void wm_view_set_inhibiting_idle(struct wm_view* view, bool inhibiting_idle);
 bool wm_view_is_inhibiting_idle(struct wm_view* view);
 
+void wm_view_set_visible(struct wm_view* view, bool visible);
+
+/* Implementations report mapping and root surface commits, which may change visibility of other views */
+void wm_view_set_mapped(struct wm_view* view, bool mapped);
+void wm_view_root_committed(struct wm_view* view, struct wlr_surface* surface);
+bool wm_view_is_visible(struct wm_view* view);
+
+/* To be called whenever a surface of the view is (un)mapped, committed or moved */
+void wm_view_invalidate_input_map(struct wm_view* view);
+struct wlr_surface* wm_view_surface_at(struct wm_view* view, double at_x, double at_y, double* sx, double* sy);
+
+/* To be called by implementations once a size differing from the current one has been requested / committed */
+void wm_view_begin_resize(struct wm_view* view, int width, int height);
+void wm_view_end_resize(struct wm_view* view);
+
+/* Client has committed a configure older than the one pending - e.g. during interactive resizes */
+void wm_view_resize_committed(struct wm_view* view);
+
+/* Free snapshot textures - retaken on the next render if still resizing */
+void wm_view_drop_snapshot(struct wm_view* view);
+
+/* Hidden views are not rendered, but still need frame callbacks to not stall */
+void wm_view_send_frame_done(struct wm_view* view, struct timespec* when);
+
 bool wm_content_is_view(struct wm_content* content);
 bool wm_view_shows_csd(struct wm_view* view);
 
 struct wm_view_vtable {
     void (*destroy)(struct wm_view* view);
 
-    struct wlr_surface* (*surface_at)(struct wm_view* view, double at_x, double at_y, double* sx, double* sy);
     void (*for_each_surface)(struct wm_view* view, wm_surface_iterator_func_t iterator, void* user_data);
     void (*set_activated)(struct wm_view* view, bool activated);
 
@@ -145,10 +218,6 @@ static inline void wm_view_request_close(struct wm_view* view){
     (*view->vtable->request_close)(view);
 }
 
-static inline struct wlr_surface* wm_view_surface_at(struct wm_view* view, double at_x, double at_y, double* sx, double* sy){
-    return (*view->vtable->surface_at)(view, at_x, at_y, sx, sy);
-}
-
 static inline void wm_view_for_each_surface(struct wm_view* view, wm_surface_iterator_func_t iterator, void* user_data){
     (*view->vtable->for_each_surface)(view, iterator, user_data);
 }
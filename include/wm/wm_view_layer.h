@@ -57,10 +57,22 @@ struct wm_view_layer {
     int width;
     int height;
 
+    /* Set by wm_layer_arrange - layout coordinates, logical */
+    bool arranged;
+    struct wlr_box arranged_box;
+    int configured_width;
+    int configured_height;
+
+    /* Mapped state as of the last arrangement */
+    bool arranged_mapped;
+
+    /* Arrangement or size changed, but not yet passed on */
+    bool update_pending;
+
     struct wl_list popups;
     struct wl_list subsurfaces;
 
-    int size_constraints[10];
+    int size_constraints[14];
 
     struct wl_listener map;
     struct wl_listener unmap;
@@ -72,6 +84,7 @@ struct wm_view_layer {
 };
 
 void wm_view_layer_init(struct wm_view_layer* view, struct wm_server* server, struct wlr_layer_surface_v1* surface);
+int wm_view_is_layer(struct wm_view* view);
 
 
 #endif //
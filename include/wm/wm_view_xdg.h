@@ -68,6 +68,12 @@ struct wm_view_xdg {
     int width;
     int height;
 
+    /* Configure to wait for with wm_view::resize pending */
+    uint32_t resize_serial;
+
+    /* Configure acked by the last commit */
+    uint32_t committed_serial;
+
     int size_constraints[4];
 
     struct wl_listener map;
@@ -6,6 +6,7 @@
 #include <wlr/xwayland.h>
 
 #include "wm/wm_view.h"
+#include "wm/wm_xwayland_index.h"
 
 struct wm_view_xwayland;
 
@@ -17,7 +18,11 @@ struct wm_view_xwayland_child {
 
     bool mapped;
 
+    /* window_id -> parent */
+    struct wm_xwayland_index_entry window_entry;
+
     struct wl_listener request_configure;
+    struct wl_listener set_geometry;
     struct wl_listener map;
     struct wl_listener unmap;
     struct wl_listener destroy;
@@ -39,7 +44,12 @@ struct wm_view_xwayland {
 
     int size_constraints[4];
 
+    /* window_id -> view, pid -> view while mapped */
+    struct wm_xwayland_index_entry window_entry;
+    struct wm_xwayland_index_entry pid_entry;
+
     struct wl_listener request_configure;
+    struct wl_listener set_geometry;
     struct wl_listener set_parent;
     struct wl_listener set_pid;
     struct wl_listener map;
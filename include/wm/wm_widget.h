@@ -8,6 +8,7 @@
 #include "wm_content.h"
 
 struct wm_server;
+struct wm_atlas_region;
 
 struct wm_widget {
     struct wm_content super;
@@ -17,8 +18,9 @@ struct wm_widget {
      */
     struct wm_output* wm_output;
 
-    /* Either texture needs to be set, or primitive */
+    /* Either texture (small ones packed into the renderer's atlas) needs to be set, or primitive */
     struct wlr_texture* wlr_texture;
+    struct wm_atlas_region* atlas_region;
     struct {
         char* name;
         int n_params_int;
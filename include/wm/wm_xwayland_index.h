@@ -0,0 +1,50 @@
+#ifndef WM_XWAYLAND_INDEX_H
+#define WM_XWAYLAND_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <wayland-server.h>
+
+struct wm_view_xwayland;
+
+#define WM_XWAYLAND_INDEX_BITS 8
+#define WM_XWAYLAND_INDEX_BUCKETS (1 << WM_XWAYLAND_INDEX_BITS)
+
+/* Embedded in the indexed object */
+struct wm_xwayland_index_entry {
+    struct wl_list link; // wm_xwayland_index::*_buckets
+    bool indexed;
+
+    uint32_t key;
+
+    /* Top level view - for children their parent */
+    struct wm_view_xwayland* view;
+};
+
+/*
+ * X window_id to views and xwayland children, pid to mapped views
+ */
+struct wm_xwayland_index {
+    struct wl_list window_buckets[WM_XWAYLAND_INDEX_BUCKETS]; // wm_xwayland_index_entry::link
+    struct wl_list pid_buckets[WM_XWAYLAND_INDEX_BUCKETS]; // wm_xwayland_index_entry::link
+};
+
+void wm_xwayland_index_init(struct wm_xwayland_index* index);
+
+void wm_xwayland_index_entry_init(struct wm_xwayland_index_entry* entry);
+void wm_xwayland_index_add_window(struct wm_xwayland_index* index, struct wm_xwayland_index_entry* entry,
+        uint32_t window_id, struct wm_view_xwayland* view);
+void wm_xwayland_index_add_pid(struct wm_xwayland_index* index, struct wm_xwayland_index_entry* entry,
+        pid_t pid, struct wm_view_xwayland* view);
+
+/* No-op if not indexed */
+void wm_xwayland_index_remove(struct wm_xwayland_index_entry* entry);
+
+struct wm_view_xwayland* wm_xwayland_index_find_window(struct wm_xwayland_index* index, uint32_t window_id);
+
+/* Most recently mapped view of pid other than exclude */
+struct wm_view_xwayland* wm_xwayland_index_find_pid(struct wm_xwayland_index* index, pid_t pid,
+        struct wm_view_xwayland* exclude);
+
+#endif
@@ -1,6 +1,15 @@
-from typing import Any, Callable
+from typing import Any, Callable, Optional
 
 def run(**kwargs: dict[str, Any]) -> None: ...
 def register(func: str, call: Callable[..., Any]) -> None: ...
 def damage(code: int) -> None: ...
 def debug_performance(key: str) -> None: ...
+def texture_stats(reset: bool=...) -> dict[str, Any]: ...
+def transaction_stats(reset: bool=...) -> dict[str, Any]: ...
+def reconfigure_stats() -> dict[str, float]: ...
+def queue_gestures(kind: str, queued: bool, consume: bool) -> None: ...
+def gesture_fd() -> int: ...
+def pop_gestures() -> list[tuple[Any, ...]]: ...
+def set_keybindings(bindings: Optional[list[tuple[int, str]]]) -> None: ...
+def key_fd() -> int: ...
+def pop_keys() -> list[tuple[int, int, int, str]]: ...
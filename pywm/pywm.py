@@ -3,8 +3,8 @@ from typing import Callable, Optional, Any, TypeVar, Generic, Union, cast
 
 from abc import abstractmethod
 import logging
-import time
-from threading import Thread, Lock
+import select
+from threading import Thread
 
 from .pywm_widget import PyWMWidget
 from .pywm_view import PyWMView
@@ -13,7 +13,16 @@ from .damage_tracked import DamageTracked
 from ._pywm import (
     run,
     register,
-    damage
+    damage,
+    texture_stats,
+    transaction_stats,
+    reconfigure_stats,
+    queue_gestures,
+    gesture_fd,
+    pop_gestures,
+    set_keybindings,
+    key_fd,
+    pop_keys
 )
 
 PYWM_MOD_SHIFT = 1
@@ -25,6 +34,9 @@ PYWM_MOD_MOD3 = 32
 PYWM_MOD_LOGO = 64
 PYWM_MOD_MOD5 = 128
 
+""" Keybinding matches regardless of modifiers """
+PYWM_MOD_ANY = -1
+
 PYWM_RELEASED = 0
 PYWM_PRESSED = 1
 
@@ -148,7 +160,7 @@ ViewT = TypeVar('ViewT', bound=PyWMView)
 WidgetT = TypeVar('WidgetT', bound=PyWMWidget)
 
 class PyWMOutput:
-    def __init__(self, name: str, key: int, scale: float, width: int, height: int, pos: tuple[int, int]):
+    def __init__(self, name: str, key: int, scale: float, width: int, height: int, pos: tuple[int, int], usable_area: Optional[tuple[int, int, int, int]]=None):
         self.name = name
         self._key = key
         self.scale = scale
@@ -156,15 +168,25 @@ class PyWMOutput:
         self.height = height
         self.pos = pos
 
+        # x, y, width, height relative to pos - excluding exclusive zones of layer shell panels
+        self._usable_area = usable_area if usable_area is not None and usable_area[2] > 0 else (0, 0, width, height)
+
+        # Level of the render governor, 0 being full quality
+        self.render_quality = 0
+
+    @property
+    def usable_area(self) -> tuple[int, int, int, int]:
+        return self._usable_area
+
     def __str__(self) -> str:
-        return "Output(%s) key=%d with %dx%d, scale %f at %d, %d" % (self.name, self._key, self.width, self.height, self.scale, *self.pos)
+        return "Output(%s) key=%d with %dx%d, scale %f at %d, %d, usable %d, %d - %dx%d" % (self.name, self._key, self.width, self.height, self.scale, *self.pos, *self._usable_area)
 
     def __eq__(self, other: Any) -> bool:
         if not isinstance(other, PyWMOutput):
             return False
         return self._key == other._key
 
-class PyWMThread(Thread):
+class PyWMInputThread(Thread):
     def __init__(self, wm: PyWM) -> None:
         super().__init__()
         self.wm = wm
@@ -174,12 +196,18 @@ class PyWMThread(Thread):
         self.running = False
 
     def run(self) -> None:
-        i = 0
+        fds = [fd for fd in (gesture_fd(), key_fd()) if fd >= 0]
+        if len(fds) == 0:
+            return
+
         while self.running:
-            if i%10 == 0:
-                self.wm._update_idle(False)
-            i+=1
-            time.sleep(.1)
+            readable, _, _ = select.select(fds, [], [], .1)
+            if not readable:
+                continue
+            for kind, time_msec, *args in pop_gestures():
+                self.wm._gesture(kind, time_msec, *args)
+            for time_msec, keycode, state, keysyms in pop_keys():
+                self.wm._key(time_msec, keycode, state, keysyms)
 
 
 class PyWM(Generic[ViewT], DamageTracked):
@@ -195,6 +223,8 @@ class PyWM(Generic[ViewT], DamageTracked):
         register("key", self._key)
         register("modifiers", self._modifiers)
         register("gesture", self._gesture)
+        register("idle", self._idle)
+        register("render_quality", self._render_quality)
 
         register("update_view", self._update_view)
         register("destroy_view", self._destroy_view)
@@ -237,51 +267,7 @@ class PyWM(Generic[ViewT], DamageTracked):
         self.modifiers: PyWMModifiers = PyWMModifiers(0)
         self.cursor_pos: tuple[float, float] = (0, 0)
 
-        self._thread = PyWMThread(self)
-        self._idle_last_activity: float = time.time()
-        self._idle_last_update_active: float = time.time()
-        self._idle_last_update_inactive: float = time.time()
-
-        self._lock = Lock()
-
-
-    def _update_idle(self, activity: bool=True) -> None:
-        t = time.time()
-        # This is called once per frame
-        if not activity and t - self._idle_last_update_inactive < 0.5:
-            return
-
-        # Is called from touchpad thread as well as regular thread
-        if self._lock.acquire(blocking=False):
-            try:
-
-                inhibited = False
-                for _, v in self._views.items():
-                    if (up_state := v.up_state) is not None and up_state.is_inhibiting_idle:
-                        inhibited = True
-                        break
-
-                if activity:
-                    self._idle_last_activity = t
-
-                    if t - self._idle_last_update_active > 1:
-                        try:
-                            self.on_idle(0.0, inhibited)
-                        except Exception:
-                            logger.exception("on_idle active")
-                        self._idle_last_update_active = t
-                else:
-                    inactive_time = t - self._idle_last_activity
-                    if t - self._idle_last_update_inactive > 5 and inactive_time > 5:
-                        try:
-                            self.on_idle(inactive_time, inhibited)
-                        except Exception:
-                            logger.exception("on_idle inactive")
-                        self._idle_last_update_inactive = t
-
-            finally:
-                self._lock.release()
-
+        self._input_thread = PyWMInputThread(self)
 
 
     def _exec_main(self) -> None:
@@ -292,46 +278,53 @@ class PyWM(Generic[ViewT], DamageTracked):
     def _ready(self) -> None:
         logger.debug("PyWM ready")
         Thread(target=self._exec_main).start()
-        self._thread.start()
+        self._input_thread.start()
 
     @callback
     def _motion(self, time_msec: int, delta_x: float, delta_y: float, abs_x: float, abs_y: float) -> bool:
-        self._update_idle()
         self.cursor_pos = (abs_x, abs_y)
         return self.on_motion(time_msec, delta_x, delta_y)
 
     @callback
     def _button(self, time_msec: int, button: int, state: int) -> bool:
-        self._update_idle()
         return self.on_button(time_msec, button, state)
 
     @callback
     def _axis(self, time_msec: int, source: int, orientation: int, delta: float, delta_discrete: int) -> bool:
-        self._update_idle()
         return self.on_axis(time_msec, source, orientation, delta,
                             delta_discrete)
 
     @callback
     def _key(self, time_msec: int, keycode: int, state: int, keysyms: str) -> bool:
-        self._update_idle()
         return self.on_key(time_msec, keycode, state, keysyms)
 
     @callback
     def _modifiers(self, depressed: int, latched: int, locked: int, group: int) -> bool:
-        self._update_idle()
         last_modifiers = self.modifiers
         self.modifiers = PyWMModifiers(depressed)
         return self.on_modifiers(self.modifiers, last_modifiers)
 
     @callback
     def _gesture(self, kind: str, time_msec: int, *args: Any) -> bool:
-        self._update_idle()
         return self.on_gesture(kind, time_msec, cast(list[Union[float, int]], args))
 
     @callback
-    def _layout_change(self, outputs: list[tuple[str, int, float, int, int, int, int]]) -> None:
-        self._update_idle()
-        self.layout = [PyWMOutput(n, i, s, w, h, (px, py)) for n, i, s, w, h, px, py in outputs]
+    def _idle(self, elapsed: float, idle_inhibited: bool) -> None:
+        self.on_idle(elapsed, idle_inhibited)
+
+    @callback
+    def _render_quality(self, key: int, level: int) -> None:
+        for o in self.layout:
+            if o._key == key:
+                o.render_quality = level
+                self.on_render_quality(o, level)
+
+    @callback
+    def _layout_change(self, outputs: list[tuple[str, int, float, int, int, int, int, tuple[int, int, int, int]]]) -> None:
+        render_quality = {o.name: o.render_quality for o in self.layout}
+        self.layout = [PyWMOutput(n, i, s, w, h, (px, py), u) for n, i, s, w, h, px, py, u in outputs]
+        for o in self.layout:
+            o.render_quality = render_quality.get(o.name, 0)
         logger.debug("PyWM layout change:")
         for o in self.layout:
             logger.debug("  %s", str(o))
@@ -458,6 +451,44 @@ class PyWM(Generic[ViewT], DamageTracked):
     def damage_once(self) -> None:
         damage(2)
 
+    def texture_stats(self, reset: bool=False) -> dict[str, Any]:
+        """
+        Counts and timings (ms) of client buffer imports and reuses, and count of reduced copies for minified
+        rendering since the last reset
+        """
+        return texture_stats(reset)
+
+    def transaction_stats(self, reset: bool=False) -> dict[str, Any]:
+        """
+        Layout changes which waited for clients to resize: count, timeouts and summed / max latency (ms) since the last reset
+        """
+        return transaction_stats(reset)
+
+    def reconfigure_stats(self) -> dict[str, float]:
+        """
+        Subsystems (e.g. "keyboards", "cursor", "outputs") reloaded by the last reconfigure and how long each took (ms)
+        - subsystems unaffected by the changed keys are left alone
+        """
+        return reconfigure_stats()
+
+    def queue_gestures(self, kind: str, consume: bool=True) -> None:
+        """
+        Deliver gestures of kind ("pinch", "swipe" or "hold") to on_gesture from a separate thread - the compositor
+        does not wait for python; consume takes the place of the return value of on_gesture
+        """
+        queue_gestures(kind, True, consume)
+
+    def unqueue_gestures(self, kind: str) -> None:
+        queue_gestures(kind, False, False)
+
+    def set_keybindings(self, bindings: Optional[list[tuple[int, str]]]) -> None:
+        """
+        Only keys matching one of (modifiers, keysym) - modifiers as PYWM_MOD_* mask or PYWM_MOD_ANY, keysym as passed
+        to on_key - reach on_key, from a separate thread and always consumed. All other keys go to clients directly.
+        None (default) passes every key to on_key synchronously. Takes effect with the next frame
+        """
+        set_keybindings(bindings)
+
     """
     Public API
     """
@@ -473,7 +504,7 @@ class PyWM(Generic[ViewT], DamageTracked):
 
     def terminate(self) -> None:
         logger.debug("PyWM terminating")
-        self._thread.stop()
+        self._input_thread.stop()
         self._pending_terminate = True
 
     def open_virtual_output(self, name: str) -> None:
@@ -554,6 +585,9 @@ class PyWM(Generic[ViewT], DamageTracked):
         pass
 
     def on_layout_change(self) -> None:
+        """
+        Outputs or their usable areas (layer shell exclusive zones) changed
+        """
         pass
 
     def on_motion(self, time_msec: int, delta_x: float, delta_y: float) -> bool:
@@ -581,8 +615,19 @@ class PyWM(Generic[ViewT], DamageTracked):
 
     def on_idle(self, elapsed: float, idle_inhibited: bool) -> None:
         """
-        elapsed == 0 means there has been an activity, possibly a wakeup from idle is necessary
-        elapsed > 0 describes the amount of seconds which have passed since the last activity, possibly sleep is necessary
-        idle_inhibited is True if there is at least one view with is_inhibiting_idle==True
+        Only called on transitions:
+        elapsed == 0 means there has been an activity after idle, possibly a wakeup from idle is necessary
+        elapsed > 0 describes the amount of seconds which have passed since the last activity, once per timeout
+            configured in idle_timeouts (by default every 5s for the first minute, then coarser), possibly sleep is necessary
+        idle_inhibited is True if there is at least one view with is_inhibiting_idle==True - changes of it are
+            reported with the current elapsed time
+        """
+        pass
+
+    def on_render_quality(self, output: PyWMOutput, level: int) -> None:
+        """
+        The render governor has changed the quality of effects on output (config render_governor):
+        level == 0 is full quality, higher levels reduce blur passes, skip rounded corners during animations
+            and finally fall back to basic texture shaders
         """
         pass
@@ -21,7 +21,7 @@ class PyWMViewUpstreamState:
                  size_constraints: list[int],
                  offset_x: int, offset_y: int,
                  width: int, height: int,
-                 is_focused: bool, is_fullscreen: bool, is_maximized: bool, is_resizing: bool, is_inhibiting_idle: bool, shows_csd: bool, fixed_output: Optional[PyWMOutput]) -> None:
+                 is_focused: bool, is_fullscreen: bool, is_maximized: bool, is_resizing: bool, is_inhibiting_idle: bool, is_visible: bool, shows_csd: bool, fixed_output: Optional[PyWMOutput]) -> None:
 
         """
         Called from C - just to be sure, wrap every attribute in type constrcutor
@@ -32,9 +32,17 @@ class PyWMViewUpstreamState:
 
         """
         min_w, max_w, min_h, max_h for regular views
-        anchor, desired_width, desired_height, exclusive_zone, layer, margin - left, top, right, bottom for layer shell
+        anchor, desired_width, desired_height, exclusive_zone, layer, margin - left, top, right, bottom, keyboard_interactive,
+        arranged x, y, width, height for layer shell
         """
         self.size_constraints = [int(i) for i in size_constraints]
+
+        """
+        Layer shell only: x, y, width, height in layout coordinates as arranged (and configured) natively
+        """
+        self.layer_box: Optional[tuple[int, int, int, int]] = None
+        if len(self.size_constraints) >= 14 and self.size_constraints[12] > 0:
+            self.layer_box = (self.size_constraints[10], self.size_constraints[11], self.size_constraints[12], self.size_constraints[13])
         """
         describe the offset of actual content within the view
         (in case of CSD)
@@ -54,6 +62,12 @@ class PyWMViewUpstreamState:
         self.is_resizing = bool(is_resizing)
         self.is_inhibiting_idle = bool(is_inhibiting_idle)
 
+        """
+        False if off-screen, outside its workspace, transparent or covered by an opaque view
+        - hidden views only receive frame callbacks at a throttled rate
+        """
+        self.is_visible = bool(is_visible)
+
         self.shows_csd = shows_csd
 
         self.fixed_output = fixed_output
@@ -77,6 +91,8 @@ class PyWMViewUpstreamState:
             return True
         if self.is_inhibiting_idle != other.is_inhibiting_idle:
             return True
+        if self.is_visible != other.is_visible:
+            return True
         if self.fixed_output != other.fixed_output:
             return True
         return False
@@ -190,7 +206,7 @@ class PyWMView(Generic[PyWMT], DamageTracked):
     def _update(self,
                 general: Optional[tuple[int, bool, int, str, str, str]],
                 width: int, height: int,
-                is_mapped: bool, is_floating: bool, is_focused: bool, is_fullscreen: bool, is_maximized: bool, is_resizing: bool, is_inhibiting_idle: bool,
+                is_mapped: bool, is_floating: bool, is_focused: bool, is_fullscreen: bool, is_maximized: bool, is_resizing: bool, is_inhibiting_idle: bool, is_visible: bool,
                 size_constraints: list[int],
                 offset_x: int, offset_y: int,
                 shows_csd: bool,
@@ -215,7 +231,7 @@ class PyWMView(Generic[PyWMT], DamageTracked):
             size_constraints,
             offset_x, offset_y,
             width, height,
-            is_focused, is_fullscreen, is_maximized, is_resizing, is_inhibiting_idle,
+            is_focused, is_fullscreen, is_maximized, is_resizing, is_inhibiting_idle, is_visible,
             shows_csd,
             self.wm.get_output_by_key(fixed_output_key) if fixed_output_key >= 0 else None
         )
@@ -330,6 +346,10 @@ class PyWMView(Generic[PyWMT], DamageTracked):
         pass
 
     def on_event(self, event: str) -> None:
+        """
+        event is one of "request_fullscreen", "request_nofullscreen", "request_move", "request_resize", "request_minimize",
+        "request_maximize", "request_show_window_menu" or "resize_caught_up" (client has committed the size last requested)
+        """
         pass
 
     @abstractmethod
@@ -8,6 +8,7 @@
 #include "wm/wm_output.h"
 #include "py/_pywm_callbacks.h"
 #include "py/_pywm_view.h"
+#include "py/_pywm_gestures.h"
 
 static struct _pywm_callbacks callbacks = { 0 };
 
@@ -53,14 +54,18 @@ static void call_layout_change(struct wm_layout* layout){
             wlr_output_effective_resolution(output->wlr_output, &width, &height);
 
             PyList_SetItem(list, i, Py_BuildValue(
-                               "(sidiiii)",
+                               "(sidiiii(iiii))",
                                output->wlr_output->name,
                                output->key,
                                output->wlr_output->scale,
                                width,
                                height,
                                output->layout_x,
-                               output->layout_y));
+                               output->layout_y,
+                               output->usable_area.x,
+                               output->usable_area.y,
+                               output->usable_area.width,
+                               output->usable_area.height));
             i++;
         }
         PyObject* args = Py_BuildValue("(O)", list);
@@ -70,6 +75,21 @@ static void call_layout_change(struct wm_layout* layout){
 }
 
 static bool call_key(struct wlr_event_keyboard_key* event, const char* keysyms){
+    if(get_wm()->keybindings.enabled){
+        /* Only bound keys arrive here - consumed unless python is too far behind to take the press */
+        if(event->state == WL_KEYBOARD_KEY_STATE_PRESSED &&
+                _pywm_queue_free(&callbacks.keys) <= _PYWM_KEYS_QUEUE_RESERVED){
+            wlr_log(WLR_INFO, "Keys: Queue full - passing on bound key");
+            return false;
+        }
+
+        struct _pywm_key_event queued = {
+            .time_msec = event->time_msec, .keycode = event->keycode, .state = event->state };
+        strncpy(queued.keysyms, keysyms, _PYWM_KEYS_LENGTH - 1);
+        _pywm_queue_push(&callbacks.keys, &queued);
+        return true;
+    }
+
     if(callbacks.key){
         PyGILState_STATE gil = PyGILState_Ensure();
         PyObject* args = Py_BuildValue("(iiis)", event->time_msec, event->keycode, event->state, keysyms);
@@ -132,6 +152,13 @@ static bool call_axis(struct wlr_event_pointer_axis* event){
 }
 
 static bool call_pinch_begin(struct wlr_event_pointer_pinch_begin* event){
+    if(_pywm_gestures_is_queued(_PYWM_GESTURE_PINCH)){
+        struct _pywm_gesture_event queued = {
+            .kind = _PYWM_GESTURE_PINCH, .phase = _PYWM_GESTURE_BEGIN, .time_msec = event->time_msec,
+            .fingers = event->fingers };
+        return _pywm_gestures_push(&queued);
+    }
+
     if(callbacks.gesture){
         PyGILState_STATE gil = PyGILState_Ensure();
         PyObject* args = Py_BuildValue("(sii)", "pinch", event->time_msec, event->fingers);
@@ -143,6 +170,14 @@ static bool call_pinch_begin(struct wlr_event_pointer_pinch_begin* event){
     return false;
 }
 static bool call_pinch_update(struct wlr_event_pointer_pinch_update* event){
+    if(_pywm_gestures_is_queued(_PYWM_GESTURE_PINCH)){
+        struct _pywm_gesture_event queued = {
+            .kind = _PYWM_GESTURE_PINCH, .phase = _PYWM_GESTURE_UPDATE, .time_msec = event->time_msec,
+            .fingers = event->fingers,
+            .dx = event->dx, .dy = event->dy, .rotation = event->rotation, .scale = event->scale };
+        return _pywm_gestures_push(&queued);
+    }
+
     if(callbacks.gesture){
         PyGILState_STATE gil = PyGILState_Ensure();
         PyObject* args = Py_BuildValue("(siidddd)", "pinch", event->time_msec, event->fingers, event->dx, event->dy, event->rotation, event->scale);
@@ -154,6 +189,13 @@ static bool call_pinch_update(struct wlr_event_pointer_pinch_update* event){
     return false;
 }
 static bool call_pinch_end(struct wlr_event_pointer_pinch_end* event){
+    if(_pywm_gestures_is_queued(_PYWM_GESTURE_PINCH)){
+        struct _pywm_gesture_event queued = {
+            .kind = _PYWM_GESTURE_PINCH, .phase = _PYWM_GESTURE_END, .time_msec = event->time_msec,
+            .cancelled = event->cancelled };
+        return _pywm_gestures_push(&queued);
+    }
+
     if(callbacks.gesture){
         PyGILState_STATE gil = PyGILState_Ensure();
         PyObject* args = Py_BuildValue("(sii)", "pinch", event->time_msec, event->cancelled);
@@ -165,6 +207,13 @@ static bool call_pinch_end(struct wlr_event_pointer_pinch_end* event){
     return false;
 }
 static bool call_swipe_begin(struct wlr_event_pointer_swipe_begin* event){
+    if(_pywm_gestures_is_queued(_PYWM_GESTURE_SWIPE)){
+        struct _pywm_gesture_event queued = {
+            .kind = _PYWM_GESTURE_SWIPE, .phase = _PYWM_GESTURE_BEGIN, .time_msec = event->time_msec,
+            .fingers = event->fingers };
+        return _pywm_gestures_push(&queued);
+    }
+
     if(callbacks.gesture){
         PyGILState_STATE gil = PyGILState_Ensure();
         PyObject* args = Py_BuildValue("(sii)", "swipe", event->time_msec, event->fingers);
@@ -176,6 +225,14 @@ static bool call_swipe_begin(struct wlr_event_pointer_swipe_begin* event){
     return false;
 }
 static bool call_swipe_update(struct wlr_event_pointer_swipe_update* event){
+    if(_pywm_gestures_is_queued(_PYWM_GESTURE_SWIPE)){
+        struct _pywm_gesture_event queued = {
+            .kind = _PYWM_GESTURE_SWIPE, .phase = _PYWM_GESTURE_UPDATE, .time_msec = event->time_msec,
+            .fingers = event->fingers,
+            .dx = event->dx, .dy = event->dy };
+        return _pywm_gestures_push(&queued);
+    }
+
     if(callbacks.gesture){
         PyGILState_STATE gil = PyGILState_Ensure();
         PyObject* args = Py_BuildValue("(siidd)", "swipe", event->time_msec, event->fingers, event->dx, event->dy);
@@ -187,6 +244,13 @@ static bool call_swipe_update(struct wlr_event_pointer_swipe_update* event){
     return false;
 }
 static bool call_swipe_end(struct wlr_event_pointer_swipe_end* event){
+    if(_pywm_gestures_is_queued(_PYWM_GESTURE_SWIPE)){
+        struct _pywm_gesture_event queued = {
+            .kind = _PYWM_GESTURE_SWIPE, .phase = _PYWM_GESTURE_END, .time_msec = event->time_msec,
+            .cancelled = event->cancelled };
+        return _pywm_gestures_push(&queued);
+    }
+
     if(callbacks.gesture){
         PyGILState_STATE gil = PyGILState_Ensure();
         PyObject* args = Py_BuildValue("(sii)", "swipe", event->time_msec, event->cancelled);
@@ -198,6 +262,13 @@ static bool call_swipe_end(struct wlr_event_pointer_swipe_end* event){
     return false;
 }
 static bool call_hold_begin(struct wlr_event_pointer_hold_begin* event){
+    if(_pywm_gestures_is_queued(_PYWM_GESTURE_HOLD)){
+        struct _pywm_gesture_event queued = {
+            .kind = _PYWM_GESTURE_HOLD, .phase = _PYWM_GESTURE_BEGIN, .time_msec = event->time_msec,
+            .fingers = event->fingers };
+        return _pywm_gestures_push(&queued);
+    }
+
     if(callbacks.gesture){
         PyGILState_STATE gil = PyGILState_Ensure();
         PyObject* args = Py_BuildValue("(sii)", "hold", event->time_msec, event->fingers);
@@ -209,6 +280,13 @@ static bool call_hold_begin(struct wlr_event_pointer_hold_begin* event){
     return false;
 }
 static bool call_hold_end(struct wlr_event_pointer_hold_end* event){
+    if(_pywm_gestures_is_queued(_PYWM_GESTURE_HOLD)){
+        struct _pywm_gesture_event queued = {
+            .kind = _PYWM_GESTURE_HOLD, .phase = _PYWM_GESTURE_END, .time_msec = event->time_msec,
+            .cancelled = event->cancelled };
+        return _pywm_gestures_push(&queued);
+    }
+
     if(callbacks.gesture){
         PyGILState_STATE gil = PyGILState_Ensure();
         PyObject* args = Py_BuildValue("(sii)", "hold", event->time_msec, event->cancelled);
@@ -249,6 +327,24 @@ static void call_view_event(struct wm_view* view, const char* event){
 }
 
 
+static void call_idle(double elapsed, bool inhibited){
+    if(callbacks.idle){
+        PyGILState_STATE gil = PyGILState_Ensure();
+        PyObject* args = Py_BuildValue("(dO)", elapsed, inhibited ? Py_True : Py_False);
+        call_void(callbacks.idle, args);
+        PyGILState_Release(gil);
+    }
+}
+
+static void call_render_quality(struct wm_output* output, int level){
+    if(callbacks.render_quality){
+        PyGILState_STATE gil = PyGILState_Ensure();
+        PyObject* args = Py_BuildValue("(ii)", output->key, level);
+        call_void(callbacks.render_quality, args);
+        PyGILState_Release(gil);
+    }
+}
+
 static void call_ready(){
     if(callbacks.ready){
         PyGILState_STATE gil = PyGILState_Ensure();
@@ -262,6 +358,8 @@ static void call_ready(){
  * Public interface
  */
 void _pywm_callbacks_init(){
+    _pywm_queue_init(&callbacks.keys, _PYWM_KEYS_QUEUE_SIZE, sizeof(struct _pywm_key_event));
+
     get_wm()->callback_ready = &call_ready;
     get_wm()->callback_layout_change = &call_layout_change;
     get_wm()->callback_key = &call_key;
@@ -282,6 +380,8 @@ void _pywm_callbacks_init(){
     get_wm()->callback_init_view = &call_init_view;
     get_wm()->callback_destroy_view = &call_destroy_view;
     get_wm()->callback_view_event = &call_view_event;
+    get_wm()->callback_idle = &call_idle;
+    get_wm()->callback_render_quality = &call_render_quality;
 }
 
 PyObject** _pywm_callbacks_get(const char* name){
@@ -297,6 +397,10 @@ PyObject** _pywm_callbacks_get(const char* name){
         return &callbacks.modifiers;
     }else if(!strcmp(name, "gesture")){
         return &callbacks.gesture;
+    }else if(!strcmp(name, "idle")){
+        return &callbacks.idle;
+    }else if(!strcmp(name, "render_quality")){
+        return &callbacks.render_quality;
     }else if(!strcmp(name, "layout_change")){
         return &callbacks.layout_change;
     }else if(!strcmp(name, "ready")){
@@ -323,3 +427,16 @@ PyObject** _pywm_callbacks_get(const char* name){
 struct _pywm_callbacks* _pywm_callbacks_get_all(){
     return &callbacks;
 }
+
+PyObject* _pywm_callbacks_pop_keys(){
+    size_t n = _pywm_queue_acquire(&callbacks.keys);
+
+    PyObject* list = PyList_New(n);
+    for(size_t i=0; i<n; i++){
+        struct _pywm_key_event* event = _pywm_queue_at(&callbacks.keys, i);
+        PyList_SetItem(list, i, Py_BuildValue("(iiis)", event->time_msec, event->keycode, event->state, event->keysyms));
+    }
+
+    _pywm_queue_release(&callbacks.keys, n);
+    return list;
+}
@@ -0,0 +1,151 @@
+#include <Python.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include "py/_pywm_gestures.h"
+
+static struct _pywm_gestures gestures = { 0 };
+
+static const char* kind_names[_PYWM_GESTURE_N] = {
+    [_PYWM_GESTURE_PINCH] = "pinch",
+    [_PYWM_GESTURE_SWIPE] = "swipe",
+    [_PYWM_GESTURE_HOLD] = "hold",
+};
+
+/*
+ * Helpers
+ */
+static PyObject* build_event(struct _pywm_gesture_event* event){
+    const char* kind = kind_names[event->kind];
+
+    /* Same format as in _pywm_callbacks.c */
+    switch(event->phase){
+        case _PYWM_GESTURE_BEGIN:
+            return Py_BuildValue("(sii)", kind, event->time_msec, event->fingers);
+        case _PYWM_GESTURE_UPDATE:
+            if(event->kind == _PYWM_GESTURE_PINCH){
+                return Py_BuildValue("(siidddd)", kind, event->time_msec, event->fingers,
+                        event->dx, event->dy, event->rotation, event->scale);
+            }
+            return Py_BuildValue("(siidd)", kind, event->time_msec, event->fingers, event->dx, event->dy);
+        case _PYWM_GESTURE_END:
+            return Py_BuildValue("(sii)", kind, event->time_msec, event->cancelled);
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+/*
+ * Slots kept free for every kind to flush its merged UPDATE and push its END - so a gesture
+ * which has begun in python is always ended there
+ */
+#define RESERVED (2 * _PYWM_GESTURE_N)
+
+static void merge_update(struct _pywm_gesture_event* merged, struct _pywm_gesture_event* event){
+    merged->time_msec = event->time_msec;
+    merged->fingers = event->fingers;
+    merged->dx += event->dx;
+    merged->dy += event->dy;
+    merged->rotation += event->rotation;
+
+    /* Absolute, relative to BEGIN */
+    merged->scale = event->scale;
+}
+
+static void flush_merged(enum _pywm_gesture_kind kind){
+    if(!gestures.has_merged[kind]) return;
+    _pywm_queue_push(&gestures.queue, &gestures.merged[kind]);
+    gestures.has_merged[kind] = false;
+}
+
+static void push(struct _pywm_gesture_event* event){
+    enum _pywm_gesture_kind kind = event->kind;
+    switch(event->phase){
+        case _PYWM_GESTURE_BEGIN:
+            gestures.dropping[kind] = _pywm_queue_free(&gestures.queue) <= RESERVED;
+            if(gestures.dropping[kind]){
+                wlr_log(WLR_INFO, "Gestures: Queue full - dropping %s gesture", kind_names[kind]);
+                return;
+            }
+            _pywm_queue_push(&gestures.queue, event);
+            break;
+
+        case _PYWM_GESTURE_UPDATE:
+            if(gestures.dropping[kind]) return;
+
+            /* Keep the order - an earlier merged UPDATE goes first */
+            if(gestures.has_merged[kind] && _pywm_queue_free(&gestures.queue) > RESERVED){
+                flush_merged(kind);
+            }
+            if(!gestures.has_merged[kind] && _pywm_queue_free(&gestures.queue) > RESERVED){
+                _pywm_queue_push(&gestures.queue, event);
+            }else if(gestures.has_merged[kind]){
+                merge_update(&gestures.merged[kind], event);
+            }else{
+                gestures.merged[kind] = *event;
+                gestures.has_merged[kind] = true;
+            }
+            break;
+
+        case _PYWM_GESTURE_END:
+            if(gestures.dropping[kind]){
+                gestures.dropping[kind] = false;
+                return;
+            }
+
+            /* Never dropped - the reserve has room */
+            flush_merged(kind);
+            _pywm_queue_push(&gestures.queue, event);
+            break;
+    }
+}
+
+/*
+ * Public interface
+ */
+void _pywm_gestures_init(){
+    for(int i=0; i<_PYWM_GESTURE_N; i++){
+        atomic_init(&gestures.queued[i], false);
+        atomic_init(&gestures.consume[i], false);
+        gestures.has_merged[i] = false;
+        gestures.dropping[i] = false;
+    }
+    _pywm_queue_init(&gestures.queue, _PYWM_GESTURES_QUEUE_SIZE, sizeof(struct _pywm_gesture_event));
+}
+
+int _pywm_gestures_kind(const char* name){
+    for(int i=0; i<_PYWM_GESTURE_N; i++){
+        if(!strcmp(name, kind_names[i])) return i;
+    }
+    return -1;
+}
+
+void _pywm_gestures_set_queued(enum _pywm_gesture_kind kind, bool queued, bool consume){
+    atomic_store(&gestures.consume[kind], consume);
+    atomic_store(&gestures.queued[kind], queued);
+}
+
+bool _pywm_gestures_is_queued(enum _pywm_gesture_kind kind){
+    return atomic_load_explicit(&gestures.queued[kind], memory_order_relaxed);
+}
+
+bool _pywm_gestures_push(struct _pywm_gesture_event* event){
+    push(event);
+    return atomic_load_explicit(&gestures.consume[event->kind], memory_order_relaxed);
+}
+
+PyObject* _pywm_gestures_pop(){
+    size_t n = _pywm_queue_acquire(&gestures.queue);
+
+    PyObject* list = PyList_New(n);
+    for(size_t i=0; i<n; i++){
+        PyList_SetItem(list, i, build_event(_pywm_queue_at(&gestures.queue, i)));
+    }
+
+    _pywm_queue_release(&gestures.queue, n);
+    return list;
+}
+
+int _pywm_gestures_get_fd(){
+    return gestures.queue.fd;
+}
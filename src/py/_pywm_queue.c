@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <wlr/util/log.h>
+#include "py/_pywm_queue.h"
+
+void _pywm_queue_init(struct _pywm_queue* queue, size_t capacity, size_t element_size){
+    queue->capacity = capacity;
+    queue->element_size = element_size;
+    queue->elements = calloc(capacity, element_size);
+
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->n_dropped, 0);
+
+    queue->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(queue->fd < 0){
+        wlr_log(WLR_ERROR, "Queue: Could not create eventfd");
+    }
+}
+
+bool _pywm_queue_push(struct _pywm_queue* queue, const void* element){
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if(head - tail >= queue->capacity){
+        /* Python is not keeping up - losing an element is better than blocking */
+        if(atomic_fetch_add(&queue->n_dropped, 1) % 100 == 0){
+            wlr_log(WLR_INFO, "Queue: Full - dropping elements");
+        }
+        return false;
+    }
+
+    memcpy(queue->elements + (head & (queue->capacity - 1)) * queue->element_size, element, queue->element_size);
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+    uint64_t one = 1;
+    if(queue->fd >= 0 && write(queue->fd, &one, sizeof(one)) < 0){
+        /* Counter can only overflow if python does not read at all */
+    }
+    return true;
+}
+
+size_t _pywm_queue_free(struct _pywm_queue* queue){
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    return queue->capacity - (head - tail);
+}
+
+size_t _pywm_queue_acquire(struct _pywm_queue* queue){
+    /* Reset before looking at head, so a concurrent push leaves the fd readable */
+    if(queue->fd >= 0){
+        uint64_t cnt;
+        if(read(queue->fd, &cnt, sizeof(cnt)) < 0){
+            /* EAGAIN - nothing pending */
+        }
+    }
+
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    return head - tail;
+}
+
+void* _pywm_queue_at(struct _pywm_queue* queue, size_t i){
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    return queue->elements + ((tail + i) & (queue->capacity - 1)) * queue->element_size;
+}
+
+void _pywm_queue_release(struct _pywm_queue* queue, size_t n){
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    atomic_store_explicit(&queue->tail, tail + n, memory_order_release);
+}
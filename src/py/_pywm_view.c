@@ -6,6 +6,8 @@
 #include "wm/wm.h"
 #include "wm/wm_view.h"
 #include "wm/wm_output.h"
+#include "wm/wm_server.h"
+#include "wm/wm_transaction.h"
 #ifdef WM_HAS_XWAYLAND
 #include "wm/wm_view_xwayland.h"
 #endif
@@ -83,6 +85,7 @@ void _pywm_view_update(struct _pywm_view* view){
     int is_resizing = wm_view_is_resizing(view->view);
 
     int is_inhibiting_idle = wm_view_is_inhibiting_idle(view->view);
+    int is_visible = wm_view_is_visible(view->view);
 
     struct wm_output* fixed_output = wm_content_get_output(&view->view->super);
     int fixed_output_key = fixed_output ? fixed_output->key : -1;
@@ -102,7 +105,7 @@ void _pywm_view_update(struct _pywm_view* view){
     bool shows_csd = wm_view_shows_csd(view->view);
 
     PyObject* args = Py_BuildValue(
-            "(lOiiOOOOOOOOiiOi)",
+            "(lOiiOOOOOOOOOiiOi)",
 
             view->handle,
             args_general,
@@ -117,6 +120,7 @@ void _pywm_view_update(struct _pywm_view* view){
             is_maximized ? Py_True : Py_False,
             is_resizing ? Py_True : Py_False,
             is_inhibiting_idle ? Py_True : Py_False,
+            is_visible ? Py_True : Py_False,
 
             args_size_constraints,
 
@@ -176,7 +180,7 @@ void _pywm_view_update(struct _pywm_view* view){
             wm_content_set_corner_radius(&view->view->super, corner_radius);
             if(floating >= 0)
                 wm_view_set_floating(view->view, floating);
-            wm_content_set_box(&view->view->super, x, y, w, h);
+            wm_transaction_set_box(view->view->super.wm_server->wm_transaction, &view->view->super, x, y, w, h);
 
             /* Set output before triggering configure in request_size */
             if(new_fixed_output_key != fixed_output_key)
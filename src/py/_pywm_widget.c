@@ -7,6 +7,8 @@
 #include "wm/wm.h"
 #include "wm/wm_widget.h"
 #include "wm/wm_composite.h"
+#include "wm/wm_server.h"
+#include "wm/wm_transaction.h"
 #include "py/_pywm_widget.h"
 #include "py/_pywm_callbacks.h"
 #include "wm/wm_util.h"
@@ -58,7 +60,7 @@ void _pywm_widget_update(struct _pywm_widget* widget){
         wm_content_set_opacity(widget->super, opacity);
         wm_content_set_corner_radius(widget->super, corner_radius);
         if(w >= 0.0 && h >= 0.0)
-            wm_content_set_box(widget->super, x, y, w, h);
+            wm_transaction_set_box(widget->super->wm_server->wm_transaction, widget->super, x, y, w, h);
         wm_content_set_mask(widget->super, mask_x, mask_y, mask_w, mask_h);
         wm_content_set_z_index(widget->super, z_index);
         wm_content_set_lock_enabled(widget->super, lock_enabled);
@@ -5,14 +5,25 @@
 #include <signal.h>
 #include <execinfo.h>
 #include <wlr/util/log.h>
+#include <xkbcommon/xkbcommon.h>
 #include "wm/wm.h"
 #include "wm/wm_config.h"
 #include "wm/wm_server.h"
 #include "wm/wm_layout.h"
 #include "wm/wm_util.h"
+#include "wm/wm_texture_cache.h"
+#include "wm/wm_transaction.h"
 #include "py/_pywm_callbacks.h"
 #include "py/_pywm_view.h"
 #include "py/_pywm_widget.h"
+#include "py/_pywm_gestures.h"
+
+/* Set from any python thread, applied in handle_update on the compositor thread */
+static struct {
+    bool pending;
+    int n_bindings;
+    struct wm_keybinding* bindings;
+} pending_keybindings = { 0 };
 
 static void sig_handler(int sig) {
     void *array[10];
@@ -25,7 +36,9 @@ static void sig_handler(int sig) {
 }
 
 static void set_config(struct wm_config* conf, PyObject* dict, int reconfigure){
+    struct wm_config_previous previous;
     if(reconfigure){
+        wm_config_save_previous(conf, &previous);
         wm_config_reset_default(conf);
     }
 
@@ -63,6 +76,12 @@ static void set_config(struct wm_config* conf, PyObject* dict, int reconfigure){
 
     o = PyDict_GetItemString(dict, "texture_shaders"); if(o){ strncpy(conf->texture_shaders, PyBytes_AsString(o), WM_CONFIG_STRLEN-1); }
     o = PyDict_GetItemString(dict, "renderer_mode"); if(o){ strncpy(conf->renderer_mode, PyBytes_AsString(o), WM_CONFIG_STRLEN-1); }
+    o = PyDict_GetItemString(dict, "render_governor"); if(o){ conf->render_governor = o == Py_True; }
+    o = PyDict_GetItemString(dict, "render_cache"); if(o){ conf->render_cache = o == Py_True; }
+    o = PyDict_GetItemString(dict, "resize_placeholder"); if(o){ strncpy(conf->resize_placeholder, PyBytes_AsString(o), WM_CONFIG_STRLEN-1); }
+    o = PyDict_GetItemString(dict, "downscale_threshold"); if(o){ conf->downscale_threshold = PyFloat_AsDouble(o); }
+    o = PyDict_GetItemString(dict, "native_buffer_scale"); if(o){ conf->native_buffer_scale = o == Py_True; }
+    o = PyDict_GetItemString(dict, "transaction_timeout_ms"); if(o){ conf->transaction_timeout_ms = PyLong_AsLong(o); }
 
     o = PyDict_GetItemString(dict, "xcursor_theme"); if(o){ wm_config_set_xcursor_theme(conf, PyBytes_AsString(o)); }
     o = PyDict_GetItemString(dict, "xcursor_size"); if(o){ wm_config_set_xcursor_size(conf, PyLong_AsLong(o)); }
@@ -73,13 +92,41 @@ static void set_config(struct wm_config* conf, PyObject* dict, int reconfigure){
 
     o = PyDict_GetItemString(dict, "tap_to_click"); if(o){ conf->tap_to_click = o == Py_True; }
     o = PyDict_GetItemString(dict, "natural_scroll"); if(o){ conf->natural_scroll = o == Py_True; }
+    o = PyDict_GetItemString(dict, "coalesce_motion"); if(o){ conf->coalesce_motion = o == Py_True; }
+    o = PyDict_GetItemString(dict, "idle_timeouts");
+    if(o){
+        /* Invalid lists leave the default in place */
+        if(!PyList_Check(o) || PyList_Size(o) > WM_CONFIG_IDLE_TIMEOUTS){
+            wlr_log(WLR_ERROR, "idle_timeouts: Expected list of at most %d numbers", WM_CONFIG_IDLE_TIMEOUTS);
+        }else{
+            double timeouts[WM_CONFIG_IDLE_TIMEOUTS];
+            int n = PyList_Size(o);
+            bool valid = true;
+            for(int i=0; i<n && valid; i++){
+                PyObject* t = PyList_GetItem(o, i);
+                valid = PyNumber_Check(t) && !PyBool_Check(t);
+                if(valid){
+                    timeouts[i] = PyFloat_AsDouble(t);
+                    valid = !PyErr_Occurred() && timeouts[i] > 0.;
+                }
+                PyErr_Clear();
+            }
+
+            if(valid){
+                memcpy(conf->idle_timeouts, timeouts, n * sizeof(double));
+                conf->n_idle_timeouts = n;
+            }else{
+                wlr_log(WLR_ERROR, "idle_timeouts: Expected positive numbers");
+            }
+        }
+    }
 
     o = PyDict_GetItemString(dict, "enable_xwayland"); if(o){ conf->enable_xwayland = o == Py_True; }
     o = PyDict_GetItemString(dict, "debug"); if(o){ conf->debug = o == Py_True; }
 
     if(reconfigure){
         wlr_log(WLR_DEBUG, "Reconfiguring PyWM...");
-        wm_config_reconfigure(conf, get_wm()->server);
+        wm_config_reconfigure(conf, &previous, get_wm()->server);
         wlr_log(WLR_DEBUG, "...done");
     }
 }
@@ -96,6 +143,12 @@ static void handle_update_view(struct wm_view* view){
 static void handle_update(){
     PyGILState_STATE gil = PyGILState_Ensure();
 
+    if(pending_keybindings.pending){
+        wm_keybindings_set(&get_wm()->keybindings, pending_keybindings.n_bindings, pending_keybindings.bindings);
+        pending_keybindings.pending = false;
+        pending_keybindings.bindings = NULL;
+    }
+
     TIMER_START(callback_update_pywm);
     PyObject* args = Py_BuildValue("()");
     PyObject* res = PyObject_Call(_pywm_callbacks_get_all()->update, args, NULL);
@@ -144,6 +197,9 @@ static void handle_update(){
     TIMER_STOP(callback_update_pywm);
     TIMER_PRINT(callback_update_pywm);
 
+    /* Boxes of views and widgets are applied together, possibly after clients have resized */
+    wm_transaction_begin(get_wm()->server->wm_transaction);
+
     TIMER_START(callback_update_views);
     _pywm_views_update();
     TIMER_STOP(callback_update_views);
@@ -155,6 +211,8 @@ static void handle_update(){
     TIMER_STOP(callback_update_widgets);
     TIMER_PRINT(callback_update_widgets);
 
+    wm_transaction_commit(get_wm()->server->wm_transaction);
+
 
     PyGILState_Release(gil);
 }
@@ -251,12 +309,161 @@ static PyObject* _pywm_debugperformance(PyObject* self, PyObject* args){
     return Py_None;
 }
 
+static PyObject* _pywm_texture_stats(PyObject* self, PyObject* args){
+    int reset = 0;
+
+    if(!PyArg_ParseTuple(args, "|p", &reset)){
+        PyErr_SetString(PyExc_TypeError, "Invalid parameters");
+        return NULL;
+    }
+
+    struct wm_texture_cache* cache = get_wm()->server->wm_texture_cache;
+    PyObject* res = Py_BuildValue("{s:l,s:l,s:d,s:d,s:l,s:d,s:l}",
+            "commits", cache->stats.n_commits,
+            "imports", cache->stats.n_imports,
+            "import_ms", cache->stats.import_nsec / 1000000.,
+            "import_ms_max", cache->stats.import_nsec_max / 1000000.,
+            "reuses", cache->stats.n_reuses,
+            "reuse_ms", cache->stats.reuse_nsec / 1000000.,
+            "downscales", cache->stats.n_downscales);
+
+    if(reset){
+        wm_texture_cache_reset_stats(cache);
+    }
+
+    return res;
+}
+
+static PyObject* _pywm_transaction_stats(PyObject* self, PyObject* args){
+    int reset = 0;
+
+    if(!PyArg_ParseTuple(args, "|p", &reset)){
+        PyErr_SetString(PyExc_TypeError, "Invalid parameters");
+        return NULL;
+    }
+
+    struct wm_transaction* transaction = get_wm()->server->wm_transaction;
+    PyObject* res = Py_BuildValue("{s:l,s:l,s:d,s:d}",
+            "transactions", transaction->stats.n_transactions,
+            "timeouts", transaction->stats.n_timeouts,
+            "latency_ms", transaction->stats.latency_nsec / 1000000.,
+            "latency_ms_max", transaction->stats.latency_nsec_max / 1000000.);
+
+    if(reset){
+        wm_transaction_reset_stats(transaction);
+    }
+
+    return res;
+}
+
+static PyObject* _pywm_reconfigure_stats(PyObject* self, PyObject* args){
+    struct wm_config_reload* reload = &get_wm()->server->wm_config->last_reload;
+
+    PyObject* res = PyDict_New();
+    for(int i=0; i<WM_CONFIG_N_SUBSYSTEMS; i++){
+        if(!reload->reloaded[i]) continue;
+
+        PyObject* msec = PyFloat_FromDouble(reload->msec[i]);
+        PyDict_SetItemString(res, wm_config_subsystem_name(i), msec);
+        Py_DECREF(msec);
+    }
+
+    return res;
+}
+
+static PyObject* _pywm_queue_gestures(PyObject* self, PyObject* args){
+    const char* name;
+    int queued;
+    int consume;
+
+    if(!PyArg_ParseTuple(args, "spp", &name, &queued, &consume)){
+        PyErr_SetString(PyExc_TypeError, "Invalid parameters");
+        return NULL;
+    }
+
+    int kind = _pywm_gestures_kind(name);
+    if(kind < 0){
+        PyErr_SetString(PyExc_TypeError, "Unknown gesture");
+        return NULL;
+    }
+
+    _pywm_gestures_set_queued(kind, queued, consume);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject* _pywm_gesture_fd(PyObject* self, PyObject* args){
+    return Py_BuildValue("i", _pywm_gestures_get_fd());
+}
+
+static PyObject* _pywm_pop_gestures(PyObject* self, PyObject* args){
+    return _pywm_gestures_pop();
+}
+
+static PyObject* _pywm_set_keybindings(PyObject* self, PyObject* args){
+    PyObject* list;
+
+    if(!PyArg_ParseTuple(args, "O", &list) || (list != Py_None && !PyList_Check(list))){
+        PyErr_SetString(PyExc_TypeError, "Invalid parameters");
+        return NULL;
+    }
+
+    int n_bindings = -1;
+    struct wm_keybinding* bindings = NULL;
+    if(list != Py_None){
+        n_bindings = PyList_Size(list);
+        bindings = calloc(n_bindings ? n_bindings : 1, sizeof(struct wm_keybinding));
+        for(int i=0; i<n_bindings; i++){
+            long modifiers;
+            const char* name;
+            if(!PyArg_ParseTuple(PyList_GetItem(list, i), "ls", &modifiers, &name)){
+                free(bindings);
+                PyErr_SetString(PyExc_TypeError, "Expected list of (modifiers, keysym)");
+                return NULL;
+            }
+
+            bindings[i].modifiers = modifiers < 0 ? WM_KEYBINDING_ANY_MODIFIERS : (uint32_t)modifiers;
+            bindings[i].keysym = xkb_keysym_from_name(name, XKB_KEYSYM_NO_FLAGS);
+            if(bindings[i].keysym == XKB_KEY_NoSymbol){
+                free(bindings);
+                PyErr_Format(PyExc_TypeError, "Unknown keysym: %s", name);
+                return NULL;
+            }
+        }
+    }
+
+    free(pending_keybindings.bindings);
+    pending_keybindings.pending = true;
+    pending_keybindings.n_bindings = n_bindings;
+    pending_keybindings.bindings = bindings;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject* _pywm_key_fd(PyObject* self, PyObject* args){
+    return Py_BuildValue("i", _pywm_callbacks_get_all()->keys.fd);
+}
+
+static PyObject* _pywm_pop_keys(PyObject* self, PyObject* args){
+    return _pywm_callbacks_pop_keys();
+}
 
 static PyMethodDef _pywm_methods[] = {
     { "run",                       (PyCFunction)_pywm_run,           METH_VARARGS | METH_KEYWORDS,   "Start the compositor in this thread" },
     { "register",                  _pywm_register,                   METH_VARARGS,                   "Register callback"  },
     { "damage",                    _pywm_damage,                     METH_VARARGS,                   "Track damage, or set mode to continuous damage"  },
     { "debug_performance",         _pywm_debugperformance,           METH_VARARGS,                   "Debug uitlity - uses DEBUG_PERFORMANCE macro"  },
+    { "texture_stats",             _pywm_texture_stats,              METH_VARARGS,                   "Client buffer import counts and timings (timings with debug only)"  },
+    { "transaction_stats",         _pywm_transaction_stats,          METH_VARARGS,                   "Counts and latencies of layout changes which waited for clients"  },
+    { "reconfigure_stats",         _pywm_reconfigure_stats,          METH_NOARGS,                    "Subsystems reloaded by the last reconfigure and their timings"  },
+    { "queue_gestures",            _pywm_queue_gestures,             METH_VARARGS,                   "Pass gestures of a kind through the queue, consumed or not, instead of the callback"  },
+    { "gesture_fd",                _pywm_gesture_fd,                 METH_NOARGS,                    "File descriptor readable while queued gestures are pending"  },
+    { "pop_gestures",              _pywm_pop_gestures,               METH_NOARGS,                    "Pop all queued gestures"  },
+    { "set_keybindings",           _pywm_set_keybindings,            METH_VARARGS,                   "Only pass keys matching (modifiers, keysym) to python - None to pass all"  },
+    { "key_fd",                    _pywm_key_fd,                     METH_NOARGS,                    "File descriptor readable while queued keys are pending"  },
+    { "pop_keys",                  _pywm_pop_keys,                   METH_NOARGS,                    "Pop all queued keys"  },
 
     { NULL, NULL, 0, NULL }
 };
@@ -274,5 +481,7 @@ static struct PyModuleDef _pywm = {
 };
 
 PyMODINIT_FUNC PyInit__pywm(void){
+    /* Before run - gestures might be queued from PyWM constructor */
+    _pywm_gestures_init();
     return PyModule_Create(&_pywm);
 }
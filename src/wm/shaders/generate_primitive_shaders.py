@@ -13,11 +13,74 @@ texture_files = [
 regexp_int = re.compile(r'.*int params_int\[(\d*)\]');
 regexp_float = re.compile(r'.*float params_float\[(\d*)\]');
 
+instanced_vertex = os.path.join(base, 'primitive_instanced', 'vertex.glsl')
+
+# Layout of the instance attributes, see primitive_instanced/vertex.glsl
+INSTANCED_MAX_PARAMS_INT = 4
+INSTANCED_MAX_PARAMS_FLOAT = 8
+
+def quote(src):
+    return "\"" + src.replace("\n", "\\n\"\n\"") + "\""
+
+def instanced_fragment(src, n_params_int, n_params_float):
+    """
+    Turn uniforms of a primitive fragment shader into globals which are filled
+    from per-instance varyings, and wrap main
+    """
+    if n_params_int > INSTANCED_MAX_PARAMS_INT or n_params_float > INSTANCED_MAX_PARAMS_FLOAT:
+        return None
+
+    declared = []
+    lines = []
+    for l in src.split("\n"):
+        m = re.match(r'\s*uniform\s+(float|int)\s+(params_float|params_int|alpha|width|height)\b', l)
+        if m is not None:
+            declared += [m.groups()[1]]
+            l = l.replace("uniform ", "", 1)
+        lines += [l]
+
+    res = "\n".join(lines)
+    res = re.sub(r'void\s+main\s*\(\s*\)', 'void primitive_main()', res)
+
+    res += """
+varying vec4 v_inst_misc;
+varying vec4 v_inst_params_float0;
+varying vec4 v_inst_params_float1;
+varying vec4 v_inst_params_int;
+varying vec2 v_pos;
+varying vec4 v_inst_clip;
+
+void main() {
+    /* Instances of one draw have different damage */
+    if(v_pos.x < v_inst_clip.x || v_pos.y < v_inst_clip.y || v_pos.x >= v_inst_clip.z || v_pos.y >= v_inst_clip.w) discard;
+"""
+    if 'alpha' in declared:
+        res += "    alpha = v_inst_misc.x;\n"
+    if 'width' in declared:
+        res += "    width = v_inst_misc.y;\n"
+    if 'height' in declared:
+        res += "    height = v_inst_misc.z;\n"
+    comps = "xyzw"
+    if 'params_float' in declared:
+        for i in range(n_params_float):
+            res += "    params_float[%d] = v_inst_params_float%d.%s;\n" % (i, i // 4, comps[i % 4])
+    if 'params_int' in declared:
+        for i in range(n_params_int):
+            res += "    params_int[%d] = int(floor(v_inst_params_int.%s + 0.5));\n" % (i, comps[i])
+    res += "    primitive_main();\n}\n"
+    return res
+
 with open(sys.argv[1], "w") as out:
     out.write("""
 #define _POSIX_C_SOURCE 200809L
 #include "wm/wm_renderer.h"
 
+""")
+
+    with open(instanced_vertex, 'r') as file:
+        out.write("static const char primitive_instanced_vertex_src[] = %s;\n" % quote(file.read()))
+
+    out.write("""
 void wm_primitive_shaders_init(struct wm_renderer* renderer){
 
     """)
@@ -32,6 +95,7 @@ void wm_primitive_shaders_init(struct wm_renderer* renderer){
         n_params_int = 0
         n_params_float = 0
         strs = []
+        raw = []
         successful = True
         for f in texture_files:
             if f not in files:
@@ -40,7 +104,8 @@ void wm_primitive_shaders_init(struct wm_renderer* renderer){
                 continue
 
             with open(os.path.join(subdir, f), 'r') as file:
-                strs += ["\"" + file.read().replace("\n", "\\n\"\n\"") + "\""]
+                raw += [file.read()]
+                strs += [quote(raw[-1])]
 
         if not successful:
             continue
@@ -55,6 +120,10 @@ void wm_primitive_shaders_init(struct wm_renderer* renderer){
 
         print("[DEBUG] Texture has %d, %d parameters" % (n_params_int, n_params_float))
 
+        frag_instanced = instanced_fragment(raw[1], n_params_int, n_params_float)
+        strs += ["primitive_instanced_vertex_src" if frag_instanced is not None else "NULL"]
+        strs += [quote(frag_instanced) if frag_instanced is not None else "NULL"]
+
         shaders += [f"""
     wm_renderer_add_primitive_shader(renderer, "{os.path.split(subdir)[1]}", {",".join(strs)}, {n_params_int}, {n_params_float});
         """]
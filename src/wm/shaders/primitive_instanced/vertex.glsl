@@ -0,0 +1,31 @@
+uniform mat3 proj;
+attribute vec2 pos;
+attribute vec2 texcoord;
+
+/* Per instance */
+attribute vec4 inst_box;
+attribute vec4 inst_misc;
+attribute vec4 inst_params_float0;
+attribute vec4 inst_params_float1;
+attribute vec4 inst_params_int;
+attribute vec4 inst_clip;
+
+varying vec2 v_texcoord;
+varying vec2 v_pos;
+varying vec4 v_inst_clip;
+varying vec4 v_inst_misc;
+varying vec4 v_inst_params_float0;
+varying vec4 v_inst_params_float1;
+varying vec4 v_inst_params_int;
+
+void main() {
+    v_pos = inst_box.xy + pos * inst_box.zw;
+    gl_Position = vec4(proj * vec3(v_pos, 1.0), 1.0);
+    v_texcoord = texcoord;
+    v_inst_clip = inst_clip;
+
+    v_inst_misc = vec4(inst_misc.x, inst_box.zw, 0.);
+    v_inst_params_float0 = inst_params_float0;
+    v_inst_params_float1 = inst_params_float1;
+    v_inst_params_int = inst_params_int;
+}
@@ -37,6 +37,8 @@ void wm_destroy() {
     wm_server_destroy(wm.server);
     free(wm.server);
     wm.server = 0;
+
+    wm_keybindings_destroy(&wm.keybindings);
 }
 
 void *run() {
@@ -365,6 +367,24 @@ void wm_callback_update_view(struct wm_view *view){
     TIMER_PRINT(callback_update_view);
 }
 
+void wm_callback_idle(double elapsed, bool inhibited) {
+    TIMER_START(callback_idle);
+    if (wm.callback_idle) {
+        (*wm.callback_idle)(elapsed, inhibited);
+    }
+    TIMER_STOP(callback_idle);
+    TIMER_PRINT(callback_idle);
+}
+
+void wm_callback_render_quality(struct wm_output* output, int level) {
+    TIMER_START(callback_render_quality);
+    if (wm.callback_render_quality) {
+        (*wm.callback_render_quality)(output, level);
+    }
+    TIMER_STOP(callback_render_quality);
+    TIMER_PRINT(callback_render_quality);
+}
+
 void wm_callback_update() {
     TIMER_START(callback_update);
     if (wm.callback_update) {
@@ -0,0 +1,283 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/util/log.h>
+
+#include "wm/wm_atlas.h"
+#include "wm/wm_renderer.h"
+
+/* All formats passed in are 32bpp (see _pywm_widget.c) */
+#define WM_ATLAS_BPP 4
+
+static struct wm_atlas_page* wm_atlas_page_create(struct wm_atlas* atlas, uint32_t format){
+    void* empty = calloc(WM_ATLAS_PAGE_SIZE * WM_ATLAS_PAGE_SIZE, WM_ATLAS_BPP);
+    struct wlr_texture* texture = wlr_texture_from_pixels(atlas->wm_renderer->wlr_renderer,
+            format, WM_ATLAS_BPP * WM_ATLAS_PAGE_SIZE, WM_ATLAS_PAGE_SIZE, WM_ATLAS_PAGE_SIZE, empty);
+    free(empty);
+
+    if(!texture){
+        wlr_log(WLR_ERROR, "Atlas: Could not create page");
+        return NULL;
+    }
+
+    struct wm_atlas_page* page = calloc(1, sizeof(struct wm_atlas_page));
+    page->format = format;
+    page->wlr_texture = texture;
+    wl_list_insert(atlas->pages.prev, &page->link);
+
+    wlr_log(WLR_DEBUG, "Atlas: New page (%d pages)", wl_list_length(&atlas->pages));
+    return page;
+}
+
+static void wm_atlas_page_destroy(struct wm_atlas_page* page){
+    wl_list_remove(&page->link);
+    wlr_texture_destroy(page->wlr_texture);
+    free(page);
+}
+
+static void wm_atlas_page_reset(struct wm_atlas_page* page){
+    page->shelf_x = 0;
+    page->shelf_y = 0;
+    page->shelf_height = 0;
+    page->n_regions = 0;
+    page->used_area = 0;
+}
+
+static bool wm_atlas_page_allocate(struct wm_atlas_page* page, int width, int height, struct wlr_box* box){
+    int w = width + WM_ATLAS_GUTTER;
+    int h = height + WM_ATLAS_GUTTER;
+
+    int x = page->shelf_x;
+    int y = page->shelf_y;
+    int shelf_height = page->shelf_height;
+
+    if(x + w > WM_ATLAS_PAGE_SIZE){
+        /* Open new shelf */
+        x = 0;
+        y += shelf_height;
+        shelf_height = 0;
+    }
+    if(y + h > WM_ATLAS_PAGE_SIZE) return false;
+
+    page->shelf_x = x + w;
+    page->shelf_y = y;
+    page->shelf_height = shelf_height > h ? shelf_height : h;
+
+    page->n_regions++;
+    page->used_area += width * height;
+
+    box->x = x;
+    box->y = y;
+    box->width = width;
+    box->height = height;
+    return true;
+}
+
+static bool wm_atlas_place(struct wm_atlas* atlas, struct wm_atlas_region* region, bool allow_new_page){
+    struct wm_atlas_page* page;
+    wl_list_for_each(page, &atlas->pages, link){
+        if(page->format != region->format) continue;
+        if(wm_atlas_page_allocate(page, region->box.width, region->box.height, &region->box)){
+            region->page = page;
+            return true;
+        }
+    }
+
+    if(!allow_new_page) return false;
+
+    page = wm_atlas_page_create(atlas, region->format);
+    if(!page) return false;
+
+    /* Should not fail as region is bounded by WM_ATLAS_MAX_WIDTH / WM_ATLAS_MAX_HEIGHT */
+    if(!wm_atlas_page_allocate(page, region->box.width, region->box.height, &region->box)){
+        return false;
+    }
+    region->page = page;
+    return true;
+}
+
+static bool wm_atlas_upload(struct wm_atlas_region* region){
+    return wlr_texture_write_pixels(region->page->wlr_texture,
+            WM_ATLAS_BPP * region->box.width, region->box.width, region->box.height,
+            0, 0, region->box.x, region->box.y, region->data);
+}
+
+static void wm_atlas_copy(struct wm_atlas_region* region, uint32_t stride, const void* data){
+    int row = WM_ATLAS_BPP * region->box.width;
+    for(int y=0; y<region->box.height; y++){
+        memcpy((char*)region->data + y*row, (const char*)data + y*stride, row);
+    }
+}
+
+/*
+ * Class implementation
+ */
+void wm_atlas_init(struct wm_atlas* atlas, struct wm_renderer* renderer){
+    atlas->wm_renderer = renderer;
+    wl_list_init(&atlas->pages);
+    wl_list_init(&atlas->regions);
+}
+
+void wm_atlas_destroy(struct wm_atlas* atlas){
+    struct wm_atlas_region* region, *tmp_region;
+    wl_list_for_each_safe(region, tmp_region, &atlas->regions, link){
+        wl_list_remove(&region->link);
+        free(region->data);
+        free(region);
+    }
+
+    struct wm_atlas_page* page, *tmp_page;
+    wl_list_for_each_safe(page, tmp_page, &atlas->pages, link){
+        wm_atlas_page_destroy(page);
+    }
+}
+
+struct wm_atlas_region* wm_atlas_add(struct wm_atlas* atlas, uint32_t format, uint32_t stride, uint32_t width, uint32_t height, const void* data){
+    if(width == 0 || height == 0) return NULL;
+    if(width > WM_ATLAS_MAX_WIDTH || height > WM_ATLAS_MAX_HEIGHT) return NULL;
+
+    struct wm_atlas_region* region = calloc(1, sizeof(struct wm_atlas_region));
+    region->format = format;
+    region->box.width = width;
+    region->box.height = height;
+
+    if(!wm_atlas_place(atlas, region, false)){
+        /* Only compact if it is worth it, i.e. at least half of the pages is dead space */
+        int n_pages = 0;
+        int used_area = 0;
+        struct wm_atlas_page* page;
+        wl_list_for_each(page, &atlas->pages, link){
+            if(page->format != format) continue;
+            n_pages++;
+            used_area += page->used_area;
+        }
+
+        if(n_pages > 0 && 2 * used_area < n_pages * WM_ATLAS_PAGE_SIZE * WM_ATLAS_PAGE_SIZE){
+            wm_atlas_compact(atlas, format);
+        }
+
+        region->box.width = width;
+        region->box.height = height;
+        if(!wm_atlas_place(atlas, region, true)){
+            free(region);
+            return NULL;
+        }
+    }
+
+    region->data = malloc(WM_ATLAS_BPP * width * height);
+    wm_atlas_copy(region, stride, data);
+    wl_list_insert(&atlas->regions, &region->link);
+
+    if(!wm_atlas_upload(region)){
+        wlr_log(WLR_ERROR, "Atlas: Could not upload region");
+        wm_atlas_remove(atlas, region);
+        return NULL;
+    }
+
+    return region;
+}
+
+bool wm_atlas_update(struct wm_atlas* atlas, struct wm_atlas_region* region, uint32_t format, uint32_t stride, uint32_t width, uint32_t height, const void* data){
+    if(region->format != format) return false;
+    if(region->box.width != (int)width || region->box.height != (int)height) return false;
+
+    wm_atlas_copy(region, stride, data);
+    return wm_atlas_upload(region);
+}
+
+void wm_atlas_remove(struct wm_atlas* atlas, struct wm_atlas_region* region){
+    struct wm_atlas_page* page = region->page;
+    page->n_regions--;
+    page->used_area -= region->box.width * region->box.height;
+
+    /* Empty pages can be reused from scratch */
+    if(page->n_regions == 0){
+        wm_atlas_page_reset(page);
+    }
+
+    wl_list_remove(&region->link);
+    free(region->data);
+    free(region);
+}
+
+static int compare_region_height(const void* a, const void* b){
+    const struct wm_atlas_region* ra = *(const struct wm_atlas_region**)a;
+    const struct wm_atlas_region* rb = *(const struct wm_atlas_region**)b;
+    return rb->box.height - ra->box.height;
+}
+
+/* Regions are repacked into new pages - the old ones stay untouched until all regions have moved */
+void wm_atlas_compact(struct wm_atlas* atlas, uint32_t format){
+    int n_regions = 0;
+    struct wm_atlas_region* region;
+    wl_list_for_each(region, &atlas->regions, link){
+        if(region->format == format) n_regions++;
+    }
+
+    struct wm_atlas_region** regions = calloc(n_regions ? n_regions : 1, sizeof(struct wm_atlas_region*));
+    int i = 0;
+    wl_list_for_each(region, &atlas->regions, link){
+        if(region->format == format) regions[i++] = region;
+    }
+
+    /* Sorting by height gives decent shelf packing */
+    qsort(regions, n_regions, sizeof(struct wm_atlas_region*), compare_region_height);
+
+    struct wm_atlas_page** old_pages = calloc(n_regions ? n_regions : 1, sizeof(struct wm_atlas_page*));
+    struct wlr_box* old_boxes = calloc(n_regions ? n_regions : 1, sizeof(struct wlr_box));
+    for(i=0; i<n_regions; i++){
+        old_pages[i] = regions[i]->page;
+        old_boxes[i] = regions[i]->box;
+    }
+
+    struct wl_list old;
+    wl_list_init(&old);
+    struct wm_atlas_page* page, *tmp;
+    wl_list_for_each_safe(page, tmp, &atlas->pages, link){
+        if(page->format != format) continue;
+        wl_list_remove(&page->link);
+        wl_list_insert(old.prev, &page->link);
+    }
+
+    bool success = true;
+    for(i=0; i<n_regions && success; i++){
+        success = wm_atlas_place(atlas, regions[i], true) && wm_atlas_upload(regions[i]);
+    }
+
+    if(!success){
+        wlr_log(WLR_ERROR, "Atlas: Compaction failed - keeping the previous pages");
+
+        /* Pages of this format in atlas->pages are all new */
+        wl_list_for_each_safe(page, tmp, &atlas->pages, link){
+            if(page->format == format) wm_atlas_page_destroy(page);
+        }
+        for(i=0; i<n_regions; i++){
+            regions[i]->page = old_pages[i];
+            regions[i]->box = old_boxes[i];
+        }
+        wl_list_for_each_safe(page, tmp, &old, link){
+            wl_list_remove(&page->link);
+            wl_list_insert(atlas->pages.prev, &page->link);
+        }
+    }else{
+        wl_list_for_each_safe(page, tmp, &old, link){
+            wm_atlas_page_destroy(page);
+        }
+    }
+
+    free(old_boxes);
+    free(old_pages);
+    free(regions);
+
+    wlr_log(WLR_DEBUG, "Atlas: Compacted %d regions (%d pages)", n_regions, wl_list_length(&atlas->pages));
+}
+
+void wm_atlas_region_get_source_box(struct wm_atlas_region* region, struct wlr_fbox* box){
+    box->x = region->box.x;
+    box->y = region->box.y;
+    box->width = region->box.width;
+    box->height = region->box.height;
+}
@@ -22,6 +22,8 @@ void wm_composite_init(struct wm_composite* comp, struct wm_server* server){
     comp->params.n_params_int = 0;
     comp->params.params_float = NULL;
     comp->params.params_int = NULL;
+
+    wm_compose_chains_invalidate(server);
 }
 
 static void wm_composite_destroy(struct wm_content* super){
@@ -83,25 +85,19 @@ static void wm_composite_get_effective_box(struct wm_composite* composite, struc
     double display_x, display_y, display_w, display_h;
     wm_content_get_box(&composite->super, &display_x, &display_y, &display_w, &display_h);
 
-    box->x = round((display_x - output->layout_x) * output->wlr_output->scale);
-    box->y = round((display_y - output->layout_y) * output->wlr_output->scale);
-    box->width = round(display_w * output->wlr_output->scale);
-    box->height = round(display_h * output->wlr_output->scale);
+    wm_output_snap_box(output, display_x - output->layout_x, display_y - output->layout_y, display_w, display_h, box);
 
     if(wm_content_has_workspace(&composite->super)){
         double ws_x, ws_y, ws_w, ws_h;
         wm_content_get_workspace(&composite->super, &ws_x, &ws_y, &ws_w, &ws_h);
 
-        struct wlr_box workspace_box = {
-            .x = round((ws_x - output->layout_x) * output->wlr_output->scale),
-            .y = round((ws_y - output->layout_y) * output->wlr_output->scale),
-            .width = round(ws_w * output->wlr_output->scale),
-            .height = round(ws_h * output->wlr_output->scale)};
+        struct wlr_box workspace_box;
+        wm_output_snap_box(output, ws_x - output->layout_x, ws_y - output->layout_y, ws_w, ws_h, &workspace_box);
         wlr_box_intersection(box, box, &workspace_box);
     }
 }
 
-void wm_composite_on_damage_below(struct wm_composite* comp, struct wm_output* output, struct wm_content* from, pixman_region32_t* damage){
+void wm_composite_on_damage_below(struct wm_composite* comp, struct wm_output* output, pixman_region32_t* damage, pixman_region32_t* result){
     struct wlr_box box;
     wm_composite_get_effective_box(comp, output, &box);
 
@@ -119,24 +115,21 @@ void wm_composite_on_damage_below(struct wm_composite* comp, struct wm_output* o
         if (wlr_box_empty(&inters))
             continue;
 
-        pixman_region32_t region;
-        pixman_region32_init(&region);
-        pixman_region32_union_rect(&region, &region, inters.x, inters.y, inters.width, inters.height);
-        wm_layout_damage_output(output->wm_layout, output, &region, &comp->super);
-        pixman_region32_fini(&region);
+        pixman_region32_union_rect(result, result, inters.x, inters.y, inters.width, inters.height);
     }
 }
 
-void wm_composite_apply(struct wm_composite* composite, struct wm_output* output, pixman_region32_t* damage, struct timespec now){
-    struct wlr_box box;
-    wm_composite_get_effective_box(composite, output, &box);
-
+/* box as computed by wm_composite_get_effective_box */
+void wm_composite_apply(struct wm_composite* composite, struct wm_output* output, struct wlr_box* box, pixman_region32_t* damage, struct timespec now){
     if(composite->type == WM_COMPOSITE_BLUR){
         int radius = composite->params.n_params_int >= 1 ? composite->params.params_int[0] : 1;
         int passes = composite->params.n_params_int >= 2 ? composite->params.params_int[1] : 2;
-        wm_renderer_apply_blur(composite->super.wm_server->wm_renderer, damage, blur_extend(passes, radius), &box,
+        passes = wm_output_blur_passes(output, passes);
+
+        double corner_radius = wm_output_renders_corners(output) ? composite->super.corner_radius : 0.;
+        wm_renderer_apply_blur(composite->super.wm_server->wm_renderer, damage, blur_extend(passes, radius), box,
                 radius, passes,
-                output->wlr_output->scale * composite->super.corner_radius);
+                output->wlr_output->scale * corner_radius);
     }
 }
 
@@ -153,84 +146,133 @@ struct wm_content_vtable wm_composite_vtable = {
     .destroy = &wm_composite_destroy,
     .render = &wm_composite_render,
     .damage_output = NULL,
+    .extents = NULL,
     .printf = &wm_composite_printf
 };
 
 
-struct wm_compose_chain* wm_compose_chain_from_damage(struct wm_server* server, struct wm_output* output, pixman_region32_t* damage){
-
-    struct wm_compose_chain* result = calloc(1, sizeof(struct wm_compose_chain));
-    pixman_region32_init(&result->damage);
-    pixman_region32_union(&result->damage, &result->damage, damage);
-
-    pixman_region32_init(&result->composite_output);
-
-    struct wm_compose_chain* at = result;
-
+static void compose_chains_rebuild(struct wm_compose_chains* chains, struct wm_server* server, struct wm_output* output){
+    int n_nodes = 1;
     struct wm_content* content;
-    bool initial = true;
-
     wl_list_for_each(content, &server->wm_contents, link){
-        if(initial) result->z_index = wm_content_get_z_index(content) + 1.;
-
-        if(wm_content_is_composite(content)){
-            at->lower = calloc(1, sizeof(struct wm_compose_chain));
-            at->lower->higher = at;
-            at = at->lower;
-
-            at->composite = wm_cast(wm_composite, content);
-            at->z_index = wm_content_get_z_index(content);
-            pixman_region32_init(&at->damage);
-            pixman_region32_init(&at->composite_output);
+        if(wm_content_is_composite(content)) n_nodes++;
+    }
 
+    if(n_nodes > chains->capacity){
+        chains->nodes = realloc(chains->nodes, n_nodes * sizeof(struct wm_compose_chain));
+        for(int i=chains->capacity; i<n_nodes; i++){
+            pixman_region32_init(&chains->nodes[i].damage);
+            pixman_region32_init(&chains->nodes[i].composite_output);
+        }
+        chains->capacity = n_nodes;
+    }
 
-            int extend = wm_composite_extend(at->composite);
-            struct wlr_box box;
-            wm_composite_get_effective_box(at->composite, output, &box);
+    chains->nodes[0].composite = NULL;
 
-            int nrects;
-            pixman_box32_t* rects = pixman_region32_rectangles(&at->higher->damage, &nrects);
-            for(int i=0; i<nrects; i++){
-                struct wlr_box damage_box = {
-                    .x = rects[i].x1,
-                    .y = rects[i].y1,
-                    .width = rects[i].x2 - rects[i].x1,
-                    .height = rects[i].y2 - rects[i].y1
-                };
+    int i = 1;
+    wl_list_for_each(content, &server->wm_contents, link){
+        if(!wm_content_is_composite(content)) continue;
 
-                struct wlr_box composite_output;
-                wlr_box_intersection(&composite_output, &box, &damage_box);
-                pixman_region32_union_rect(&at->composite_output, &at->composite_output, 
-                        composite_output.x, composite_output.y, composite_output.width, composite_output.height);
+        struct wm_compose_chain* node = &chains->nodes[i++];
+        node->composite = wm_cast(wm_composite, content);
+        node->z_index = wm_content_get_z_index(content);
+        node->extend = wm_composite_extend(node->composite);
+        wm_composite_get_effective_box(node->composite, output, &node->box);
+    }
 
+    chains->n_nodes = n_nodes;
+    chains->valid = true;
+}
 
-                pixman_region32_union_rect(&at->damage, &at->damage,
-                        damage_box.x, damage_box.y, damage_box.width, damage_box.height);
+struct wm_compose_chain* wm_compose_chain_from_damage(struct wm_server* server, struct wm_output* output, pixman_region32_t* damage){
+    struct wm_compose_chains* chains = output->compose_chains;
+    if(!chains->valid){
+        compose_chains_rebuild(chains, server, output);
+    }
 
-                wm_composite_extend_box(&damage_box, &box, extend);
-                pixman_region32_union_rect(&at->damage, &at->damage,
-                        damage_box.x, damage_box.y, damage_box.width, damage_box.height);
+    struct wm_compose_chain* result = &chains->nodes[0];
+    result->lower = NULL;
+    result->higher = NULL;
+    result->z_index = 1.;
+    if(!wl_list_empty(&server->wm_contents)){
+        struct wm_content* top = wl_container_of(server->wm_contents.next, top, link);
+        result->z_index = wm_content_get_z_index(top) + 1.;
+    }
+    pixman_region32_copy(&result->damage, damage);
+    pixman_region32_clear(&result->composite_output);
 
-            }
+    struct wm_compose_chain* at = result;
+    for(int n=1; n<chains->n_nodes; n++){
+        struct wm_compose_chain* node = &chains->nodes[n];
+        pixman_region32_clear(&node->damage);
+        pixman_region32_clear(&node->composite_output);
+
+        int nrects;
+        pixman_box32_t* rects = pixman_region32_rectangles(&at->damage, &nrects);
+        for(int i=0; i<nrects; i++){
+            struct wlr_box damage_box = {
+                .x = rects[i].x1,
+                .y = rects[i].y1,
+                .width = rects[i].x2 - rects[i].x1,
+                .height = rects[i].y2 - rects[i].y1
+            };
+
+            struct wlr_box composite_output;
+            wlr_box_intersection(&composite_output, &node->box, &damage_box);
+            pixman_region32_union_rect(&node->composite_output, &node->composite_output,
+                    composite_output.x, composite_output.y, composite_output.width, composite_output.height);
+
+
+            pixman_region32_union_rect(&node->damage, &node->damage,
+                    damage_box.x, damage_box.y, damage_box.width, damage_box.height);
+
+            wm_composite_extend_box(&damage_box, &node->box, node->extend);
+            pixman_region32_union_rect(&node->damage, &node->damage,
+                    damage_box.x, damage_box.y, damage_box.width, damage_box.height);
 
-            if(!pixman_region32_not_empty(&at->composite_output)){
-                at = at->higher;
-                wm_compose_chain_free(at->lower);
-                at->lower = NULL;
-            }
         }
 
-        initial = false;
+        /* Composites without output this frame are left out */
+        if(pixman_region32_not_empty(&node->composite_output)){
+            node->higher = at;
+            node->lower = NULL;
+            at->lower = node;
+            at = node;
+        }
     }
 
     return result;
 }
 
-void wm_compose_chain_free(struct wm_compose_chain* chain){
-    if(chain->lower){
-        wm_compose_chain_free(chain->lower);
+void wm_compose_chain_offscreen(struct wm_compose_chain* chain, pixman_region32_t* offscreen){
+    pixman_region32_clear(offscreen);
+
+    for(struct wm_compose_chain* at=chain->lower; at; at=at->lower){
+        pixman_region32_t region;
+        pixman_region32_init(&region);
+        pixman_region32_intersect_rect(&region, &at->damage,
+                at->box.x - at->extend, at->box.y - at->extend,
+                at->box.width + 2*at->extend, at->box.height + 2*at->extend);
+        pixman_region32_union(offscreen, offscreen, &region);
+        pixman_region32_fini(&region);
+    }
+}
+
+void wm_compose_chains_destroy(struct wm_compose_chains* chains){
+    for(int i=0; i<chains->capacity; i++){
+        pixman_region32_fini(&chains->nodes[i].damage);
+        pixman_region32_fini(&chains->nodes[i].composite_output);
+    }
+    free(chains->nodes);
+    chains->nodes = NULL;
+    chains->capacity = 0;
+    chains->n_nodes = 0;
+    chains->valid = false;
+}
+
+void wm_compose_chains_invalidate(struct wm_server* server){
+    struct wm_output* output;
+    wl_list_for_each(output, &server->wm_layout->wm_outputs, link){
+        output->compose_chains->valid = false;
     }
-    pixman_region32_fini(&chain->damage);
-    pixman_region32_fini(&chain->composite_output);
-    free(chain);
 }
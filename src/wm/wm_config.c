@@ -2,13 +2,16 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <wlr/util/log.h>
 
 #include "wm/wm_config.h"
 #include "wm/wm_server.h"
 #include "wm/wm_layout.h"
 #include "wm/wm_seat.h"
+#include "wm/wm_cursor.h"
 #include "wm/wm_renderer.h"
+#include "wm/wm_idle_inhibit.h"
 
 static void xcursor_setenv(struct wm_config* config){
     char cursor_size_fmt[16];
@@ -29,6 +32,12 @@ void wm_config_init_default(struct wm_config *config) {
     strcpy(config->xkb_variant, "");
     strcpy(config->xkb_options, "");
     strcpy(config->texture_shaders, "basic");
+    config->render_governor = true;
+    config->render_cache = false;
+    config->transaction_timeout_ms = 100;
+    strcpy(config->resize_placeholder, "snapshot");
+    config->downscale_threshold = 0.5;
+    config->native_buffer_scale = true;
 
     wl_list_init(&config->outputs);
 
@@ -49,12 +58,21 @@ void wm_config_init_default(struct wm_config *config) {
 
     config->natural_scroll = true;
     config->tap_to_click = true;
+    config->coalesce_motion = false;
+
+    config->n_idle_timeouts = 0;
+    for(int t=5; t<=60; t+=5) config->idle_timeouts[config->n_idle_timeouts++] = t;
+    for(int t=90; t<=600; t+=30) config->idle_timeouts[config->n_idle_timeouts++] = t;
+    config->idle_timeouts[config->n_idle_timeouts++] = 1800;
+    config->idle_timeouts[config->n_idle_timeouts++] = 3600;
 
     config->focus_follows_mouse = true;
     config->constrain_popups_to_toplevel = false;
 
     config->encourage_csd = true;
     config->debug = false;
+
+    memset(&config->last_reload, 0, sizeof(struct wm_config_reload));
 }
 
 void wm_config_reset_default(struct wm_config* config){
@@ -66,14 +84,121 @@ void wm_config_reset_default(struct wm_config* config){
     wm_config_init_default(config);
 }
 
-void wm_config_reconfigure(struct wm_config* config, struct wm_server* server){
-    wm_seat_reconfigure(server->wm_seat);
-    wm_layout_reconfigure(server->wm_layout);
-    wm_server_reconfigure(server);
+static const char* subsystem_names[WM_CONFIG_N_SUBSYSTEMS] = {
+    [WM_CONFIG_KEYBOARDS] = "keyboards",
+    [WM_CONFIG_POINTERS] = "pointers",
+    [WM_CONFIG_CURSOR] = "cursor",
+    [WM_CONFIG_OUTPUTS] = "outputs",
+    [WM_CONFIG_DECORATIONS] = "decorations",
+    [WM_CONFIG_IDLE] = "idle",
+    [WM_CONFIG_TEXTURE_SHADERS] = "texture_shaders",
+    [WM_CONFIG_RENDERER_MODE] = "renderer_mode",
+};
 
-    xcursor_setenv(config);
-    wm_renderer_select_texture_shaders(server->wm_renderer, config->texture_shaders);
-    wm_renderer_ensure_mode(server->wm_renderer, wm_config_get_renderer_mode(config));
+static bool str_changed(const char* a, const char* b){
+    return strcmp(a ? a : "", b ? b : "");
+}
+
+static bool changed(struct wm_config* config, struct wm_config_previous* previous, enum wm_config_subsystem subsystem){
+    if(!previous) return true;
+    struct wm_config* p = &previous->config;
+
+    switch(subsystem){
+        case WM_CONFIG_KEYBOARDS:
+            return str_changed(config->xkb_model, p->xkb_model) ||
+                str_changed(config->xkb_layout, p->xkb_layout) ||
+                str_changed(config->xkb_variant, p->xkb_variant) ||
+                str_changed(config->xkb_options, p->xkb_options);
+        case WM_CONFIG_POINTERS:
+            return config->tap_to_click != p->tap_to_click ||
+                config->natural_scroll != p->natural_scroll;
+        case WM_CONFIG_CURSOR:
+            return str_changed(config->xcursor_theme, previous->xcursor_theme) ||
+                config->xcursor_size != p->xcursor_size;
+        case WM_CONFIG_OUTPUTS:
+            /* Diffed per output */
+            return true;
+        case WM_CONFIG_DECORATIONS:
+            return config->encourage_csd != p->encourage_csd;
+        case WM_CONFIG_IDLE:
+            return config->n_idle_timeouts != p->n_idle_timeouts ||
+                memcmp(config->idle_timeouts, p->idle_timeouts, config->n_idle_timeouts * sizeof(double));
+        case WM_CONFIG_TEXTURE_SHADERS:
+            return str_changed(config->texture_shaders, p->texture_shaders);
+        case WM_CONFIG_RENDERER_MODE:
+            return wm_config_get_renderer_mode(config) != wm_config_get_renderer_mode(p);
+        default:
+            return true;
+    }
+}
+
+/* Returns false if nothing needed to be done */
+static bool reload(struct wm_config* config, struct wm_server* server, enum wm_config_subsystem subsystem){
+    switch(subsystem){
+        case WM_CONFIG_KEYBOARDS:
+            wm_seat_reconfigure_keyboards(server->wm_seat);
+            return true;
+        case WM_CONFIG_POINTERS:
+            wm_seat_reconfigure_pointers(server->wm_seat);
+            return true;
+        case WM_CONFIG_CURSOR:
+            xcursor_setenv(config);
+            wm_cursor_reconfigure(server->wm_seat->wm_cursor);
+            wm_server_reconfigure_xcursor(server);
+            return true;
+        case WM_CONFIG_OUTPUTS:
+            return wm_layout_reconfigure(server->wm_layout);
+        case WM_CONFIG_DECORATIONS:
+            wm_server_reconfigure_decorations(server);
+            return true;
+        case WM_CONFIG_IDLE:
+            wm_idle_inhibit_reconfigure(server->wm_idle_inhibit);
+            return true;
+        case WM_CONFIG_TEXTURE_SHADERS:
+            wm_renderer_select_texture_shaders(server->wm_renderer, config->texture_shaders);
+            return true;
+        case WM_CONFIG_RENDERER_MODE:
+            wm_renderer_ensure_mode(server->wm_renderer, wm_config_get_renderer_mode(config));
+            return true;
+        default:
+            return false;
+    }
+}
+
+void wm_config_save_previous(struct wm_config* config, struct wm_config_previous* previous){
+    previous->config = *config;
+    wl_list_init(&previous->config.outputs);
+
+    strncpy(previous->xcursor_theme, config->xcursor_theme ? config->xcursor_theme : "", WM_CONFIG_STRLEN-1);
+    previous->xcursor_theme[WM_CONFIG_STRLEN-1] = '\0';
+    previous->config.xcursor_theme = previous->xcursor_theme;
+}
+
+void wm_config_reconfigure(struct wm_config* config, struct wm_config_previous* previous, struct wm_server* server){
+    struct wm_config_reload* result = &config->last_reload;
+    double total_msec = 0.;
+
+    for(int i=0; i<WM_CONFIG_N_SUBSYSTEMS; i++){
+        result->reloaded[i] = false;
+        result->msec[i] = 0.;
+        if(!changed(config, previous, i)) continue;
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        result->reloaded[i] = reload(config, server, i);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        if(!result->reloaded[i]) continue;
+        result->msec[i] = (end.tv_sec - start.tv_sec) * 1000. + (end.tv_nsec - start.tv_nsec) / 1000000.;
+        total_msec += result->msec[i];
+        wlr_log(WLR_INFO, "Config: Reloaded %s (%.2fms)", subsystem_names[i], result->msec[i]);
+    }
+
+    wlr_log(WLR_INFO, "Config: Reconfigure took %.2fms", total_msec);
+}
+
+const char* wm_config_subsystem_name(enum wm_config_subsystem subsystem){
+    return subsystem_names[subsystem];
 }
 
 enum wm_renderer_mode wm_config_get_renderer_mode(struct wm_config* config){
@@ -86,6 +211,16 @@ enum wm_renderer_mode wm_config_get_renderer_mode(struct wm_config* config){
     return WM_RENDERER_PYWM;
 }
 
+enum wm_config_resize_placeholder wm_config_get_resize_placeholder(struct wm_config* config){
+    if(!strcmp(config->resize_placeholder, "none")){
+        return WM_CONFIG_RESIZE_NONE;
+    }else if(!strcmp(config->resize_placeholder, "solid")){
+        return WM_CONFIG_RESIZE_SOLID;
+    }
+
+    return WM_CONFIG_RESIZE_SNAPSHOT;
+}
+
 void wm_config_set_xcursor_theme(struct wm_config* config, const char* xcursor_theme){
     config->xcursor_theme = xcursor_theme;
     xcursor_setenv(config);
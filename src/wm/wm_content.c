@@ -9,6 +9,10 @@
 #include "wm/wm_output.h"
 #include "wm/wm_server.h"
 #include "wm/wm_layout.h"
+#include "wm/wm_renderer.h"
+#include "wm/wm_config.h"
+#include "wm/wm_transaction.h"
+#include "wm/wm_view.h"
 
 struct wm_content_vtable wm_content_base_vtable;
 
@@ -33,10 +37,28 @@ void wm_content_init(struct wm_content* content, struct wm_server* server) {
     wl_list_insert(&content->wm_server->wm_contents, &content->link);
 
     content->lock_enabled = false;
+
+    content->cacheable = false;
+    content->render_cache = NULL;
+}
+
+/* Occlusion depends on box, mask, workspace, output, z-index, opacity and corner radius of views */
+static void invalidate_visibility(struct wm_content* content){
+    if(wm_content_is_view(content)) wm_server_invalidate_visibility(content->wm_server);
+}
+
+void wm_content_free_render_cache(struct wm_content* content){
+    if(!content->render_cache) return;
+
+    wm_renderer_cache_destroy(content->wm_server->wm_renderer, content->render_cache);
+    free(content->render_cache);
+    content->render_cache = NULL;
 }
 
 void wm_content_base_destroy(struct wm_content* content) {
     wl_list_remove(&content->link);
+    wm_content_free_render_cache(content);
+    wm_transaction_remove_content(content->wm_server->wm_transaction, content);
 }
 
 void wm_content_set_output(struct wm_content* content, int key, struct wlr_output* outp){
@@ -62,6 +84,7 @@ void wm_content_set_output(struct wm_content* content, int key, struct wlr_outpu
     wm_layout_damage_from(content->wm_server->wm_layout, content, NULL);
     content->fixed_output = res;
     wm_layout_damage_from(content->wm_server->wm_layout, content, NULL);
+    invalidate_visibility(content);
 
     wm_layout_update_content_outputs(content->wm_server->wm_layout, content);
 }
@@ -91,6 +114,7 @@ void wm_content_set_workspace(struct wm_content* content, double x, double y, do
     content->workspace_width = width;
     content->workspace_height = height;
     wm_layout_damage_from(content->wm_server->wm_layout, content, NULL);
+    invalidate_visibility(content);
 
     wm_layout_update_content_outputs(content->wm_server->wm_layout, content);
 }
@@ -106,19 +130,60 @@ bool wm_content_has_workspace(struct wm_content* content){
     return !(content->workspace_width < 0 || content->workspace_height < 0);
 }
 
-bool wm_content_is_on_output(struct wm_content* content, struct wm_output* output){
-    double display_x, display_y, display_width, display_height;
-    wm_content_get_box(content, &display_x, &display_y, &display_width, &display_height);
+static bool box_is_on_output(struct wm_content* content, struct wm_output* output, double x, double y, double width, double height){
     struct wlr_box box = {
-        .x = display_x,
-        .y = display_y,
-        .width = display_width,
-        .height = display_height
+        .x = x,
+        .y = y,
+        .width = width,
+        .height = height
     };
 
     return content->fixed_output == output || (wlr_output_layout_intersects(output->wm_layout->wlr_output_layout, output->wlr_output, &box) && content->fixed_output == NULL);
 }
 
+/* Box in layout coordinates */
+static void region_add_box(pixman_region32_t* region, struct wm_output* output, double x, double y, double w, double h){
+    x -= output->layout_x;
+    y -= output->layout_y;
+
+    /* Snapped as rendered - may exceed the enclosing pixels at ties */
+    struct wlr_box snapped;
+    wm_output_snap_box(output, x, y, w, h, &snapped);
+    pixman_region32_union_rect(region, region, snapped.x, snapped.y, snapped.width, snapped.height);
+
+    x *= output->wlr_output->scale;
+    y *= output->wlr_output->scale;
+    w *= output->wlr_output->scale;
+    h *= output->wlr_output->scale;
+    pixman_region32_union_rect(region, region,
+            floor(x), floor(y),
+            ceil(x + w) - floor(x), ceil(y + h) - floor(y));
+}
+
+static void region_clip_workspace(pixman_region32_t* region, struct wm_content* content, struct wm_output* output){
+    if(!wm_content_has_workspace(content)) return;
+
+    double workspace_x, workspace_y, workspace_w, workspace_h;
+    wm_content_get_workspace(content, &workspace_x, &workspace_y,
+                             &workspace_w, &workspace_h);
+    workspace_x = (workspace_x - output->layout_x) * output->wlr_output->scale;
+    workspace_y = (workspace_y - output->layout_y) * output->wlr_output->scale;
+    workspace_w *= output->wlr_output->scale;
+    workspace_h *= output->wlr_output->scale;
+    pixman_region32_intersect_rect(
+        region, region,
+        floor(workspace_x),
+        floor(workspace_y),
+        ceil(workspace_x + workspace_w) - floor(workspace_x),
+        ceil(workspace_y + workspace_h) - floor(workspace_y));
+}
+
+bool wm_content_is_on_output(struct wm_content* content, struct wm_output* output){
+    double display_x, display_y, display_width, display_height;
+    wm_content_get_box(content, &display_x, &display_y, &display_width, &display_height);
+    return box_is_on_output(content, output, display_x, display_y, display_width, display_height);
+}
+
 void wm_content_set_box(struct wm_content* content, double x, double y, double width, double height) {
     if(fabs(content->display_x - x) +
             fabs(content->display_y - y) + 
@@ -131,6 +196,46 @@ void wm_content_set_box(struct wm_content* content, double x, double y, double w
     content->display_width = width;
     content->display_height = height;
     wm_layout_damage_from(content->wm_server->wm_layout, content, NULL);
+    invalidate_visibility(content);
+
+    wm_layout_update_content_outputs(content->wm_server->wm_layout, content);
+}
+
+void wm_content_move_box(struct wm_content* content, double x, double y, double width, double height){
+    if(fabs(content->display_x - x) +
+            fabs(content->display_y - y) +
+            fabs(content->display_width - width) +
+            fabs(content->display_height - height) < 0.01) return;
+
+    double old_x = content->display_x;
+    double old_y = content->display_y;
+    double old_width = content->display_width;
+    double old_height = content->display_height;
+
+    content->display_x = x;
+    content->display_y = y;
+    content->display_width = width;
+    content->display_height = height;
+    invalidate_visibility(content);
+
+    pixman_region32_t region;
+    pixman_region32_init(&region);
+
+    struct wm_output* output;
+    wl_list_for_each(output, &content->wm_server->wm_layout->wm_outputs, link){
+        pixman_region32_clear(&region);
+        if(box_is_on_output(content, output, old_x, old_y, old_width, old_height)){
+            region_add_box(&region, output, old_x, old_y, old_width, old_height);
+        }
+        if(box_is_on_output(content, output, x, y, width, height)){
+            region_add_box(&region, output, x, y, width, height);
+        }
+        region_clip_workspace(&region, content, output);
+
+        wm_layout_damage_output(output->wm_layout, output, &region, content);
+    }
+
+    pixman_region32_fini(&region);
 
     wm_layout_update_content_outputs(content->wm_server->wm_layout, content);
 }
@@ -146,6 +251,7 @@ void wm_content_set_z_index(struct wm_content* content, double z_index){
     if(fabs(z_index - content->z_index) < 0.0001) return;
 
     content->z_index = z_index;
+    invalidate_visibility(content);
     wm_layout_damage_from(content->wm_server->wm_layout, content, NULL);
 }
 
@@ -157,6 +263,7 @@ void wm_content_set_opacity(struct wm_content* content, double opacity){
     if(fabs(content->opacity - opacity) < 0.0001) return;
 
     content->opacity = opacity;
+    invalidate_visibility(content);
     wm_layout_damage_from(content->wm_server->wm_layout, content, NULL);
 }
 
@@ -174,6 +281,7 @@ void wm_content_set_mask(struct wm_content* content, double mask_x, double mask_
     content->mask_y = mask_y;
     content->mask_w = mask_w;
     content->mask_h = mask_h;
+    invalidate_visibility(content);
 
     wm_layout_damage_from(content->wm_server->wm_layout, content, NULL);
 }
@@ -191,6 +299,7 @@ void wm_content_set_corner_radius(struct wm_content* content, double corner_radi
     if(fabs(content->corner_radius - corner_radius) < 0.01) return;
 
     content->corner_radius = corner_radius;
+    invalidate_visibility(content);
     wm_layout_damage_from(content->wm_server->wm_layout, content, NULL);
 }
 
@@ -205,11 +314,81 @@ double wm_content_get_corner_radius(struct wm_content* content){
     return content->corner_radius;
 }
 
+void wm_content_set_cacheable(struct wm_content* content, bool cacheable){
+    content->cacheable = cacheable;
+    wm_content_invalidate_render_cache(content);
+}
+
+void wm_content_invalidate_render_cache(struct wm_content* content){
+    if(content->render_cache) content->render_cache->valid = false;
+}
+
 void wm_content_destroy(struct wm_content* content){
     wm_layout_damage_from(content->wm_server->wm_layout, content, NULL);
+    invalidate_visibility(content);
     (*content->vtable->destroy)(content);
 }
 
+/* Returns false if content is to be rendered directly */
+static bool render_cached(struct wm_content* content, struct wm_output* output, pixman_region32_t* damage, struct timespec now){
+    struct wm_server* server = content->wm_server;
+    if(!content->cacheable || !server->wm_config->render_cache){
+        wm_content_free_render_cache(content);
+        return false;
+    }
+
+    /* Only one output is kept */
+    struct wm_output* other;
+    wl_list_for_each(other, &server->wm_layout->wm_outputs, link){
+        if(other != output && wm_content_is_on_output(content, other)) return false;
+    }
+
+    int width, height;
+    wlr_output_transformed_resolution(output->wlr_output, &width, &height);
+
+    pixman_region32_t region;
+    pixman_region32_init(&region);
+    wm_content_extents(content, output, &region);
+    region_clip_workspace(&region, content, output);
+    pixman_region32_intersect_rect(&region, &region, 0, 0, width, height);
+
+    pixman_box32_t* extents = pixman_region32_extents(&region);
+    struct wlr_box box = {
+        .x = extents->x1,
+        .y = extents->y1,
+        .width = extents->x2 - extents->x1,
+        .height = extents->y2 - extents->y1
+    };
+    pixman_region32_fini(&region);
+    if(wlr_box_empty(&box)) return false;
+
+    if(!content->render_cache){
+        content->render_cache = calloc(1, sizeof(struct wm_renderer_cache));
+    }
+    struct wm_renderer_cache* cache = content->render_cache;
+
+    bool corners = wm_output_renders_corners(output);
+    if(!cache->valid || cache->output != output ||
+            cache->quality_level != output->governor.level || cache->corners != corners ||
+            cache->box.x != box.x || cache->box.y != box.y ||
+            cache->box.width != box.width || cache->box.height != box.height){
+
+        if(!wm_renderer_cache_begin(server->wm_renderer, cache, &box)) return false;
+
+        pixman_region32_t full;
+        pixman_region32_init_rect(&full, box.x, box.y, box.width, box.height);
+        (*content->vtable->render)(content, output, &full, now);
+        pixman_region32_fini(&full);
+
+        wm_renderer_cache_end(server->wm_renderer, cache);
+        cache->quality_level = output->governor.level;
+        cache->corners = corners;
+    }
+
+    wm_renderer_render_cache(server->wm_renderer, damage, cache);
+    return true;
+}
+
 void wm_content_render(struct wm_content* content, struct wm_output* output, pixman_region32_t* output_damage, struct timespec now){
     if(!wm_content_is_on_output(content, output)) return;
 
@@ -217,50 +396,34 @@ void wm_content_render(struct wm_content* content, struct wm_output* output, pix
     pixman_region32_init(&damage_on_workspace);
     pixman_region32_copy(&damage_on_workspace, output_damage);
     if(wm_content_has_workspace(content)){
-        int x = round((content->workspace_x - output->layout_x) * output->wlr_output->scale);
-        int y = round((content->workspace_y - output->layout_y) * output->wlr_output->scale);
-        int w = round(content->workspace_width * output->wlr_output->scale);
-        int h = round(content->workspace_height * output->wlr_output->scale);
-        pixman_region32_intersect_rect(&damage_on_workspace, &damage_on_workspace, x, y, w, h);
+        struct wlr_box workspace;
+        wm_output_snap_box(output, content->workspace_x - output->layout_x, content->workspace_y - output->layout_y,
+                content->workspace_width, content->workspace_height, &workspace);
+        pixman_region32_intersect_rect(&damage_on_workspace, &damage_on_workspace,
+                workspace.x, workspace.y, workspace.width, workspace.height);
     }
 
-    (*content->vtable->render)(content, output, &damage_on_workspace, now);
+    if(!render_cached(content, output, &damage_on_workspace, now)){
+        (*content->vtable->render)(content, output, &damage_on_workspace, now);
+    }
 
     pixman_region32_fini(&damage_on_workspace);
 }
 
+void wm_content_extents_base(struct wm_content* content, struct wm_output* output, pixman_region32_t* region){
+    double x, y, w, h;
+    wm_content_get_box(content, &x, &y, &w, &h);
+    region_add_box(region, output, x, y, w, h);
+}
+
 void wm_content_damage_output_base(struct wm_content* content, struct wm_output* output, struct wlr_surface* origin){
     pixman_region32_t region;
     pixman_region32_init(&region);
 
     double x, y, w, h;
     wm_content_get_box(content, &x, &y, &w, &h);
-    x -= output->layout_x;
-    y -= output->layout_y;
-
-    x *= output->wlr_output->scale;
-    y *= output->wlr_output->scale;
-    w *= output->wlr_output->scale;
-    h *= output->wlr_output->scale;
-    pixman_region32_union_rect(&region, &region,
-            floor(x), floor(y),
-            ceil(x + w) - floor(x), ceil(y + h) - floor(y));
-
-    if(wm_content_has_workspace(content)){
-        double workspace_x, workspace_y, workspace_w, workspace_h;
-        wm_content_get_workspace(content, &workspace_x, &workspace_y,
-                                 &workspace_w, &workspace_h);
-        workspace_x = (workspace_x - output->layout_x) * output->wlr_output->scale;
-        workspace_y = (workspace_y - output->layout_y) * output->wlr_output->scale;
-        workspace_w *= output->wlr_output->scale;
-        workspace_h *= output->wlr_output->scale;
-        pixman_region32_intersect_rect(
-            &region, &region,
-            floor(workspace_x),
-            floor(workspace_y),
-            ceil(workspace_x + workspace_w) - floor(workspace_x),
-            ceil(workspace_y + workspace_h) - floor(workspace_y));
-    }
+    region_add_box(&region, output, x, y, w, h);
+    region_clip_workspace(&region, content, output);
 
     wm_layout_damage_output(output->wm_layout, output, &region, content);
     pixman_region32_fini(&region);
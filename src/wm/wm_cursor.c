@@ -1,8 +1,12 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <time.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include <wayland-server.h>
 #include <assert.h>
+#include <drm_fourcc.h>
 #include <wlr/util/log.h>
 #include "wm/wm_cursor.h"
 #include "wm/wm_seat.h"
@@ -13,23 +17,169 @@
 #include "wm/wm_server.h"
 #include "wm/wm_content.h"
 #include "wm/wm_drag.h"
+#include "wm/wm_idle_inhibit.h"
+#include "wm/wm_renderer.h"
 #include "wm/wm.h"
 #include "wm/wm_util.h"
 
+struct wm_content_vtable wm_cursor_content_vtable;
+
+static struct wm_cursor_output* wm_cursor_output_for(struct wm_cursor* cursor, struct wm_output* output){
+    struct wm_cursor_output* cursor_output;
+    wl_list_for_each(cursor_output, &cursor->outputs, link){
+        if(cursor_output->wm_output == output) return cursor_output;
+    }
+    return NULL;
+}
+
+static bool wm_cursor_output_is_software(struct wm_cursor_output* output){
+    return output->wm_cursor->cursor_visible && !output->hardware;
+}
+
+static void wm_cursor_output_destroy(struct wm_cursor_output* output){
+    if(output->texture) wlr_texture_destroy(output->texture);
+    wlr_output_cursor_destroy(output->wlr_output_cursor);
+    wl_list_remove(&output->destroy.link);
+    wl_list_remove(&output->link);
+    free(output);
+}
+
+static void wm_cursor_output_apply(struct wm_cursor_output* output){
+    struct wm_cursor* cursor = output->wm_cursor;
+    struct wlr_output* wlr_output = output->wm_output->wlr_output;
+
+    if(output->texture){
+        wlr_texture_destroy(output->texture);
+        output->texture = NULL;
+    }
+    output->hardware = false;
+
+    if(!cursor->cursor_visible){
+        wlr_output_cursor_set_image(output->wlr_output_cursor, NULL, 0, 0, 0, 0, 0);
+        return;
+    }
+
+    struct wlr_xcursor_image* image = NULL;
+    if(cursor->client_image.surface){
+        wlr_output_cursor_set_surface(output->wlr_output_cursor, cursor->client_image.surface,
+                cursor->client_image.hotspot_x, cursor->client_image.hotspot_y);
+    }else{
+        struct wlr_xcursor* xcursor = cursor->image ?
+            wlr_xcursor_manager_get_xcursor(cursor->wlr_xcursor_manager, cursor->image, wlr_output->scale) : NULL;
+        if(!xcursor){
+            wlr_output_cursor_set_image(output->wlr_output_cursor, NULL, 0, 0, 0, 0, 0);
+            return;
+        }
+
+        image = xcursor->images[0];
+        wlr_output_cursor_set_image(output->wlr_output_cursor, image->buffer,
+                4 * image->width, image->width, image->height,
+                image->hotspot_x, image->hotspot_y);
+    }
+
+    output->hardware = wlr_output->hardware_cursor == output->wlr_output_cursor;
+    if(output->hardware) return;
+
+    /* No plane (e.g. headless or nested) - hide wlroots' software cursor and draw it as part of the scene */
+    wlr_output_cursor_set_image(output->wlr_output_cursor, NULL, 0, 0, 0, 0, 0);
+    if(image){
+        output->texture = wlr_texture_from_pixels(cursor->wm_seat->wm_server->wm_renderer->wlr_renderer,
+                DRM_FORMAT_ARGB8888, 4 * image->width, image->width, image->height, image->buffer);
+    }else{
+        wlr_surface_send_enter(cursor->client_image.surface, wlr_output);
+    }
+}
+
+/* Moves hardware cursors and the software cursor content - the latter damages old and new box */
+static void wm_cursor_update_position(struct wm_cursor* cursor){
+    double x = cursor->wlr_cursor->x;
+    double y = cursor->wlr_cursor->y;
+
+    struct wm_cursor_output* output;
+    wl_list_for_each(output, &cursor->outputs, link){
+        wlr_output_cursor_move(output->wlr_output_cursor,
+                x - output->wm_output->layout_x,
+                y - output->wm_output->layout_y);
+    }
+
+    double width = 0., height = 0., hotspot_x = 0., hotspot_y = 0.;
+    if(cursor->client_image.surface){
+        width = cursor->client_image.surface->current.width;
+        height = cursor->client_image.surface->current.height;
+        hotspot_x = cursor->client_image.hotspot_x;
+        hotspot_y = cursor->client_image.hotspot_y;
+    }else if(cursor->image){
+        /* Logical size - outputs use the image loaded for their scale */
+        struct wlr_xcursor* xcursor = wlr_xcursor_manager_get_xcursor(cursor->wlr_xcursor_manager, cursor->image, 1.);
+        if(xcursor){
+            width = xcursor->images[0]->width;
+            height = xcursor->images[0]->height;
+            hotspot_x = xcursor->images[0]->hotspot_x;
+            hotspot_y = xcursor->images[0]->hotspot_y;
+        }
+    }
+
+    wm_content_set_box(&cursor->software->super, x - hotspot_x, y - hotspot_y, width, height);
+}
+
+static void wm_cursor_apply(struct wm_cursor* cursor){
+    struct wm_layout* layout = cursor->wm_seat->wm_server->wm_layout;
+
+    wm_layout_damage_from(layout, &cursor->software->super, NULL);
+
+    struct wm_cursor_output* output;
+    wl_list_for_each(output, &cursor->outputs, link){
+        wm_cursor_output_apply(output);
+    }
+    wm_cursor_update_position(cursor);
+
+    wm_layout_damage_from(layout, &cursor->software->super, NULL);
+}
+
+/* Returns true if the motion has been queued for python instead of passed synchronously */
+static bool wm_cursor_queue_motion(struct wm_cursor* cursor, double delta_x, double delta_y, uint32_t time_msec){
+    if(!cursor->wm_seat->wm_server->wm_config->coalesce_motion) return false;
+    if(cursor->coalesced_motion.synchronous) return false;
+
+    if(!cursor->coalesced_motion.pending){
+        cursor->coalesced_motion.pending = true;
+        cursor->coalesced_motion.delta_x = 0.;
+        cursor->coalesced_motion.delta_y = 0.;
+        wl_event_source_timer_update(cursor->coalesced_motion.timer, WM_CURSOR_COALESCE_MOTION_MS);
+    }
+
+    cursor->coalesced_motion.delta_x += delta_x;
+    cursor->coalesced_motion.delta_y += delta_y;
+    cursor->coalesced_motion.time_msec = time_msec;
+    return true;
+}
+
+static void notify_activity(struct wm_cursor* cursor){
+    wm_idle_inhibit_notify_activity(cursor->wm_seat->wm_server->wm_idle_inhibit);
+}
+
 /*
  * Callbacks
  */
 static void handle_motion(struct wl_listener* listener, void* data){
     struct wm_cursor* cursor = wl_container_of(listener, cursor, motion);
+    notify_activity(cursor);
     struct wlr_event_pointer_motion* event = data;
 
     clock_t t_msec = clock() * 1000 / CLOCKS_PER_SEC;
     cursor->msec_delta = event->time_msec - t_msec;
 
+    double x = cursor->wlr_cursor->x;
+    double y = cursor->wlr_cursor->y;
     wlr_cursor_move(cursor->wlr_cursor, event->device, event->delta_x, event->delta_y);
-    if(wm_callback_motion(event->delta_x, event->delta_y, cursor->wlr_cursor->x, cursor->wlr_cursor->y, event->time_msec)){
-        wlr_cursor_move(cursor->wlr_cursor, event->device, -event->delta_x, -event->delta_y);
-        return;
+
+    if(!wm_cursor_queue_motion(cursor, event->delta_x, event->delta_y, event->time_msec)){
+        cursor->coalesced_motion.synchronous = wm_callback_motion(event->delta_x, event->delta_y, cursor->wlr_cursor->x, cursor->wlr_cursor->y, event->time_msec);
+        if(cursor->coalesced_motion.synchronous){
+            /* Back to the exact previous position, which has been valid */
+            wlr_cursor_warp(cursor->wlr_cursor, NULL, x, y);
+            return;
+        }
     }
 
     wm_cursor_update(cursor);
@@ -37,6 +187,7 @@ static void handle_motion(struct wl_listener* listener, void* data){
 
 static void handle_motion_absolute(struct wl_listener* listener, void* data){
     struct wm_cursor* cursor = wl_container_of(listener, cursor, motion_absolute);
+    notify_activity(cursor);
     struct wlr_event_pointer_motion_absolute* event = data;
 
     double lx, ly;
@@ -45,8 +196,9 @@ static void handle_motion_absolute(struct wl_listener* listener, void* data){
     double dx = lx - cursor->wlr_cursor->x;
     double dy = ly - cursor->wlr_cursor->y;
 
-    if(wm_callback_motion(dx, dy, lx, ly, event->time_msec)){
-        return;
+    if(!wm_cursor_queue_motion(cursor, dx, dy, event->time_msec)){
+        cursor->coalesced_motion.synchronous = wm_callback_motion(dx, dy, lx, ly, event->time_msec);
+        if(cursor->coalesced_motion.synchronous) return;
     }
 
     wlr_cursor_move(cursor->wlr_cursor, event->device, dx, dy);
@@ -55,8 +207,12 @@ static void handle_motion_absolute(struct wl_listener* listener, void* data){
 
 static void handle_button(struct wl_listener* listener, void* data){
     struct wm_cursor* cursor = wl_container_of(listener, cursor, button);
+    notify_activity(cursor);
     struct wlr_event_pointer_button* event = data;
 
+    /* Python sees motion before the press */
+    wm_cursor_flush_motion(cursor);
+
     if(wm_callback_button(event)){
         wm_seat_kill_seatop(cursor->wm_seat);
         return;
@@ -67,8 +223,11 @@ static void handle_button(struct wl_listener* listener, void* data){
 
 static void handle_axis(struct wl_listener* listener, void* data){
     struct wm_cursor* cursor = wl_container_of(listener, cursor, axis);
+    notify_activity(cursor);
     struct wlr_event_pointer_axis* event = data;
 
+    wm_cursor_flush_motion(cursor);
+
     if(wm_callback_axis(event)){
         return;
     }
@@ -87,9 +246,37 @@ static void handle_surface_destroy(struct wl_listener* listener, void* data){
     wm_cursor_set_image_surface(cursor, NULL, 0, 0);
 }
 
+static void handle_surface_commit(struct wl_listener* listener, void* data){
+    struct wm_cursor* cursor = wl_container_of(listener, cursor, surface_commit);
+
+    /* wlroots silently falls back to its own software cursor if the plane does not accept the new buffer */
+    struct wm_cursor_output* output;
+    wl_list_for_each(output, &cursor->outputs, link){
+        if(output->hardware && output->wm_output->wlr_output->hardware_cursor != output->wlr_output_cursor){
+            wm_cursor_apply(cursor);
+            return;
+        }
+    }
+
+    wm_cursor_update_position(cursor);
+    wm_layout_damage_from(cursor->wm_seat->wm_server->wm_layout, &cursor->software->super, cursor->client_image.surface);
+}
+
+static int handle_coalesced_motion_timer(void* data){
+    struct wm_cursor* cursor = data;
+    wm_cursor_flush_motion(cursor);
+    return 0;
+}
+
+static void handle_output_destroy(struct wl_listener* listener, void* data){
+    struct wm_cursor_output* output = wl_container_of(listener, output, destroy);
+    wm_cursor_output_destroy(output);
+}
+
 static void handle_pointer_pinch_begin(struct wl_listener *listener, void *data) {
     struct wm_cursor *cursor = wl_container_of(
             listener, cursor, pinch_begin);
+    notify_activity(cursor);
     struct wlr_event_pointer_pinch_begin *event = data;
 
     if(wm_callback_gesture_pinch_begin(event)){
@@ -105,6 +292,7 @@ static void handle_pointer_pinch_begin(struct wl_listener *listener, void *data)
 static void handle_pointer_pinch_update(struct wl_listener *listener, void *data) {
     struct wm_cursor *cursor = wl_container_of(
             listener, cursor, pinch_update);
+    notify_activity(cursor);
     struct wlr_event_pointer_pinch_update *event = data;
 
     if(wm_callback_gesture_pinch_update(event)){
@@ -120,6 +308,7 @@ static void handle_pointer_pinch_update(struct wl_listener *listener, void *data
 static void handle_pointer_pinch_end(struct wl_listener *listener, void *data) {
     struct wm_cursor *cursor = wl_container_of(
             listener, cursor, pinch_end);
+    notify_activity(cursor);
     struct wlr_event_pointer_pinch_end *event = data;
 
     if(wm_callback_gesture_pinch_end(event) && !cursor->pinch_started){
@@ -135,6 +324,7 @@ static void handle_pointer_pinch_end(struct wl_listener *listener, void *data) {
 static void handle_pointer_swipe_begin(struct wl_listener *listener, void *data) {
     struct wm_cursor *cursor = wl_container_of(
             listener, cursor, swipe_begin);
+    notify_activity(cursor);
     struct wlr_event_pointer_swipe_begin *event = data;
 
     if(wm_callback_gesture_swipe_begin(event)){
@@ -150,6 +340,7 @@ static void handle_pointer_swipe_begin(struct wl_listener *listener, void *data)
 static void handle_pointer_swipe_update(struct wl_listener *listener, void *data) {
     struct wm_cursor *cursor = wl_container_of(
             listener, cursor, swipe_update);
+    notify_activity(cursor);
     struct wlr_event_pointer_swipe_update *event = data;
 
     if(wm_callback_gesture_swipe_update(event)){
@@ -164,6 +355,7 @@ static void handle_pointer_swipe_update(struct wl_listener *listener, void *data
 static void handle_pointer_swipe_end(struct wl_listener *listener, void *data) {
     struct wm_cursor *cursor = wl_container_of(
             listener, cursor, swipe_end);
+    notify_activity(cursor);
     struct wlr_event_pointer_swipe_end *event = data;
 
     if(wm_callback_gesture_swipe_end(event) && !cursor->swipe_started){
@@ -187,6 +379,19 @@ void wm_cursor_init(struct wm_cursor* cursor, struct wm_seat* seat, struct wm_la
 
     wlr_cursor_attach_output_layout(cursor->wlr_cursor, layout->wlr_output_layout);
 
+    wl_list_init(&cursor->outputs);
+    cursor->image = NULL;
+    cursor->client_image.surface = NULL;
+    cursor->cursor_visible = 0;
+
+    cursor->software = calloc(1, sizeof(struct wm_cursor_content));
+    wm_content_init(&cursor->software->super, seat->wm_server);
+    cursor->software->super.vtable = &wm_cursor_content_vtable;
+    cursor->software->wm_cursor = cursor;
+    wm_content_set_opacity(&cursor->software->super, 1.);
+    wm_content_set_z_index(&cursor->software->super, WM_CURSOR_Z_INDEX);
+    wm_content_set_lock_enabled(&cursor->software->super, true);
+
     cursor->wlr_xcursor_manager = NULL;
     wm_cursor_reconfigure(cursor);
 
@@ -208,6 +413,9 @@ void wm_cursor_init(struct wm_cursor* cursor, struct wm_seat* seat, struct wm_la
     wl_list_init(&cursor->surface_destroy.link);
     cursor->surface_destroy.notify = handle_surface_destroy;
 
+    wl_list_init(&cursor->surface_commit.link);
+    cursor->surface_commit.notify = handle_surface_commit;
+
     cursor->pointer_gestures = wlr_pointer_gestures_v1_create(cursor->wm_seat->wm_server->wl_display);
     cursor->pinch_begin.notify = handle_pointer_pinch_begin;
     wl_signal_add(&cursor->wlr_cursor->events.pinch_begin, &cursor->pinch_begin);
@@ -225,11 +433,34 @@ void wm_cursor_init(struct wm_cursor* cursor, struct wm_seat* seat, struct wm_la
     cursor->swipe_started = false;
     cursor->pinch_started = false;
 
-    cursor->cursor_visible = 0;
+    cursor->coalesced_motion.pending = false;
+    cursor->coalesced_motion.synchronous = false;
+    cursor->coalesced_motion.timer = wl_event_loop_add_timer(
+            seat->wm_server->wl_event_loop, handle_coalesced_motion_timer, cursor);
 }
 
 void wm_cursor_ensure_loaded_for_scale(struct wm_cursor* cursor, double scale){
     wlr_xcursor_manager_load(cursor->wlr_xcursor_manager, scale);
+
+    /* Output scale might have changed */
+    wm_cursor_apply(cursor);
+}
+
+void wm_cursor_add_output(struct wm_cursor* cursor, struct wm_output* output){
+    struct wm_cursor_output* cursor_output = calloc(1, sizeof(struct wm_cursor_output));
+    cursor_output->wm_cursor = cursor;
+    cursor_output->wm_output = output;
+    cursor_output->wlr_output_cursor = wlr_output_cursor_create(output->wlr_output);
+    cursor_output->hardware = false;
+    cursor_output->texture = NULL;
+    assert(cursor_output->wlr_output_cursor);
+
+    cursor_output->destroy.notify = handle_output_destroy;
+    wl_signal_add(&output->wlr_output->events.destroy, &cursor_output->destroy);
+
+    wl_list_insert(&cursor->outputs, &cursor_output->link);
+
+    wm_cursor_apply(cursor);
 }
 
 void wm_cursor_destroy(struct wm_cursor* cursor) {
@@ -239,6 +470,7 @@ void wm_cursor_destroy(struct wm_cursor* cursor) {
     wl_list_remove(&cursor->axis.link);
     wl_list_remove(&cursor->frame.link);
     wl_list_remove(&cursor->surface_destroy.link);
+    wl_list_remove(&cursor->surface_commit.link);
 
     wl_list_remove(&cursor->pinch_begin.link);
     wl_list_remove(&cursor->pinch_update.link);
@@ -246,6 +478,17 @@ void wm_cursor_destroy(struct wm_cursor* cursor) {
     wl_list_remove(&cursor->swipe_begin.link);
     wl_list_remove(&cursor->swipe_update.link);
     wl_list_remove(&cursor->swipe_end.link);
+
+    struct wm_cursor_output* output, *tmp;
+    wl_list_for_each_safe(output, tmp, &cursor->outputs, link){
+        wm_cursor_output_destroy(output);
+    }
+
+    wl_event_source_remove(cursor->coalesced_motion.timer);
+
+    wm_content_destroy(&cursor->software->super);
+    free(cursor->software);
+    free(cursor->image);
 }
 
 void wm_cursor_add_pointer(struct wm_cursor* cursor, struct wm_pointer* pointer){
@@ -253,12 +496,11 @@ void wm_cursor_add_pointer(struct wm_cursor* cursor, struct wm_pointer* pointer)
 }
 
 void wm_cursor_update(struct wm_cursor* cursor){
-    struct wm_content* r;
-    wl_list_for_each(r, &cursor->wm_seat->wm_server->wm_contents, link) {
-        if(wm_content_is_drag(r)){
-            struct wm_drag* drag = wm_cast(wm_drag, r);
-            wm_drag_update_position(drag);
-        }
+    wm_cursor_update_position(cursor);
+
+    struct wm_drag* drag;
+    wl_list_for_each(drag, &cursor->wm_seat->wm_drags, link_seat){
+        wm_drag_update_position(drag);
     }
 
     clock_t t_msec = clock() * 1000 / CLOCKS_PER_SEC;
@@ -269,17 +511,22 @@ void wm_cursor_update(struct wm_cursor* cursor){
     }
 }
 
+void wm_cursor_flush_motion(struct wm_cursor* cursor){
+    if(!cursor->coalesced_motion.pending) return;
+    cursor->coalesced_motion.pending = false;
+    wl_event_source_timer_update(cursor->coalesced_motion.timer, 0);
+
+    /* Cursor and clients have already followed - once python consumes, further motion waits for its decision */
+    cursor->coalesced_motion.synchronous = wm_callback_motion(
+            cursor->coalesced_motion.delta_x, cursor->coalesced_motion.delta_y,
+            cursor->wlr_cursor->x, cursor->wlr_cursor->y, cursor->coalesced_motion.time_msec);
+}
+
 void wm_cursor_set_visible(struct wm_cursor* cursor, int visible){
-    cursor->cursor_visible = visible;
+    if(cursor->cursor_visible == visible) return;
 
-    if(cursor->client_image.surface){
-        wm_cursor_set_image_surface(cursor,
-                cursor->client_image.surface,
-                cursor->client_image.hotspot_x,
-                cursor->client_image.hotspot_y);
-    }else{
-        wm_cursor_set_image(cursor, "left_ptr");
-    }
+    cursor->cursor_visible = visible;
+    wm_cursor_apply(cursor);
 }
 
 void wm_cursor_set_position(struct wm_cursor* cursor, int pos_x, int pos_y){
@@ -288,19 +535,20 @@ void wm_cursor_set_position(struct wm_cursor* cursor, int pos_x, int pos_y){
 }
 
 void wm_cursor_set_image(struct wm_cursor* cursor, const char* image){
+    /* Called on every motion outside of surfaces - avoid reuploading the image */
+    bool unchanged = !cursor->client_image.surface && cursor->image && !strcmp(cursor->image, image);
+
     wl_list_remove(&cursor->surface_destroy.link);
     wl_list_init(&cursor->surface_destroy.link);
+    wl_list_remove(&cursor->surface_commit.link);
+    wl_list_init(&cursor->surface_commit.link);
     cursor->client_image.surface = NULL;
 
-    if(!cursor->cursor_visible){
-        wlr_cursor_set_image(cursor->wlr_cursor, NULL, 0, 0, 0, 0, 0, 0);
-    }else{
-        wlr_xcursor_manager_set_cursor_image(
-                cursor->wlr_xcursor_manager,
-                image,
-                cursor->wlr_cursor
-        );
-    }
+    if(unchanged) return;
+
+    free(cursor->image);
+    cursor->image = strdup(image);
+    wm_cursor_apply(cursor);
 }
 
 void wm_cursor_set_image_surface(struct wm_cursor* cursor, struct wlr_surface* surface, int32_t hotspot_x, int32_t hotspot_y){
@@ -316,11 +564,11 @@ void wm_cursor_set_image_surface(struct wm_cursor* cursor, struct wlr_surface* s
     cursor->client_image.hotspot_x = hotspot_x;
     cursor->client_image.hotspot_y = hotspot_y;
 
-    if(!cursor->cursor_visible){
-        wlr_cursor_set_image(cursor->wlr_cursor, NULL, 0, 0, 0, 0, 0, 0);
-    }else{
-        wlr_cursor_set_surface(cursor->wlr_cursor, surface, hotspot_x, hotspot_y);
-    }
+    wm_cursor_apply(cursor);
+
+    /* After wm_cursor_apply, so wlroots handles the commit first */
+    wl_list_remove(&cursor->surface_commit.link);
+    wl_signal_add(&surface->events.commit, &cursor->surface_commit);
 }
 
 void wm_cursor_reconfigure(struct wm_cursor* cursor){
@@ -333,4 +581,75 @@ void wm_cursor_reconfigure(struct wm_cursor* cursor){
             cursor->wm_seat->wm_server->wm_config->xcursor_theme,
             cursor->wm_seat->wm_server->wm_config->xcursor_size);
     wlr_xcursor_manager_load(cursor->wlr_xcursor_manager, 1.);
+
+    struct wm_cursor_output* output;
+    wl_list_for_each(output, &cursor->outputs, link){
+        wlr_xcursor_manager_load(cursor->wlr_xcursor_manager, output->wm_output->wlr_output->scale);
+    }
+    wm_cursor_apply(cursor);
 }
+
+/*
+ * Software cursor content
+ */
+static void wm_cursor_content_destroy(struct wm_content* super){
+    wm_content_base_destroy(super);
+}
+
+static void wm_cursor_content_render(struct wm_content* super, struct wm_output* output, pixman_region32_t* output_damage, struct timespec now){
+    struct wm_cursor_content* content = wm_cast(wm_cursor_content, super);
+    struct wm_cursor* cursor = content->wm_cursor;
+
+    struct wm_cursor_output* cursor_output = wm_cursor_output_for(cursor, output);
+    if(!cursor_output || !wm_cursor_output_is_software(cursor_output)) return;
+
+    struct wlr_surface* surface = cursor->client_image.surface;
+    struct wlr_texture* texture = surface ? wlr_surface_get_texture(surface) : cursor_output->texture;
+    if(!texture) return;
+
+    struct wlr_box box;
+    wm_output_snap_box(output, super->display_x - output->layout_x, super->display_y - output->layout_y,
+            super->display_width, super->display_height, &box);
+
+    wm_renderer_render_texture_at(
+            output->wm_server->wm_renderer, output_damage,
+            surface, texture, &box, 1., &box, 0, 0.);
+
+    if(surface) wlr_surface_send_frame_done(surface, &now);
+}
+
+static void wm_cursor_content_damage_output(struct wm_content* super, struct wm_output* output, struct wlr_surface* origin){
+    struct wm_cursor_content* content = wm_cast(wm_cursor_content, super);
+
+    /* Hardware cursors do not touch the scene */
+    struct wm_cursor_output* cursor_output = wm_cursor_output_for(content->wm_cursor, output);
+    if(!cursor_output || !wm_cursor_output_is_software(cursor_output)) return;
+
+    wm_content_damage_output_base(super, output, origin);
+}
+
+static void wm_cursor_content_printf(FILE* file, struct wm_content* super){
+    struct wm_cursor_content* content = wm_cast(wm_cursor_content, super);
+
+    int n_software = 0;
+    struct wm_cursor_output* output;
+    wl_list_for_each(output, &content->wm_cursor->outputs, link){
+        if(wm_cursor_output_is_software(output)) n_software++;
+    }
+
+    fprintf(file, "wm_cursor (%f, %f - %f, %f) software on %d of %d outputs\n",
+            super->display_x, super->display_y, super->display_width, super->display_height,
+            n_software, wl_list_length(&content->wm_cursor->outputs));
+}
+
+bool wm_content_is_cursor(struct wm_content* content){
+    return content->vtable == &wm_cursor_content_vtable;
+}
+
+struct wm_content_vtable wm_cursor_content_vtable = {
+    .destroy = &wm_cursor_content_destroy,
+    .render = &wm_cursor_content_render,
+    .damage_output = &wm_cursor_content_damage_output,
+    .extents = NULL,
+    .printf = &wm_cursor_content_printf,
+};
@@ -29,7 +29,7 @@ static void handle_destroy(struct wl_listener* listener, void* data){
     wlr_log(WLR_DEBUG, "Drag: destroying drag (and icon)");
     struct wm_drag* drag = wl_container_of(listener, drag, destroy);
 
-    wm_layout_damage_from(drag->wm_seat->wm_server->wm_layout, &drag->super, NULL);
+    /* Damages the icon */
     wm_content_destroy(&drag->super);
     free(drag);
 }
@@ -44,6 +44,7 @@ static void icon_handle_destroy(struct wl_listener* listener, void* data){
 static void icon_handle_surface_commit(struct wl_listener* listener, void* data){
     struct wm_drag* drag = wl_container_of(listener, drag, icon_surface_commit);
     wm_drag_update_position(drag);
+    wm_layout_damage_from(drag->wm_seat->wm_server->wm_layout, &drag->super, NULL);
 }
 
 static void icon_handle_map(struct wl_listener* listener, void* data){
@@ -51,6 +52,7 @@ static void icon_handle_map(struct wl_listener* listener, void* data){
 
     wlr_log(WLR_DEBUG, "Drag: surface map");
     wm_drag_update_position(drag);
+    wm_layout_damage_from(drag->wm_seat->wm_server->wm_layout, &drag->super, NULL);
 }
 static void icon_handle_unmap(struct wl_listener* listener, void* data){
     struct wm_drag* drag = wl_container_of(listener, drag, icon_unmap);
@@ -67,6 +69,8 @@ void wm_drag_init(struct wm_drag* drag, struct wm_seat* seat, struct wlr_drag* w
     wm_content_set_box(&drag->super, 0, 0, 0, 0);
 
     drag->wm_seat = seat;
+    wl_list_insert(&seat->wm_drags, &drag->link_seat);
+
     drag->wlr_drag = wlr_drag;
 
     drag->destroy.notify = handle_destroy;
@@ -91,22 +95,22 @@ void wm_drag_init(struct wm_drag* drag, struct wm_seat* seat, struct wlr_drag* w
 }
 
 void wm_drag_update_position(struct wm_drag* drag){
-    wm_layout_damage_from(drag->wm_seat->wm_server->wm_layout, &drag->super, NULL);
     /* Surface width / height are not set correctly - hacky way via output scale */
     if(!drag->wlr_drag_icon || !drag->wlr_drag_icon->surface) return;
 
+    /* The icon is cropped to its box - damage old and new box only */
     double width = drag->wlr_drag_icon->surface->current.buffer_width;
     double height = drag->wlr_drag_icon->surface->current.buffer_height;
-    wm_content_set_box(&drag->super,
+    wm_content_move_box(&drag->super,
                        drag->wm_seat->wm_cursor->wlr_cursor->x - .5*width,
                        drag->wm_seat->wm_cursor->wlr_cursor->y - .5*height,
                        width, height);
-    wm_layout_damage_from(drag->wm_seat->wm_server->wm_layout, &drag->super, NULL);
 }
 
 static void wm_drag_destroy(struct wm_content* super){
     struct wm_drag* drag = wm_cast(wm_drag, super);
     wl_list_remove(&drag->destroy.link);
+    wl_list_remove(&drag->link_seat);
     wm_drag_icon_destroy(drag);
 
     wm_content_base_destroy(super);
@@ -116,11 +120,9 @@ static void wm_drag_render(struct wm_content* super, struct wm_output* output, p
     struct wm_drag* drag = wm_cast(wm_drag, super);
     if(!drag->wlr_drag_icon) return;
 
-    struct wlr_box unscaled = {
-        .x = round((drag->super.display_x - output->layout_x) * output->wlr_output->scale),
-        .y = round((drag->super.display_y - output->layout_y) * output->wlr_output->scale),
-        .width = round(drag->super.display_width * output->wlr_output->scale),
-        .height = round(drag->super.display_height * output->wlr_output->scale)};
+    struct wlr_box unscaled;
+    wm_output_snap_box(output, drag->super.display_x - output->layout_x, drag->super.display_y - output->layout_y,
+            drag->super.display_width, drag->super.display_height, &unscaled);
 
     /* drag icons do not seem to properly handle scaling - therefore simply crop by output_scale */
     struct wlr_box box = {
@@ -154,5 +156,6 @@ struct wm_content_vtable wm_drag_vtable = {
     .destroy = &wm_drag_destroy,
     .render = &wm_drag_render,
     .damage_output = NULL,
+    .extents = NULL,
     .printf = &wm_drag_printf,
 };
@@ -1,13 +1,72 @@
 #define _POSIX_C_SOURCE 200809L
 
+#include <math.h>
 #include <stdlib.h>
 #include <wayland-server.h>
 #include <wlr/util/log.h>
 #include <wlr/types/wlr_idle_inhibit_v1.h>
 
 #include "wm/wm_server.h"
+#include "wm/wm_config.h"
 #include "wm/wm_view.h"
 #include "wm/wm_idle_inhibit.h"
+#include "wm/wm.h"
+
+/*
+ * Helpers
+ */
+static double seconds_since(struct timespec* t){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - t->tv_sec) + (now.tv_nsec - t->tv_nsec) / 1000000000.;
+}
+
+/* Smallest configured timeout not yet reported - 0 if there is none */
+static double next_timeout(struct wm_idle_inhibit* inhibit){
+    struct wm_config* config = inhibit->wm_server->wm_config;
+
+    double next = 0.;
+    for(int i=0; i<config->n_idle_timeouts; i++){
+        double t = config->idle_timeouts[i];
+        if(t > inhibit->idle_timeout && (next == 0. || t < next)) next = t;
+    }
+    return next;
+}
+
+static void arm_timer(struct wm_idle_inhibit* inhibit){
+    double next = next_timeout(inhibit);
+    if(next == 0.){
+        wl_event_source_timer_update(inhibit->timer, 0);
+        return;
+    }
+
+    int msec = ceil((next - seconds_since(&inhibit->last_activity)) * 1000.);
+    wl_event_source_timer_update(inhibit->timer, msec < 1 ? 1 : msec);
+}
+
+/*
+ * Callbacks
+ */
+static int handle_timer(void* data){
+    struct wm_idle_inhibit* inhibit = data;
+    double elapsed = seconds_since(&inhibit->last_activity);
+
+    /* Activity in between only moved last_activity - the timeout might not be reached yet */
+    double next;
+    bool reached = false;
+    while((next = next_timeout(inhibit)) > 0. && next <= elapsed + 0.001){
+        inhibit->idle_timeout = next;
+        reached = true;
+    }
+
+    if(reached){
+        wlr_log(WLR_DEBUG, "Idle: %.1fs since last activity", elapsed);
+        wm_callback_idle(elapsed, wm_idle_inhibit_is_inhibited(inhibit));
+    }
+
+    arm_timer(inhibit);
+    return 0;
+}
 
 static void handle_destroy(struct wl_listener* listener, void* data){
     wlr_log(WLR_DEBUG, "Inhibit: Destroying idle inhibitor");
@@ -17,6 +76,17 @@ static void handle_destroy(struct wl_listener* listener, void* data){
     free(inhibitor);
 }
 
+/* Only transitions of the inhibited state are passed on */
+static void update_inhibited(struct wm_idle_inhibit* inhibit, int delta){
+    bool was_inhibited = wm_idle_inhibit_is_inhibited(inhibit);
+    inhibit->n_inhibitors += delta;
+    bool inhibited = wm_idle_inhibit_is_inhibited(inhibit);
+    if(inhibited == was_inhibited) return;
+
+    wlr_log(WLR_DEBUG, "Inhibit: %s", inhibited ? "inhibited" : "not inhibited");
+    wm_callback_idle(inhibit->idle_timeout > 0. ? seconds_since(&inhibit->last_activity) : 0., inhibited);
+}
+
 void wm_idle_inhibitor_init(struct wm_idle_inhibitor* inhibitor, struct wm_idle_inhibit* parent, struct wlr_idle_inhibitor_v1* wlr_inhibitor){
     inhibitor->wlr_inhibitor = wlr_inhibitor;
     inhibitor->parent = parent;
@@ -27,6 +97,7 @@ void wm_idle_inhibitor_init(struct wm_idle_inhibitor* inhibitor, struct wm_idle_
 
     if(inhibitor->view){
         wm_view_set_inhibiting_idle(inhibitor->view, true);
+        update_inhibited(parent, 1);
     }
 
 }
@@ -36,6 +107,7 @@ void wm_idle_inhibitor_destroy(struct wm_idle_inhibitor* inhibitor){
 
     if(inhibitor->view){
         wm_view_set_inhibiting_idle(inhibitor->view, false);
+        update_inhibited(inhibitor->parent, -1);
     }
 }
 
@@ -48,14 +120,44 @@ static void handle_new_idle_inhibitor(struct wl_listener* listener, void* data){
     wm_idle_inhibitor_init(inhibitor, inhibit, wlr_inhibitor);
 }
 
+/*
+ * Class implementation
+ */
 void wm_idle_inhibit_init(struct wm_idle_inhibit* inhibit, struct wm_server* server){
     inhibit->wm_server = server;
     inhibit->wlr_idle_inhibit_manager = wlr_idle_inhibit_v1_create(server->wl_display);
 
+    inhibit->n_inhibitors = 0;
+    inhibit->idle_timeout = 0.;
+    clock_gettime(CLOCK_MONOTONIC, &inhibit->last_activity);
+
+    inhibit->timer = wl_event_loop_add_timer(
+            wl_display_get_event_loop(server->wl_display), handle_timer, inhibit);
+    arm_timer(inhibit);
+
     inhibit->new_idle_inhibitor.notify = handle_new_idle_inhibitor;
     wl_signal_add(&inhibit->wlr_idle_inhibit_manager->events.new_inhibitor, &inhibit->new_idle_inhibitor);
 }
 
 void wm_idle_inhibit_destroy(struct wm_idle_inhibit* inhibit){
     wl_list_remove(&inhibit->new_idle_inhibitor.link);
+    wl_event_source_remove(inhibit->timer);
+}
+
+void wm_idle_inhibit_notify_activity(struct wm_idle_inhibit* inhibit){
+    clock_gettime(CLOCK_MONOTONIC, &inhibit->last_activity);
+    if(inhibit->idle_timeout == 0.) return;
+
+    /* Wakeup */
+    inhibit->idle_timeout = 0.;
+    wm_callback_idle(0., wm_idle_inhibit_is_inhibited(inhibit));
+    arm_timer(inhibit);
+}
+
+void wm_idle_inhibit_reconfigure(struct wm_idle_inhibit* inhibit){
+    arm_timer(inhibit);
+}
+
+bool wm_idle_inhibit_is_inhibited(struct wm_idle_inhibit* inhibit){
+    return inhibit->n_inhibitors > 0;
 }
@@ -0,0 +1,41 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <wlr/util/log.h>
+
+#include "wm/wm_keybindings.h"
+
+void wm_keybindings_set(struct wm_keybindings* keybindings, int n_bindings, struct wm_keybinding* bindings){
+    wm_keybindings_destroy(keybindings);
+
+    if(n_bindings < 0){
+        free(bindings);
+        wlr_log(WLR_DEBUG, "Keybindings: Disabled - passing all keys to python");
+        return;
+    }
+
+    keybindings->enabled = true;
+    keybindings->n_bindings = n_bindings;
+    keybindings->bindings = bindings;
+    wlr_log(WLR_DEBUG, "Keybindings: Set %d bindings", n_bindings);
+}
+
+void wm_keybindings_destroy(struct wm_keybindings* keybindings){
+    free(keybindings->bindings);
+    keybindings->bindings = NULL;
+    keybindings->n_bindings = 0;
+    keybindings->enabled = false;
+}
+
+bool wm_keybindings_match(struct wm_keybindings* keybindings, uint32_t modifiers,
+        const xkb_keysym_t* keysyms, size_t n_keysyms){
+    for(int i=0; i<keybindings->n_bindings; i++){
+        struct wm_keybinding* binding = &keybindings->bindings[i];
+        if(binding->modifiers != WM_KEYBINDING_ANY_MODIFIERS && binding->modifiers != modifiers) continue;
+
+        for(size_t j=0; j<n_keysyms; j++){
+            if(keysyms[j] == binding->keysym) return true;
+        }
+    }
+    return false;
+}
@@ -1,6 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <assert.h>
+#include <string.h>
 #include <wayland-server.h>
 #include <wlr/util/log.h>
 #include <wlr/backend.h>
@@ -11,11 +12,41 @@
 #include "wm/wm_seat.h"
 #include "wm/wm_server.h"
 #include "wm/wm_config.h"
+#include "wm/wm_idle_inhibit.h"
 #include "wm/wm.h"
 
 
 #define KEYS_STRING_LENGTH 256
 
+static bool is_bound(struct wm_keyboard* keyboard, struct wlr_event_keyboard_key* event,
+        const xkb_keysym_t* keysyms, size_t keysyms_len){
+    if(event->keycode >= WM_KEYBOARD_KEYCODES) return false;
+    uint32_t bit = 1u << (event->keycode % 32);
+    uint32_t* word = &keyboard->bound_keys[event->keycode / 32];
+
+    if(event->state != WL_KEYBOARD_KEY_STATE_PRESSED){
+        /* Modifiers might have been released already */
+        bool bound = *word & bit;
+        *word &= ~bit;
+        return bound;
+    }
+
+    bool bound = wm_keybindings_match(&get_wm()->keybindings,
+            keyboard->wlr_input_device->keyboard->modifiers.depressed,
+            keysyms, keysyms_len);
+    if(bound){
+        *word |= bit;
+    }else{
+        *word &= ~bit;
+    }
+    return bound;
+}
+
+static void unbind(struct wm_keyboard* keyboard, struct wlr_event_keyboard_key* event){
+    if(event->keycode >= WM_KEYBOARD_KEYCODES) return;
+    keyboard->bound_keys[event->keycode / 32] &= ~(1u << (event->keycode % 32));
+}
+
 /*
  * Callbacks
  */
@@ -26,6 +57,7 @@ static void handle_destroy(struct wl_listener* listener, void* data){
 
 static void handle_key(struct wl_listener* listener, void* data){
     struct wm_keyboard* keyboard = wl_container_of(listener, keyboard, key);
+    wm_idle_inhibit_notify_activity(keyboard->wm_seat->wm_server->wm_idle_inhibit);
     struct wlr_event_keyboard_key* event = data;
 
     xkb_keycode_t keycode = event->keycode + 8;
@@ -62,6 +94,18 @@ static void handle_key(struct wl_listener* listener, void* data){
         }
     }
 
+    if(keyboard->wm_seat->wm_server->wm_config->debug){
+        if(keysyms_len == 1 && keysyms[0] == XKB_KEY_F1 && event->state == WL_KEYBOARD_KEY_STATE_PRESSED){
+            wm_server_printf(stderr, keyboard->wm_seat->wm_server);
+        }
+    }
+
+    struct wm_keybindings* keybindings = &get_wm()->keybindings;
+    if(keybindings->enabled && !is_bound(keyboard, event, keysyms, keysyms_len)){
+        wm_seat_dispatch_key(keyboard->wm_seat, keyboard->wlr_input_device, event);
+        return;
+    }
+
     char keys[KEYS_STRING_LENGTH] = { 0 };
     size_t at=0;
     for(size_t i=0; i<keysyms_len; i++){
@@ -69,22 +113,21 @@ static void handle_key(struct wl_listener* listener, void* data){
     }
     assert(at < KEYS_STRING_LENGTH - 1);
 
-
-    if(keyboard->wm_seat->wm_server->wm_config->debug){
-        if(!strcmp(keys, "F1") && event->state == WL_KEYBOARD_KEY_STATE_PRESSED){
-            wm_server_printf(stderr, keyboard->wm_seat->wm_server);
-        }
-    }
-
     if(wm_callback_key(event, keys)){
         return;
     }
 
+    /* Press has not been taken - its release has to reach the client as well */
+    if(keybindings->enabled && event->state == WL_KEYBOARD_KEY_STATE_PRESSED){
+        unbind(keyboard, event);
+    }
+
     wm_seat_dispatch_key(keyboard->wm_seat, keyboard->wlr_input_device, event);
 }
 
 static void handle_modifiers(struct wl_listener* listener, void* data){
     struct wm_keyboard* keyboard = wl_container_of(listener, keyboard, modifiers);
+    wm_idle_inhibit_notify_activity(keyboard->wm_seat->wm_server->wm_idle_inhibit);
 
     if(wm_callback_modifiers(&keyboard->wlr_input_device->keyboard->modifiers)){
         return;
@@ -99,6 +142,7 @@ static void handle_modifiers(struct wl_listener* listener, void* data){
 void wm_keyboard_init(struct wm_keyboard* keyboard, struct wm_seat* seat, struct wlr_input_device* input_device){
     keyboard->wm_seat = seat;
     keyboard->wlr_input_device = input_device;
+    memset(keyboard->bound_keys, 0, sizeof(keyboard->bound_keys));
 
     wm_keyboard_reconfigure(keyboard);
 
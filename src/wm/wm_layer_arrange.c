@@ -0,0 +1,212 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <wayland-server.h>
+#include <wlr/types/wlr_layer_shell_v1.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+
+#include "wm/wm_layer_arrange.h"
+#include "wm/wm_view_layer.h"
+#include "wm/wm_layout.h"
+#include "wm/wm_output.h"
+#include "wm/wm_server.h"
+#include "wm/wm_util.h"
+#include "wm/wm.h"
+
+#define ANCHOR_TOP ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP
+#define ANCHOR_BOTTOM ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM
+#define ANCHOR_LEFT ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT
+#define ANCHOR_RIGHT ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT
+
+static struct wm_view_layer* layer_view_from_content(struct wm_content* content){
+    if(!wm_content_is_view(content)) return NULL;
+
+    struct wm_view* view = wm_cast(wm_view, content);
+    if(!wm_view_is_layer(view)) return NULL;
+
+    return wm_cast(wm_view_layer, view);
+}
+
+static bool box_equal(struct wlr_box* a, struct wlr_box* b){
+    return a->x == b->x && a->y == b->y && a->width == b->width && a->height == b->height;
+}
+
+/* Shrink usable area by the exclusive zone of a surface anchored to one edge */
+static void apply_exclusive(struct wlr_box* usable_area, struct wlr_layer_surface_v1_state* state){
+    if(state->exclusive_zone <= 0) return;
+
+    struct {
+        uint32_t singular_anchor;
+        uint32_t anchor_triplet;
+        int* positive_axis;
+        int* negative_axis;
+        int margin;
+    } edges[] = {
+        { ANCHOR_TOP, ANCHOR_LEFT | ANCHOR_RIGHT | ANCHOR_TOP,
+            &usable_area->y, &usable_area->height, state->margin.top },
+        { ANCHOR_BOTTOM, ANCHOR_LEFT | ANCHOR_RIGHT | ANCHOR_BOTTOM,
+            NULL, &usable_area->height, state->margin.bottom },
+        { ANCHOR_LEFT, ANCHOR_LEFT | ANCHOR_TOP | ANCHOR_BOTTOM,
+            &usable_area->x, &usable_area->width, state->margin.left },
+        { ANCHOR_RIGHT, ANCHOR_RIGHT | ANCHOR_TOP | ANCHOR_BOTTOM,
+            NULL, &usable_area->width, state->margin.right },
+    };
+
+    for(size_t i=0; i<sizeof(edges) / sizeof(edges[0]); i++){
+        if((state->anchor == edges[i].singular_anchor || state->anchor == edges[i].anchor_triplet) &&
+                state->exclusive_zone + edges[i].margin > 0){
+            if(edges[i].positive_axis) *edges[i].positive_axis += state->exclusive_zone + edges[i].margin;
+            if(edges[i].negative_axis) *edges[i].negative_axis -= state->exclusive_zone + edges[i].margin;
+            break;
+        }
+    }
+}
+
+/* One axis of the layer shell placement rules - size 0 stretches between both anchors */
+static void place_axis(int* pos, int* size, int bounds_pos, int bounds_size,
+        bool anchor_start, bool anchor_end, int margin_start, int margin_end){
+    if(*size == 0){
+        *pos = bounds_pos + margin_start;
+        *size = bounds_size - margin_start - margin_end;
+    }else if(anchor_start && anchor_end){
+        *pos = bounds_pos + bounds_size / 2 - *size / 2;
+    }else if(anchor_start){
+        *pos = bounds_pos + margin_start;
+    }else if(anchor_end){
+        *pos = bounds_pos + bounds_size - *size - margin_end;
+    }else{
+        *pos = bounds_pos + bounds_size / 2 - *size / 2;
+    }
+}
+
+static void arrange_layer(struct wm_output* output, enum zwlr_layer_shell_v1_layer layer,
+        struct wlr_box* full_area, struct wlr_box* usable_area, bool exclusive){
+    struct wm_content* content;
+    wl_list_for_each(content, &output->wm_server->wm_contents, link){
+        struct wm_view_layer* view = layer_view_from_content(content);
+        if(!view) continue;
+
+        struct wlr_layer_surface_v1* surface = view->wlr_layer_surface;
+        if(surface->output != output->wlr_output || !surface->added) continue;
+
+        struct wlr_layer_surface_v1_state* state = &surface->current;
+        if(state->layer != layer) continue;
+        if(exclusive != (state->exclusive_zone > 0)) continue;
+
+        struct wlr_box bounds = state->exclusive_zone == -1 ? *full_area : *usable_area;
+        struct wlr_box box = {
+            .width = state->desired_width,
+            .height = state->desired_height
+        };
+
+        place_axis(&box.x, &box.width, bounds.x, bounds.width,
+                state->anchor & ANCHOR_LEFT, state->anchor & ANCHOR_RIGHT,
+                state->margin.left, state->margin.right);
+        place_axis(&box.y, &box.height, bounds.y, bounds.height,
+                state->anchor & ANCHOR_TOP, state->anchor & ANCHOR_BOTTOM,
+                state->margin.top, state->margin.bottom);
+
+        if(box.width <= 0 || box.height <= 0){
+            wlr_log(WLR_ERROR, "Layer surface %s: Invalid size %dx%d", surface->namespace, box.width, box.height);
+            continue;
+        }
+
+        /* Unmapped surfaces are configured, but do not reserve space */
+        if(surface->mapped) apply_exclusive(usable_area, state);
+
+        box.x += output->layout_x;
+        box.y += output->layout_y;
+        if(!view->arranged || !box_equal(&box, &view->arranged_box)){
+            view->arranged = true;
+            view->arranged_box = box;
+            view->update_pending = true;
+        }
+
+        if(box.width != view->configured_width || box.height != view->configured_height){
+            view->configured_width = box.width;
+            view->configured_height = box.height;
+            wlr_layer_surface_v1_configure(surface, box.width, box.height);
+        }
+    }
+}
+
+/* Pass changed arrangements on - once the usable area is known upstream */
+static void flush_updates(struct wm_server* server, bool notify){
+    struct wm_content* content, *tmp;
+    wl_list_for_each_safe(content, tmp, &server->wm_contents, link){
+        struct wm_view_layer* view = layer_view_from_content(content);
+        if(!view || !view->update_pending) continue;
+
+        view->update_pending = false;
+        if(notify) wm_callback_update_view(&view->super);
+    }
+}
+
+/*
+ * Public interface
+ */
+bool wm_layer_arrange_output(struct wm_output* output){
+    struct wlr_box full_area = { 0 };
+    wlr_output_effective_resolution(output->wlr_output, &full_area.width, &full_area.height);
+    struct wlr_box usable_area = full_area;
+
+    /* Exclusive surfaces first, top to bottom, then everything else within what remains */
+    enum zwlr_layer_shell_v1_layer layers[] = {
+        ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY,
+        ZWLR_LAYER_SHELL_V1_LAYER_TOP,
+        ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM,
+        ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND
+    };
+    for(int i=0; i<4; i++){
+        arrange_layer(output, layers[i], &full_area, &usable_area, true);
+    }
+    for(int i=0; i<4; i++){
+        arrange_layer(output, layers[i], &full_area, &usable_area, false);
+    }
+
+    if(box_equal(&usable_area, &output->usable_area)) return false;
+
+    wlr_log(WLR_DEBUG, "Output %d: Usable area %d, %d - %dx%d", output->key,
+            usable_area.x, usable_area.y, usable_area.width, usable_area.height);
+    output->usable_area = usable_area;
+    return true;
+}
+
+void wm_layer_arrange_layout(struct wm_layout* layout){
+    struct wm_output* output;
+    wl_list_for_each(output, &layout->wm_outputs, link){
+        wm_layer_arrange_output(output);
+    }
+
+    /* All views are updated following the layout change anyway */
+    flush_updates(layout->wm_server, false);
+}
+
+void wm_layer_arrange_view(struct wm_view_layer* view){
+    struct wm_layout* layout = view->super.super.wm_server->wm_layout;
+
+    struct wm_output* output;
+    wl_list_for_each(output, &layout->wm_outputs, link){
+        if(output->wlr_output != view->wlr_layer_surface->output) continue;
+
+        if(wm_layer_arrange_output(output)){
+            wm_callback_layout_change(layout);
+        }
+        break;
+    }
+
+    flush_updates(layout->wm_server, true);
+}
+
+void wm_layer_arrange_remove_output(struct wm_output* output){
+    struct wm_content* content, *tmp;
+    wl_list_for_each_safe(content, tmp, &output->wm_server->wm_contents, link){
+        struct wm_view_layer* view = layer_view_from_content(content);
+        if(!view || view->wlr_layer_surface->output != output->wlr_output) continue;
+
+        view->wlr_layer_surface->output = NULL;
+        wlr_layer_surface_v1_destroy(view->wlr_layer_surface);
+    }
+}
@@ -7,6 +7,8 @@
 #include "wm/wm_output.h"
 #include "wm/wm.h"
 #include "wm/wm_view.h"
+#include "wm/wm_composite.h"
+#include "wm/wm_layer_arrange.h"
 #include "wm/wm_server.h"
 #include "wm/wm_config.h"
 #include "wm/wm_util.h"
@@ -40,6 +42,13 @@ static void handle_change(struct wl_listener* listener, void* data){
         }
     }
 
+    /* Effective boxes of composites change with position and scale */
+    wm_compose_chains_invalidate(layout->wm_server);
+    wm_server_invalidate_visibility(layout->wm_server);
+
+    /* Usable areas are passed on with the layout */
+    wm_layer_arrange_layout(layout);
+
     wm_callback_layout_change(layout);
     wm_layout_damage_whole(layout);
 }
@@ -62,15 +71,26 @@ void wm_layout_destroy(struct wm_layout* layout) {
     wl_list_remove(&layout->change.link);
 }
 
-static void place(struct wm_layout* layout, struct wm_output* output){
+/* Returns false if the output did not need to be placed again */
+static bool place(struct wm_layout* layout, struct wm_output* output, bool force){
     struct wm_config_output* config = wm_config_find_output(layout->wm_server->wm_config, output->wlr_output->name);
-    if(!config || (config->pos_x < WM_CONFIG_POS_MIN || config->pos_y < WM_CONFIG_POS_MIN)){
+    bool automatic = !config || (config->pos_x < WM_CONFIG_POS_MIN || config->pos_y < WM_CONFIG_POS_MIN);
+    int x = automatic ? WM_CONFIG_POS_MIN - 1 : config->pos_x;
+    int y = automatic ? WM_CONFIG_POS_MIN - 1 : config->pos_y;
+
+    /* Re-adding emits a layout change even if nothing moves */
+    if(!force && x == output->placed_x && y == output->placed_y) return false;
+    output->placed_x = x;
+    output->placed_y = y;
+
+    if(automatic){
         wlr_log(WLR_INFO, "Layout: Placing automatically");
         wlr_output_layout_add_auto(layout->wlr_output_layout, output->wlr_output);
     }else{
         wlr_log(WLR_INFO, "Layout: Placing at %d / %d", config->pos_x, config->pos_y);
         wlr_output_layout_add(layout->wlr_output_layout, output->wlr_output, config->pos_x, config->pos_y);
     }
+    return true;
 }
 
 void wm_layout_add_output(struct wm_layout* layout, struct wlr_output* out){
@@ -78,23 +98,30 @@ void wm_layout_add_output(struct wm_layout* layout, struct wlr_output* out){
     wm_output_init(output, layout->wm_server, layout, out);
     wl_list_insert(&layout->wm_outputs, &output->link);
 
-    place(layout, output);
+    place(layout, output, true);
 }
 
 void wm_layout_remove_output(struct wm_layout* layout, struct wm_output* output){
     wlr_output_layout_remove(layout->wlr_output_layout, output->wlr_output);
 }
 
-void wm_layout_reconfigure(struct wm_layout* layout){
+bool wm_layout_reconfigure(struct wm_layout* layout){
+    bool changed = false;
     struct wm_output* output;
     wl_list_for_each(output, &layout->wm_outputs, link){
-        wm_output_reconfigure(output);
-        place(layout, output);
+        changed |= wm_output_reconfigure(output);
+        changed |= place(layout, output, false);
     }
+    return changed;
 }
 
 
 void wm_layout_damage_whole(struct wm_layout* layout){
+    struct wm_content* content;
+    wl_list_for_each(content, &layout->wm_server->wm_contents, link){
+        wm_content_invalidate_render_cache(content);
+    }
+
     struct wm_output* output;
     wl_list_for_each(output, &layout->wm_outputs, link){
         DEBUG_PERFORMANCE(damage, output->key);
@@ -110,6 +137,11 @@ void wm_layout_damage_whole(struct wm_layout* layout){
 
 
 void wm_layout_damage_from(struct wm_layout* layout, struct wm_content* content, struct wlr_surface* origin){
+    wm_content_invalidate_render_cache(content);
+    if(wm_content_is_composite(content)){
+        wm_compose_chains_invalidate(layout->wm_server);
+    }
+
     struct wm_output* output;
     wl_list_for_each(output, &layout->wm_outputs, link){
         if(!wm_content_is_on_output(content, output)) continue;
@@ -124,21 +156,85 @@ void wm_layout_damage_from(struct wm_layout* layout, struct wm_content* content,
     }
 }
 
+static struct wm_output_pending_damage* pending_damage_add(struct wm_output* output, double z_index, pixman_region32_t* damage){
+    struct wm_output_pending_damage* pending;
+    wl_list_for_each(pending, &output->pending_damage, link){
+        if(pending->z_index == z_index){
+            pixman_region32_union(&pending->damage, &pending->damage, damage);
+            return pending;
+        }
+        if(pending->z_index > z_index) break;
+    }
+
+    /* pending->link is the list head or the first entry with higher z-index */
+    struct wm_output_pending_damage* new_pending = calloc(1, sizeof(struct wm_output_pending_damage));
+    new_pending->z_index = z_index;
+    pixman_region32_init(&new_pending->damage);
+    pixman_region32_copy(&new_pending->damage, damage);
+    wl_list_insert(pending->link.prev, &new_pending->link);
+    return new_pending;
+}
+
 void wm_layout_damage_output(struct wm_layout* layout, struct wm_output* output, pixman_region32_t* damage, struct wm_content* from){
-    wlr_output_damage_add(output->wlr_output_damage, damage);
+    if(!pixman_region32_not_empty(damage)) return;
+
+    pending_damage_add(output, wm_content_get_z_index(from), damage);
+    wlr_output_schedule_frame(output->wlr_output);
+
+    if(layout->refresh_master_output != layout->refresh_scheduled){
+        layout->refresh_scheduled = output->key;
+    }
+}
+
+void wm_layout_flush_damage(struct wm_layout* layout, struct wm_output* output){
+    if(wl_list_empty(&output->pending_damage)) return;
+
+    wm_server_update_contents(layout->wm_server);
+
+    /*
+     * Single pass from bottom to top: every composite sees the union of all damage strictly below it,
+     * and the region it needs to redraw is in turn damage for the composites above
+     */
+    pixman_region32_t below;
+    pixman_region32_init(&below);
+
+    pixman_region32_t composite_damage;
+    pixman_region32_init(&composite_damage);
+
+    struct wl_list* at = output->pending_damage.next;
 
     struct wm_content* content;
-    wl_list_for_each(content, &layout->wm_server->wm_contents, link){
+    wl_list_for_each_reverse(content, &layout->wm_server->wm_contents, link){
         if(!wm_content_is_composite(content)) continue;
-        struct wm_composite* comp = wm_cast(wm_composite, content);
-        if(comp->super.z_index > from->z_index && &comp->super != from){
-            wm_composite_on_damage_below(comp, output, from, damage);
+        double z_index = wm_content_get_z_index(content);
+
+        for(; at != &output->pending_damage; at = at->next){
+            struct wm_output_pending_damage* pending = wl_container_of(at, pending, link);
+            if(pending->z_index >= z_index) break;
+            pixman_region32_union(&below, &below, &pending->damage);
+        }
+
+        pixman_region32_clear(&composite_damage);
+        wm_composite_on_damage_below(wm_cast(wm_composite, content), output, &below, &composite_damage);
+        if(pixman_region32_not_empty(&composite_damage)){
+            at = &pending_damage_add(output, z_index, &composite_damage)->link;
         }
     }
 
-    if(layout->refresh_master_output != layout->refresh_scheduled){
-        layout->refresh_scheduled = output->key;
+    pixman_region32_clear(&below);
+    struct wm_output_pending_damage* pending, *tmp;
+    wl_list_for_each_safe(pending, tmp, &output->pending_damage, link){
+        pixman_region32_union(&below, &below, &pending->damage);
+
+        wl_list_remove(&pending->link);
+        pixman_region32_fini(&pending->damage);
+        free(pending);
     }
+
+    wlr_output_damage_add(output->wlr_output_damage, &below);
+
+    pixman_region32_fini(&composite_damage);
+    pixman_region32_fini(&below);
 }
 
 void wm_layout_start_update(struct wm_layout* layout){
@@ -11,9 +11,14 @@
 #include "wm/wm_seat.h"
 #include "wm/wm_cursor.h"
 #include "wm/wm_composite.h"
+#include "wm/wm_layer_arrange.h"
+#include "wm/wm.h"
 #include <assert.h>
+#include <math.h>
+#include <stdint.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
 #include <wlr/types/wlr_matrix.h>
@@ -43,10 +48,105 @@ static void handle_present(struct wl_listener *listener, void *data) {
     struct wm_output *output = wl_container_of(listener, output, present);
 }
 
+/*
+ * Render governor
+ */
+struct governor_level {
+    int blur_passes_reduce;
+    int blur_passes_max;
+    bool corners_while_animating;
+    bool cheap_texture_shaders;
+};
+
+/* Blur passes correspond to the depth of downsample buffers used */
+static const struct governor_level governor_levels[WM_OUTPUT_GOVERNOR_LEVELS] = {
+    { 0, 4, true, false },
+    { 1, 4, true, false },
+    { 1, 2, true, false },
+    { 1, 2, false, false },
+    { 1, 1, false, true },
+};
+
+#define GOVERNOR_OVER_BUDGET 0.8
+#define GOVERNOR_UNDER_BUDGET 0.4
+#define GOVERNOR_OVER_FRAMES 3
+#define GOVERNOR_UNDER_FRAMES 60
+
+static void governor_set_level(struct wm_output* output, int level){
+    if(level == output->governor.level) return;
+
+    wlr_log(WLR_DEBUG, "Output %d: Render quality level %d (%.2fms)", output->key, level, output->governor.render_msec);
+    output->governor.level = level;
+    output->governor.n_over = 0;
+    output->governor.n_under = 0;
+
+    /* Effects change everywhere */
+    wlr_output_damage_add_whole(output->wlr_output_damage);
+    wm_callback_render_quality(output, level);
+}
+
+static void governor_update(struct wm_output* output, double render_msec){
+    struct wm_output_governor* governor = &output->governor;
+    if(!output->wm_server->wm_config->render_governor){
+        governor_set_level(output, 0);
+        return;
+    }
+    if(!output->wlr_output->current_mode || output->wlr_output->current_mode->refresh <= 0) return;
+
+    double budget = 1000000. / output->wlr_output->current_mode->refresh;
+    governor->render_msec = 0.8 * governor->render_msec + 0.2 * render_msec;
+
+    if(governor->render_msec > GOVERNOR_OVER_BUDGET * budget){
+        governor->n_under = 0;
+        if(++governor->n_over >= GOVERNOR_OVER_FRAMES && governor->level < WM_OUTPUT_GOVERNOR_LEVELS - 1){
+            governor_set_level(output, governor->level + 1);
+        }
+    }else if(governor->render_msec < GOVERNOR_UNDER_BUDGET * budget){
+        governor->n_over = 0;
+        if(++governor->n_under >= GOVERNOR_UNDER_FRAMES && governor->level > 0){
+            governor_set_level(output, governor->level - 1);
+        }
+    }else{
+        governor->n_over = 0;
+        governor->n_under = 0;
+    }
+}
+
+static const char* governor_texture_shaders(struct wm_output* output){
+    const char* configured = output->wm_server->wm_config->texture_shaders;
+
+    /* noeffect does not implement the lock shader */
+    if(governor_levels[output->governor.level].cheap_texture_shaders && strcmp(configured, "noeffect")){
+        return "basic";
+    }
+    return configured;
+}
+
+int wm_output_blur_passes(struct wm_output* output, int passes){
+    const struct governor_level* level = &governor_levels[output->governor.level];
+    passes -= level->blur_passes_reduce;
+    if(passes > level->blur_passes_max) passes = level->blur_passes_max;
+    return passes < 1 ? 1 : passes;
+}
+
+bool wm_output_renders_corners(struct wm_output* output){
+    return !output->governor.animating || governor_levels[output->governor.level].corners_while_animating;
+}
+
+
+/* Transparent contents and hidden views are skipped */
+static bool renders(struct wm_content* content){
+    if(wm_content_get_opacity(content) < 0.0001) return false;
+    if(wm_content_is_view(content) && !wm_view_is_visible(wm_cast(wm_view, content))) return false;
+    return true;
+}
 
 static void render(struct wm_output *output, struct timespec now, pixman_region32_t *damage) {
     struct wm_renderer *renderer = output->wm_server->wm_renderer;
 
+    /* Renderer is shared among outputs */
+    wm_renderer_select_texture_shaders(renderer, governor_texture_shaders(output));
+
     int width, height;
     wlr_output_transformed_resolution(output->wlr_output, &width, &height);
 
@@ -79,41 +179,60 @@ static void render(struct wm_output *output, struct timespec now, pixman_region3
     struct wm_compose_chain* last = chain;
     while(last->lower) last = last->lower;
 
-    if(needs_clear){
+    /* Only what composites read from or write to goes through the offscreen buffer */
+    pixman_region32_t direct, offscreen;
+    pixman_region32_init(&direct);
+    pixman_region32_init(&offscreen);
+    if(last != chain){
+        wm_compose_chain_offscreen(chain, &offscreen);
+    }
+    pixman_region32_subtract(&direct, damage, &offscreen);
+
+    /* Do render - directly */
+    if(pixman_region32_not_empty(&direct)){
         wm_renderer_to_buffer(renderer, 0);
-        wm_renderer_clear(renderer, damage, (float[]){ 0., 0., 0., 1.});
+        if(needs_clear){
+            wm_renderer_clear(renderer, &direct, (float[]){ 0., 0., 0., 1.});
+        }
 
-        if(last != chain){
-            wm_renderer_to_buffer(renderer, 1);
-            wm_renderer_clear(renderer, &last->damage, (float[]){ 0., 0., 0., 1.});
+        wl_list_for_each_reverse(r, &output->wm_server->wm_contents, link) {
+            if(!renders(r)) continue;
+            wm_content_render(r, output, &direct, now);
         }
     }
 
+    /* Do render - offscreen, then copy the damaged part over */
     if(last != chain){
+        for(struct wm_compose_chain* at=last; at; at=at->higher){
+            pixman_region32_intersect(&at->damage, &at->damage, &offscreen);
+        }
+
         wm_renderer_to_buffer(renderer, 1);
-    }
+        if(needs_clear){
+            wm_renderer_clear(renderer, &last->damage, (float[]){ 0., 0., 0., 1.});
+        }
 
-    /* Do render */
-    for(struct wm_compose_chain* at=last; at; at=at->higher){
-        wl_list_for_each_reverse(r, &output->wm_server->wm_contents, link) {
-            if(at->lower && wm_content_get_z_index(r) < at->lower->z_index) continue;
-            if(wm_content_get_z_index(r) > at->z_index) break;
+        for(struct wm_compose_chain* at=last; at; at=at->higher){
+            wl_list_for_each_reverse(r, &output->wm_server->wm_contents, link) {
+                if(at->lower && wm_content_get_z_index(r) < at->lower->z_index) continue;
+                if(wm_content_get_z_index(r) > at->z_index) break;
 
-            if(wm_content_get_opacity(r) < 0.0001) continue;
-            wm_content_render(r, output, &at->damage, now);
-        }
-        if(at->composite){
-            wm_composite_apply(at->composite, output, &at->composite_output, now);
+                if(!renders(r)) continue;
+                wm_content_render(r, output, &at->damage, now);
+            }
+            if(at->composite){
+                wm_composite_apply(at->composite, output, &at->box, &at->composite_output, now);
+            }
         }
-    }
 
-    if(last != chain){
-        wm_renderer_to_buffer(renderer, 1);
+        wm_renderer_present_buffer(renderer, &chain->damage);
     }
 
+    pixman_region32_fini(&direct);
+    pixman_region32_fini(&offscreen);
+
     /* End render */
-    wm_renderer_end(renderer, &chain->damage, output);
-    wm_compose_chain_free(chain);
+    wm_renderer_end(renderer, damage, output);
 
     /* Commit */
     pixman_region32_t frame_damage;
@@ -153,6 +272,13 @@ static void handle_damage_frame(struct wl_listener *listener, void *data) {
         wlr_log(WLR_DEBUG, "Output %d dropped frame (%.2fms)", output->key, diff);
     }
 
+    /* Resolve damage collected since the last frame, including composites */
+    wm_layout_flush_damage(output->wm_layout, output);
+
+    /* Before rendering, as python is notified of changes */
+    wm_server_update_contents(output->wm_server);
+    wm_server_update_visibility(output->wm_server);
+
     bool needs_frame;
     pixman_region32_t damage;
     pixman_region32_init(&damage);
@@ -166,12 +292,26 @@ static void handle_damage_frame(struct wl_listener *listener, void *data) {
 #endif
 
         if (needs_frame) {
+            bool corners = wm_output_renders_corners(output);
+            output->governor.animating = output->expecting_frame && output->wlr_output->current_mode &&
+                diff < 2. * 1000000./output->wlr_output->current_mode->refresh;
+            if(!corners && wm_output_renders_corners(output)){
+                /* Animation has settled - bring back corners skipped so far */
+                wlr_output_damage_add_whole(output->wlr_output_damage);
+            }
+
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+
             DEBUG_PERFORMANCE(render, output->key);
             TIMER_START(render);
             render(output, now, &damage);
             TIMER_STOP(render);
             TIMER_PRINT(render);
 
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            governor_update(output, (end.tv_sec - start.tv_sec) * 1000. + (end.tv_nsec - start.tv_nsec) / 1000000.);
+
             output->expecting_frame = true;
         } else {
             DEBUG_PERFORMANCE(skip_frame, output->key);
@@ -204,9 +344,72 @@ void wm_output_override_name(const char* name){
     wm_output_overridden_name = name;
 }
 
-static double configure(struct wm_output* output){
+static bool config_equal(struct wm_config_output* a, struct wm_config_output* b){
+    if(!a || !b) return a == b;
+    return a->width == b->width &&
+        a->height == b->height &&
+        a->mHz == b->mHz &&
+        a->scale == b->scale &&
+        a->transform == b->transform;
+}
+
+static double scale_for(struct wm_output* output, struct wm_config_output* config, int width){
+    double scale = config ? config->scale : -1.0;
+    if(scale >= 0.1) return scale;
+
+    double dpi = output->wlr_output->phys_width > 0 ? (double)width * 25.4 / output->wlr_output->phys_width : 0;
+    if(dpi > 182){
+        wlr_log(WLR_INFO, "Output: Assuming HiDPI scale");
+        return 2.;
+    }
+    return 1.;
+}
+
+/* Stage only what differs from the current state and test it - rolled back if rejected */
+static bool stage(struct wm_output* output, struct wlr_output_mode* mode, int width, int height, int mHz,
+        enum wl_output_transform transform, double scale){
+    struct wlr_output* wlr_output = output->wlr_output;
+
+    if(mode){
+        if(wlr_output->current_mode != mode){
+            wlr_log(WLR_INFO, "Output: Setting mode: %dx%d(%d)", mode->width, mode->height, mode->refresh);
+            wlr_output_set_mode(wlr_output, mode);
+        }
+    }else if(wlr_output->width != width || wlr_output->height != height || wlr_output->refresh != mHz){
+        wlr_log(WLR_INFO, "Output: Setting custom mode - %dx%d(%d)", width, height, mHz);
+        wlr_output_set_custom_mode(wlr_output, width, height, mHz);
+    }
+
+    if(wlr_output->transform != transform){
+        wlr_output_set_transform(wlr_output, transform);
+    }
+    if(wlr_output->scale != scale){
+        wlr_log(WLR_INFO, "Output: Setting scale to %f", scale);
+        wlr_output_set_scale(wlr_output, scale);
+    }
+    if(!wlr_output->enabled){
+        wlr_output_enable(wlr_output, true);
+    }
+
+    if(wlr_output_test(wlr_output)) return true;
+
+    wlr_log(WLR_INFO, "Output: Test commit failed");
+    wlr_output_rollback(wlr_output);
+    return false;
+}
+
+/* Returns false if the config was unchanged */
+static bool configure(struct wm_output* output){
     struct wm_config_output* config = wm_config_find_output(output->wm_layout->wm_server->wm_config, output->wlr_output->name);
-    double dpi = 0.;
+
+    /* Unrelated config changes must not touch the output */
+    if(output->configured && config_equal(config, output->configured_has_config ? &output->configured_config : NULL)){
+        wlr_log(WLR_DEBUG, "Output %s: Configuration unchanged", output->wlr_output->name);
+        return false;
+    }
+
+    enum wl_output_transform transform = config ? config->transform : WL_OUTPUT_TRANSFORM_NORMAL;
+    bool staged = false;
 
     /* Set mode */
     if (!wl_list_empty(&output->wlr_output->modes)) {
@@ -238,9 +441,16 @@ static double configure(struct wm_output* output){
         if (!best)
             best = pref;
 
-        dpi = output->wlr_output->phys_width > 0 ? (double)best->width * 25.4 / output->wlr_output->phys_width : 0;
-        wlr_log(WLR_INFO, "Output: Setting mode: %dx%d(%d)", best->width, best->height, best->refresh);
-        wlr_output_set_mode(output->wlr_output, best);
+        /* Fall back to the preferred mode, then to anything the backend accepts */
+        staged = stage(output, best, 0, 0, 0, transform, scale_for(output, config, best->width));
+        if(!staged && pref && pref != best){
+            staged = stage(output, pref, 0, 0, 0, transform, scale_for(output, config, pref->width));
+        }
+        wl_list_for_each(mode, &output->wlr_output->modes, link) {
+            if(staged) break;
+            if(mode == best || mode == pref) continue;
+            staged = stage(output, mode, 0, 0, 0, transform, scale_for(output, config, mode->width));
+        }
     }else{
         int w = config ? config->width : 0;
         int h = config ? config->height : 0;
@@ -253,35 +463,20 @@ static double configure(struct wm_output* output){
             wlr_log(WLR_INFO, "Output: Need to configure height for custom mode - defaulting to 1280");
             h = 1280;
         }
-        dpi = output->wlr_output->phys_width > 0 ? (double)w * 25.4 / output->wlr_output->phys_width : 0;
-        wlr_log(WLR_INFO, "Output: Setting custom mode - %dx%d(%d)", w, h, mHz);
-        wlr_output_set_custom_mode(output->wlr_output, w, h, mHz);
+        staged = stage(output, NULL, w, h, mHz, transform, scale_for(output, config, w));
     }
 
-
-    enum wl_output_transform transform = config ? config->transform : WL_OUTPUT_TRANSFORM_NORMAL;
-    wlr_output_set_transform(output->wlr_output, transform);
-
-    wlr_output_enable(output->wlr_output, true);
-    if (!wlr_output_commit(output->wlr_output)) {
+    if(!staged){
+        wlr_log(WLR_ERROR, "Output: No configuration passed the test commit");
+    }else if(output->wlr_output->pending.committed && !wlr_output_commit(output->wlr_output)){
         wlr_log(WLR_INFO, "Output: Could not commit");
     }
 
-    /* Set HiDPI scale */
-    double scale = config ? config->scale : -1.0;
-    if(scale < 0.1){
-        if(dpi > 182){
-            wlr_log(WLR_INFO, "Output: Assuming HiDPI scale");
-            scale = 2.;
-        }else{
-            scale = 1.;
-        }
-    }
-
-    wlr_log(WLR_INFO, "Output: Setting scale to %f", scale);
-    wlr_output_set_scale(output->wlr_output, scale);
+    output->configured = true;
+    output->configured_has_config = config != NULL;
+    if(config) output->configured_config = *config;
 
-    return scale;
+    return true;
 }
 
 void wm_output_init(struct wm_output *output, struct wm_server *server,
@@ -296,6 +491,8 @@ void wm_output_init(struct wm_output *output, struct wm_server *server,
     output->wlr_output = out;
     output->layout_x = 0;
     output->layout_y = 0;
+    wl_list_init(&output->pending_damage);
+    output->compose_chains = calloc(1, sizeof(struct wm_compose_chains));
 
     if (!wm_renderer_init_output(server->wm_renderer, output)) {
         wlr_log(WLR_ERROR, "Failed to init output render");
@@ -304,7 +501,9 @@ void wm_output_init(struct wm_output *output, struct wm_server *server,
 
     output->wlr_output_damage = wlr_output_damage_create(output->wlr_output);
 
-    double scale = configure(output);
+    output->configured = false;
+    configure(output);
+    double scale = output->wlr_output->scale;
 
     output->destroy.notify = handle_destroy;
     wl_signal_add(&output->wlr_output->events.destroy, &output->destroy);
@@ -328,6 +527,7 @@ void wm_output_init(struct wm_output *output, struct wm_server *server,
 
     /* Let the cursor know we possibly have a new scale */
     wm_cursor_ensure_loaded_for_scale(server->wm_seat->wm_cursor, scale);
+    wm_cursor_add_output(server->wm_seat->wm_cursor, output);
 
 #ifdef WM_CUSTOM_RENDERER
     output->renderer_buffers = NULL;
@@ -335,14 +535,44 @@ void wm_output_init(struct wm_output *output, struct wm_server *server,
 
     output->expecting_frame = false;
     clock_gettime(CLOCK_MONOTONIC, &output->last_frame);
+
+    output->usable_area = (struct wlr_box){ 0 };
+
+    output->governor.level = 0;
+    output->governor.render_msec = 0.;
+    output->governor.n_over = 0;
+    output->governor.n_under = 0;
+    output->governor.animating = false;
+}
+
+/* 24.8 logical pixels times 16.16 scale, rounded half up - avoids doubles flipping between neighbouring pixels */
+static int snap(double value, double scale){
+    int64_t v = llround(value * 256.);
+    int64_t s = llround(scale * 65536.);
+    int64_t p = v * s + (1LL << 23);
+
+    /* Floor division, also for negative positions */
+    return p >= 0 ? p >> 24 : -((-p + (1LL << 24) - 1) >> 24);
+}
+
+void wm_output_snap_box(struct wm_output* output, double x, double y, double width, double height, struct wlr_box* box){
+    double scale = output->wlr_output->scale;
+    box->x = snap(x, scale);
+    box->y = snap(y, scale);
+    box->width = snap(width, scale);
+    box->height = snap(height, scale);
 }
 
-void wm_output_reconfigure(struct wm_output* output){
-    double scale = configure(output);
-    wm_cursor_ensure_loaded_for_scale(output->wm_layout->wm_server->wm_seat->wm_cursor, scale);
+bool wm_output_reconfigure(struct wm_output* output){
+    if(!configure(output)) return false;
+
+    wm_cursor_ensure_loaded_for_scale(output->wm_layout->wm_server->wm_seat->wm_cursor, output->wlr_output->scale);
+    return true;
 }
 
 void wm_output_destroy(struct wm_output *output) {
+    wm_layer_arrange_remove_output(output);
+
     wl_list_remove(&output->destroy.link);
     wl_list_remove(&output->commit.link);
     wl_list_remove(&output->mode.link);
@@ -350,6 +580,16 @@ void wm_output_destroy(struct wm_output *output) {
     wl_list_remove(&output->link);
     wm_layout_remove_output(output->wm_layout, output);
 
+    struct wm_output_pending_damage* pending, *tmp;
+    wl_list_for_each_safe(pending, tmp, &output->pending_damage, link){
+        wl_list_remove(&pending->link);
+        pixman_region32_fini(&pending->damage);
+        free(pending);
+    }
+
+    wm_compose_chains_destroy(output->compose_chains);
+    free(output->compose_chains);
+
 #if WM_CUSTOM_RENDERER
     wm_renderer_buffers_destroy(output->renderer_buffers);
 #endif
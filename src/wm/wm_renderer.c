@@ -1,6 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <assert.h>
+#include <drm_fourcc.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,6 +14,7 @@
 #include "wm/wm_renderer.h"
 #include "wm/wm_server.h"
 #include "wm/wm_config.h"
+#include "wm/wm_atlas.h"
 
 #ifdef WM_CUSTOM_RENDERER
 
@@ -47,6 +49,137 @@ static const float flip_180[9] = {
     1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f,
 };
 
+/* Layout of wm_renderer::static_buffer */
+#define VERTS_OFFSET 0
+#define QUAD_VERTS_OFFSET (VERTS_OFFSET + sizeof(verts))
+#define QUAD_TEXCOORD_OFFSET (QUAD_VERTS_OFFSET + sizeof(quad_verts))
+#define STATIC_BUFFER_SIZE (QUAD_TEXCOORD_OFFSET + sizeof(quad_texcoord))
+
+#define STREAM_BUFFER_INITIAL_SIZE (64 * 1024)
+#define STREAM_ALIGNMENT 16
+
+static void init_vertex_buffers(struct wm_renderer* renderer){
+    glGenBuffers(1, &renderer->static_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->static_buffer);
+    glBufferData(GL_ARRAY_BUFFER, STATIC_BUFFER_SIZE, NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, VERTS_OFFSET, sizeof(verts), verts);
+    glBufferSubData(GL_ARRAY_BUFFER, QUAD_VERTS_OFFSET, sizeof(quad_verts), quad_verts);
+    glBufferSubData(GL_ARRAY_BUFFER, QUAD_TEXCOORD_OFFSET, sizeof(quad_texcoord), quad_texcoord);
+
+    renderer->stream_size = STREAM_BUFFER_INITIAL_SIZE;
+    renderer->stream_offset = renderer->stream_size;
+    glGenBuffers(1, &renderer->stream_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->stream_buffer);
+    glBufferData(GL_ARRAY_BUFFER, renderer->stream_size, NULL, GL_STREAM_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+ * Copy data into the stream buffer and return its offset - previous allocations may still be read
+ * by queued draws, so instead of waiting for them the buffer is orphaned once it is full
+ */
+static GLintptr stream_vertices(struct wm_renderer* renderer, const void* data, GLsizeiptr size){
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->stream_buffer);
+
+    if(renderer->stream_offset + size > renderer->stream_size){
+        while(size > renderer->stream_size) renderer->stream_size *= 2;
+        glBufferData(GL_ARRAY_BUFFER, renderer->stream_size, NULL, GL_STREAM_DRAW);
+        renderer->stream_offset = 0;
+    }
+
+    GLintptr offset = renderer->stream_offset;
+    void* mapped = NULL;
+    if(renderer->vertex_arrays){
+        mapped = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+    if(mapped){
+        memcpy(mapped, data, size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }else{
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+    }
+
+    renderer->stream_offset += (size + STREAM_ALIGNMENT - 1) / STREAM_ALIGNMENT * STREAM_ALIGNMENT;
+    return offset;
+}
+
+/* Point attrib to two floats per vertex at offset into the bound buffer */
+static void set_attrib(GLint attrib, GLintptr offset){
+    /* Unused attributes are optimised away by the compiler */
+    if(attrib < 0) return;
+
+    glVertexAttribPointer(attrib, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)offset);
+    glEnableVertexAttribArray(attrib);
+}
+
+static void init_vertex_array(struct wm_renderer* renderer, GLuint* vao, GLint pos_attrib, GLint tex_attrib,
+        GLintptr pos_offset){
+    *vao = 0;
+    if(!renderer->vertex_arrays) return;
+
+    glGenVertexArrays(1, vao);
+    glBindVertexArray(*vao);
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->static_buffer);
+    set_attrib(pos_attrib, pos_offset);
+    set_attrib(tex_attrib, QUAD_TEXCOORD_OFFSET);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void destroy_vertex_array(GLuint* vao){
+    if(*vao) glDeleteVertexArrays(1, vao);
+    *vao = 0;
+}
+
+/* Context needs to be current */
+static void destroy_vertex_buffers(struct wm_renderer* renderer){
+    destroy_vertex_array(&renderer->quad_shader.vao);
+    destroy_vertex_array(&renderer->downsample_shader.vao);
+    destroy_vertex_array(&renderer->upsample_shader.vao);
+
+    for(int i=0; i<renderer->n_texture_shaders; i++){
+        destroy_vertex_array(&renderer->texture_shaders[i].rgba.vao);
+        destroy_vertex_array(&renderer->texture_shaders[i].rgbx.vao);
+        destroy_vertex_array(&renderer->texture_shaders[i].ext.vao);
+    }
+    for(int i=0; i<renderer->n_primitive_shaders; i++){
+        destroy_vertex_array(&renderer->primitive_shaders[i].vao);
+        destroy_vertex_array(&renderer->primitive_shaders[i].instanced.vao);
+    }
+
+    glDeleteBuffers(1, &renderer->static_buffer);
+    glDeleteBuffers(1, &renderer->stream_buffer);
+    renderer->static_buffer = 0;
+    renderer->stream_buffer = 0;
+}
+
+/* Quad at pos_offset with full texture coordinates */
+static void bind_vertex_array(struct wm_renderer* renderer, GLuint vao, GLint pos_attrib, GLint tex_attrib,
+        GLintptr pos_offset){
+    if(vao){
+        glBindVertexArray(vao);
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->static_buffer);
+    set_attrib(pos_attrib, pos_offset);
+    set_attrib(tex_attrib, QUAD_TEXCOORD_OFFSET);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* wlroots renders from client memory - which only works without a vertex array or buffer bound */
+static void unbind_vertex_array(GLuint vao, GLint pos_attrib, GLint tex_attrib){
+    if(vao){
+        glBindVertexArray(0);
+        return;
+    }
+
+    if(pos_attrib >= 0) glDisableVertexAttribArray(pos_attrib);
+    if(tex_attrib >= 0) glDisableVertexAttribArray(tex_attrib);
+}
+
 static GLuint compile_shader(struct wlr_gles2_renderer *renderer, GLuint type,
                              const GLchar *src) {
     push_gles2_debug(renderer);
@@ -149,6 +282,12 @@ static void wm_renderer_init_quad_shaders(struct wm_renderer* renderer){
     renderer->upsample_shader.padding_b = glGetUniformLocation(renderer->upsample_shader.shader, "padding_b");
     renderer->upsample_shader.cornerradius = glGetUniformLocation(renderer->upsample_shader.shader, "cornerradius");
 
+    init_vertex_array(renderer, &renderer->quad_shader.vao,
+            renderer->quad_shader.pos_attrib, renderer->quad_shader.tex_attrib, QUAD_VERTS_OFFSET);
+    init_vertex_array(renderer, &renderer->downsample_shader.vao,
+            renderer->downsample_shader.pos_attrib, renderer->downsample_shader.tex_attrib, QUAD_VERTS_OFFSET);
+    init_vertex_array(renderer, &renderer->upsample_shader.vao,
+            renderer->upsample_shader.pos_attrib, renderer->upsample_shader.tex_attrib, QUAD_VERTS_OFFSET);
 }
 
 static void wm_renderer_link_texture_shader(struct wm_renderer *renderer,
@@ -176,6 +315,8 @@ static void wm_renderer_link_texture_shader(struct wm_renderer *renderer,
 
     shader->pos_attrib = glGetAttribLocation(shader->shader, "pos");
     shader->tex_attrib = glGetAttribLocation(shader->shader, "texcoord");
+
+    init_vertex_array(renderer, &shader->vao, shader->pos_attrib, shader->tex_attrib, VERTS_OFFSET);
 }
 
 void wm_renderer_init_texture_shaders(struct wm_renderer* renderer, int n_shaders){
@@ -220,7 +361,10 @@ void wm_renderer_init_primitive_shaders(struct wm_renderer* renderer, int n_shad
 
 void wm_renderer_add_primitive_shader(struct wm_renderer *renderer,
                                       const char *name, const GLchar *vert_src,
-                                      const GLchar *frag_src, int n_params_int, int n_params_float) {
+                                      const GLchar *frag_src,
+                                      const GLchar *vert_src_instanced,
+                                      const GLchar *frag_src_instanced,
+                                      int n_params_int, int n_params_float) {
 
     int i = 0;
     for (; i < renderer->n_primitive_shaders; i++) {
@@ -252,6 +396,47 @@ void wm_renderer_add_primitive_shader(struct wm_renderer *renderer,
         renderer->primitive_shaders[i].params_int = glGetUniformLocation(renderer->primitive_shaders[i].shader, "params_int");
     }
 
+    init_vertex_array(renderer, &renderer->primitive_shaders[i].vao,
+            renderer->primitive_shaders[i].pos_attrib, renderer->primitive_shaders[i].tex_attrib, VERTS_OFFSET);
+
+    if(!renderer->primitive_instancing || !vert_src_instanced || !frag_src_instanced) return;
+
+    struct wm_renderer_primitive_shader* shader = &renderer->primitive_shaders[i];
+    shader->instanced.shader = wm_renderer_link_program(renderer, vert_src_instanced, frag_src_instanced);
+    if(!shader->instanced.shader){
+        wlr_log(WLR_INFO, "Could not link instanced variant of shader %s - falling back", name);
+        return;
+    }
+
+    shader->instanced.proj = glGetUniformLocation(shader->instanced.shader, "proj");
+    shader->instanced.pos_attrib = glGetAttribLocation(shader->instanced.shader, "pos");
+    shader->instanced.tex_attrib = glGetAttribLocation(shader->instanced.shader, "texcoord");
+    shader->instanced.box_attrib = glGetAttribLocation(shader->instanced.shader, "inst_box");
+    shader->instanced.misc_attrib = glGetAttribLocation(shader->instanced.shader, "inst_misc");
+    shader->instanced.params_float_attrib[0] = glGetAttribLocation(shader->instanced.shader, "inst_params_float0");
+    shader->instanced.params_float_attrib[1] = glGetAttribLocation(shader->instanced.shader, "inst_params_float1");
+    shader->instanced.params_int_attrib = glGetAttribLocation(shader->instanced.shader, "inst_params_int");
+    shader->instanced.clip_attrib = glGetAttribLocation(shader->instanced.shader, "inst_clip");
+
+    /* Instance attributes are pointed into the stream buffer per batch - only their divisors are recorded */
+    init_vertex_array(renderer, &shader->instanced.vao,
+            shader->instanced.pos_attrib, shader->instanced.tex_attrib, VERTS_OFFSET);
+
+    GLint instance_attribs[] = {
+        shader->instanced.box_attrib,
+        shader->instanced.misc_attrib,
+        shader->instanced.params_float_attrib[0],
+        shader->instanced.params_float_attrib[1],
+        shader->instanced.params_int_attrib,
+        shader->instanced.clip_attrib,
+    };
+    glBindVertexArray(shader->instanced.vao);
+    for(size_t j=0; j<sizeof(instance_attribs) / sizeof(GLint); j++){
+        if(instance_attribs[j] < 0) continue;
+        glVertexAttribDivisor(instance_attribs[j], 1);
+        glEnableVertexAttribArray(instance_attribs[j]);
+    }
+    glBindVertexArray(0);
 }
 
 #endif
@@ -394,17 +579,14 @@ static bool render_subtexture_with_matrix(
         x1, y2, // bottom left
     };
 
-    glVertexAttribPointer(shader->pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, verts);
-    glVertexAttribPointer(shader->tex_attrib, 2, GL_FLOAT, GL_FALSE, 0,
-                          texcoord);
-
-    glEnableVertexAttribArray(shader->pos_attrib);
-    glEnableVertexAttribArray(shader->tex_attrib);
+    bind_vertex_array(renderer, shader->vao, shader->pos_attrib, shader->tex_attrib, VERTS_OFFSET);
+    GLintptr texcoord_offset = stream_vertices(renderer, texcoord, sizeof(texcoord));
+    set_attrib(shader->tex_attrib, texcoord_offset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-    glDisableVertexAttribArray(shader->pos_attrib);
-    glDisableVertexAttribArray(shader->tex_attrib);
+    unbind_vertex_array(shader->vao, shader->pos_attrib, shader->tex_attrib);
 
     glBindTexture(texture->target, 0);
 
@@ -445,19 +627,135 @@ static void render_primitive_with_matrix(
         glUniform1fv(renderer->primitive_shader_selected->params_float, renderer->primitive_shader_selected->n_params_float, params_float);
     }
 
-    glVertexAttribPointer(renderer->primitive_shader_selected->pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, verts);
-    glVertexAttribPointer(renderer->primitive_shader_selected->tex_attrib, 2, GL_FLOAT, GL_FALSE, 0, quad_texcoord);
-    glEnableVertexAttribArray(renderer->primitive_shader_selected->pos_attrib);
-    glEnableVertexAttribArray(renderer->primitive_shader_selected->tex_attrib);
+    struct wm_renderer_primitive_shader* shader = renderer->primitive_shader_selected;
+    bind_vertex_array(renderer, shader->vao, shader->pos_attrib, shader->tex_attrib, VERTS_OFFSET);
 
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-    glDisableVertexAttribArray(renderer->primitive_shader_selected->pos_attrib);
-    glDisableVertexAttribArray(renderer->primitive_shader_selected->tex_attrib);
+    unbind_vertex_array(shader->vao, shader->pos_attrib, shader->tex_attrib);
 
     pop_gles2_debug(gles2_renderer);
 }
 
+static void wm_renderer_flush_primitives(struct wm_renderer* renderer){
+    struct wm_renderer_primitive_batch* batch = &renderer->primitive_batch;
+    if(!batch->n_instances) return;
+
+    struct wm_renderer_primitive_shader* shader = batch->shader;
+    struct wlr_gles2_renderer *gles2_renderer =
+        gles2_get_renderer(renderer->wlr_renderer);
+
+    /* Per-instance translation and scale is done in the vertex shader */
+    float gl_matrix[9];
+    wlr_matrix_multiply(gl_matrix, gles2_renderer->projection, renderer->current->wlr_output->transform_matrix);
+    wlr_matrix_multiply(gl_matrix, flip_180, gl_matrix);
+    wlr_matrix_transpose(gl_matrix, gl_matrix);
+
+    push_gles2_debug(gles2_renderer);
+
+    glEnable(GL_BLEND);
+
+    glUseProgram(shader->instanced.shader);
+    glUniformMatrix3fv(shader->instanced.proj, 1, GL_FALSE, gl_matrix);
+
+    /* Instancing implies GLES 3 and thereby a vertex array */
+    glBindVertexArray(shader->instanced.vao);
+
+    GLintptr offset = stream_vertices(renderer, batch->data,
+            batch->n_instances * WM_RENDERER_PRIMITIVE_INSTANCE_SIZE * sizeof(GLfloat));
+
+    GLint instance_attribs[] = {
+        shader->instanced.box_attrib,
+        shader->instanced.misc_attrib,
+        shader->instanced.params_float_attrib[0],
+        shader->instanced.params_float_attrib[1],
+        shader->instanced.params_int_attrib,
+        shader->instanced.clip_attrib,
+    };
+    int n_instance_attribs = sizeof(instance_attribs) / sizeof(GLint);
+
+    for(int i=0; i<n_instance_attribs; i++){
+        /* Unused parameters are optimised away by the compiler */
+        if(instance_attribs[i] < 0) continue;
+
+        glVertexAttribPointer(instance_attribs[i], 4, GL_FLOAT, GL_FALSE,
+                WM_RENDERER_PRIMITIVE_INSTANCE_SIZE * sizeof(GLfloat),
+                (const GLvoid*)(offset + 4 * i * sizeof(GLfloat)));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    int ow, oh;
+    wlr_output_transformed_resolution(renderer->current->wlr_output, &ow, &oh);
+
+    enum wl_output_transform transform =
+        wlr_output_transform_invert(renderer->current->wlr_output->transform);
+
+    /* Instances clip themselves - one draw within the extents of all of them */
+    pixman_box32_t* extents = pixman_region32_extents(&batch->damage);
+    struct wlr_box damage_box = {.x = extents->x1,
+                                 .y = extents->y1,
+                                 .width = extents->x2 - extents->x1,
+                                 .height = extents->y2 - extents->y1};
+
+    wlr_box_transform(&damage_box, &damage_box, transform, ow, oh);
+    wlr_renderer_scissor(renderer->wlr_renderer, &damage_box);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, batch->n_instances);
+
+    glBindVertexArray(0);
+
+    pop_gles2_debug(gles2_renderer);
+
+    batch->n_instances = 0;
+    batch->shader = NULL;
+    pixman_region32_clear(&batch->damage);
+}
+
+static void wm_renderer_queue_primitive(struct wm_renderer* renderer,
+        pixman_region32_t* damage, struct wlr_box* box, double opacity,
+        int* params_int, float* params_float){
+    struct wm_renderer_primitive_batch* batch = &renderer->primitive_batch;
+    struct wm_renderer_primitive_shader* shader = renderer->primitive_shader_selected;
+
+    pixman_region32_t clip;
+    pixman_region32_init_rect(&clip, box->x, box->y, box->width, box->height);
+    pixman_region32_intersect(&clip, &clip, damage);
+
+    if(batch->shader != shader){
+        wm_renderer_flush_primitives(renderer);
+        batch->shader = shader;
+    }
+
+    /* One instance per rectangle of damage - usually just one */
+    int nrects;
+    pixman_box32_t* rects = pixman_region32_rectangles(&clip, &nrects);
+    for(int r=0; r<nrects; r++){
+        if(batch->n_instances == batch->capacity){
+            batch->capacity = batch->capacity ? 2 * batch->capacity : 64;
+            batch->data = realloc(batch->data, batch->capacity * WM_RENDERER_PRIMITIVE_INSTANCE_SIZE * sizeof(GLfloat));
+        }
+
+        GLfloat* instance = batch->data + batch->n_instances * WM_RENDERER_PRIMITIVE_INSTANCE_SIZE;
+        memset(instance, 0, WM_RENDERER_PRIMITIVE_INSTANCE_SIZE * sizeof(GLfloat));
+
+        instance[0] = box->x;
+        instance[1] = box->y;
+        instance[2] = box->width;
+        instance[3] = box->height;
+        instance[4] = opacity;
+        for(int i=0; i<shader->n_params_float; i++) instance[8 + i] = params_float[i];
+        for(int i=0; i<shader->n_params_int; i++) instance[16 + i] = params_int[i];
+        instance[20] = rects[r].x1;
+        instance[21] = rects[r].y1;
+        instance[22] = rects[r].x2;
+        instance[23] = rects[r].y2;
+
+        batch->n_instances++;
+    }
+
+    pixman_region32_union(&batch->damage, &batch->damage, &clip);
+    pixman_region32_fini(&clip);
+}
+
 #endif
 
 
@@ -472,17 +770,44 @@ void wm_renderer_init(struct wm_renderer *renderer, struct wm_server *server) {
     renderer->current = NULL;
     renderer->mode = wm_config_get_renderer_mode(server->wm_config);
 
+    renderer->wm_atlas = calloc(1, sizeof(struct wm_atlas));
+    wm_atlas_init(renderer->wm_atlas, renderer);
+
 #ifdef WM_CUSTOM_RENDERER
 
     renderer->n_primitive_shaders = 0;
     renderer->n_texture_shaders = 0;
     renderer->texture_shaders_selected = NULL;
     renderer->primitive_shader_selected = NULL;
+    renderer->primitive_instancing = false;
+    renderer->vertex_arrays = false;
+    renderer->framebuffer_blits = false;
+    renderer->static_buffer = 0;
+    renderer->stream_buffer = 0;
+
+    renderer->primitive_batch.shader = NULL;
+    renderer->primitive_batch.n_instances = 0;
+    renderer->primitive_batch.capacity = 0;
+    renderer->primitive_batch.data = NULL;
+    pixman_region32_init(&renderer->primitive_batch.damage);
 
     if(wlr_renderer_is_gles2(renderer->wlr_renderer)){
 
         struct wlr_gles2_renderer *gles2_renderer = gles2_get_renderer(renderer->wlr_renderer);
         assert(wlr_egl_make_current(gles2_renderer->egl));
+
+        /* Instanced draws need GLES 3 (GL_MAJOR_VERSION is unknown to GLES 2) */
+        GLint major = 2;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        while(glGetError() != GL_NO_ERROR);
+        renderer->primitive_instancing = major >= 3;
+        renderer->vertex_arrays = major >= 3;
+        renderer->framebuffer_blits = major >= 3;
+        wlr_log(WLR_DEBUG, "Instanced primitive rendering %s", renderer->primitive_instancing ? "enabled" : "disabled");
+
+        /* Before any shader, as their vertex arrays refer to it */
+        init_vertex_buffers(renderer);
+
         wm_texture_shaders_init(renderer);
         wm_primitive_shaders_init(renderer);
         wm_renderer_init_quad_shaders(renderer);
@@ -507,6 +832,8 @@ void wm_renderer_buffers_init(struct wm_renderer_buffers* buffers, struct wm_ren
     buffers->width = width;
     buffers->height = height;
     buffers->parent = renderer;
+    buffers->cache_buffer = 0;
+    buffers->cache_buffer_tex = 0;
     wlr_log(WLR_DEBUG, "Initialising renderer buffers for output: %dx%d", width, height);
 
     struct wlr_gles2_renderer *gles2_renderer = gles2_get_renderer(renderer->wlr_renderer);
@@ -579,6 +906,11 @@ void wm_renderer_buffers_destroy(struct wm_renderer_buffers* buffers){
         glDeleteTextures(1, &buffers->downsample_buffers_tex[i]);
     }
 
+    if(buffers->cache_buffer){
+        glDeleteFramebuffers(1, &buffers->cache_buffer);
+        glDeleteTextures(1, &buffers->cache_buffer_tex);
+    }
+
     wlr_egl_unset_current(r->egl);
 }
 
@@ -603,6 +935,22 @@ int wm_renderer_init_output(struct wm_renderer* renderer, struct wm_output* outp
 }
 
 void wm_renderer_destroy(struct wm_renderer *renderer) {
+    wm_atlas_destroy(renderer->wm_atlas);
+    free(renderer->wm_atlas);
+
+#ifdef WM_CUSTOM_RENDERER
+    pixman_region32_fini(&renderer->primitive_batch.damage);
+    free(renderer->primitive_batch.data);
+
+    /* Before the context goes away with the wlr_renderer */
+    if(renderer->static_buffer){
+        struct wlr_gles2_renderer *gles2_renderer = gles2_get_renderer(renderer->wlr_renderer);
+        assert(wlr_egl_make_current(gles2_renderer->egl));
+        destroy_vertex_buffers(renderer);
+        wlr_egl_unset_current(gles2_renderer->egl);
+    }
+#endif
+
     wlr_renderer_destroy(renderer->wlr_renderer);
 }
 
@@ -613,6 +961,7 @@ static void wm_renderer_scissor(struct wm_renderer* renderer, struct wlr_box* bo
 void wm_renderer_to_buffer(struct wm_renderer* renderer, unsigned int buffer){
 #ifdef WM_CUSTOM_RENDERER
     if(renderer->mode == WM_RENDERER_PYWM){
+        wm_renderer_flush_primitives(renderer);
         if(buffer == 0){
             struct wlr_gles2_renderer *gles2_renderer = gles2_get_renderer(renderer->wlr_renderer);
             glBindFramebuffer(GL_FRAMEBUFFER, gles2_renderer->current_buffer->fbo);
@@ -632,6 +981,9 @@ void wm_renderer_begin(struct wm_renderer *renderer, struct wm_output *output) {
         wm_renderer_buffers_ensure(renderer, output);
         struct wlr_gles2_renderer *gles2_renderer = gles2_get_renderer(renderer->wlr_renderer);
         assert(wlr_egl_make_current(gles2_renderer->egl));
+
+        /* Orphan the stream buffer on the first allocation of this frame */
+        renderer->stream_offset = renderer->stream_size;
     }
 #endif
 
@@ -644,22 +996,7 @@ void wm_renderer_begin(struct wm_renderer *renderer, struct wm_output *output) {
 
 #ifdef WM_CUSTOM_RENDERER
 static void blit_framebuffer(struct wm_renderer* renderer, pixman_region32_t* damage){
-    glUseProgram(renderer->quad_shader.shader);
-    glDisable(GL_BLEND);
-
-    wm_renderer_to_buffer(renderer, 0);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, renderer->current->renderer_buffers->frame_buffer_tex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glUniform1i(renderer->quad_shader.tex, 0);
-
-    glVertexAttribPointer(renderer->quad_shader.pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, quad_verts);
-    glVertexAttribPointer(renderer->quad_shader.tex_attrib, 2, GL_FLOAT, GL_FALSE, 0, quad_texcoord);
-
-    glEnableVertexAttribArray(renderer->quad_shader.pos_attrib);
-    glEnableVertexAttribArray(renderer->quad_shader.tex_attrib);
+    wm_renderer_flush_primitives(renderer);
 
     int ow, oh;
     wlr_output_transformed_resolution(renderer->current->wlr_output, &ow, &oh);
@@ -667,10 +1004,14 @@ static void blit_framebuffer(struct wm_renderer* renderer, pixman_region32_t* da
     enum wl_output_transform transform =
         wlr_output_transform_invert(renderer->current->wlr_output->transform);
 
-    if(!damage){
-        wlr_renderer_scissor(renderer->wlr_renderer, NULL);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    }else{
+    if(renderer->framebuffer_blits){
+        /* Both buffers are the size of the output - the scissor limits the copy */
+        int width = renderer->current->renderer_buffers->width;
+        int height = renderer->current->renderer_buffers->height;
+
+        wm_renderer_to_buffer(renderer, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, renderer->current->renderer_buffers->frame_buffer);
+
         int nrects;
         pixman_box32_t *rects = pixman_region32_rectangles(damage, &nrects);
         for (int i = 0; i < nrects; i++) {
@@ -679,15 +1020,45 @@ static void blit_framebuffer(struct wm_renderer* renderer, pixman_region32_t* da
                                          .width = rects[i].x2 - rects[i].x1,
                                          .height = rects[i].y2 - rects[i].y1};
 
-
             wlr_box_transform(&damage_box, &damage_box, transform, ow, oh);
             wlr_renderer_scissor(renderer->wlr_renderer, &damage_box);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
         }
+
+        /* Back to the output for reading as well */
+        wm_renderer_to_buffer(renderer, 0);
+        return;
     }
 
-    glDisableVertexAttribArray(renderer->quad_shader.pos_attrib);
-    glDisableVertexAttribArray(renderer->quad_shader.tex_attrib);
+    glUseProgram(renderer->quad_shader.shader);
+    glDisable(GL_BLEND);
+
+    wm_renderer_to_buffer(renderer, 0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, renderer->current->renderer_buffers->frame_buffer_tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glUniform1i(renderer->quad_shader.tex, 0);
+
+    bind_vertex_array(renderer, renderer->quad_shader.vao,
+            renderer->quad_shader.pos_attrib, renderer->quad_shader.tex_attrib, QUAD_VERTS_OFFSET);
+
+    int nrects;
+    pixman_box32_t *rects = pixman_region32_rectangles(damage, &nrects);
+    for (int i = 0; i < nrects; i++) {
+        struct wlr_box damage_box = {.x = rects[i].x1,
+                                     .y = rects[i].y1,
+                                     .width = rects[i].x2 - rects[i].x1,
+                                     .height = rects[i].y2 - rects[i].y1};
+
+
+        wlr_box_transform(&damage_box, &damage_box, transform, ow, oh);
+        wlr_renderer_scissor(renderer->wlr_renderer, &damage_box);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    unbind_vertex_array(renderer->quad_shader.vao, renderer->quad_shader.pos_attrib, renderer->quad_shader.tex_attrib);
 
     glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -695,14 +1066,20 @@ static void blit_framebuffer(struct wm_renderer* renderer, pixman_region32_t* da
 
 #endif
 
-void wm_renderer_end(struct wm_renderer *renderer, pixman_region32_t *damage,
-                     struct wm_output *output) {
-
+void wm_renderer_present_buffer(struct wm_renderer* renderer, pixman_region32_t* damage){
 #ifdef WM_CUSTOM_RENDERER
     if(renderer->mode == WM_RENDERER_PYWM && renderer->selected_buffer == 1){
         blit_framebuffer(renderer, damage);
     }
 #endif
+}
+
+void wm_renderer_end(struct wm_renderer *renderer, pixman_region32_t *damage,
+                     struct wm_output *output) {
+
+#ifdef WM_CUSTOM_RENDERER
+    wm_renderer_flush_primitives(renderer);
+#endif
 
     wlr_renderer_scissor(renderer->wlr_renderer, NULL);
     wlr_output_render_software_cursors(output->wlr_output, damage);
@@ -719,16 +1096,6 @@ void wm_renderer_render_texture_at(struct wm_renderer *renderer,
                                    struct wlr_box *mask, double corner_radius,
                                    double lock_perc) {
 
-    int ow, oh;
-    wlr_output_transformed_resolution(renderer->current->wlr_output, &ow, &oh);
-
-    enum wl_output_transform transform =
-        wlr_output_transform_invert(renderer->current->wlr_output->transform);
-
-    float matrix[9];
-    wlr_matrix_project_box(matrix, box, WL_OUTPUT_TRANSFORM_NORMAL, 0,
-                           renderer->current->wlr_output->transform_matrix);
-
     struct wlr_fbox fbox;
     if(surface){
         wlr_surface_get_buffer_source_box(surface, &fbox);
@@ -739,6 +1106,32 @@ void wm_renderer_render_texture_at(struct wm_renderer *renderer,
         fbox.height = texture->height;
     }
 
+    wm_renderer_render_subtexture_at(renderer, damage, texture, &fbox, box,
+                                     opacity, mask, corner_radius, lock_perc);
+}
+
+void wm_renderer_render_subtexture_at(struct wm_renderer *renderer,
+                                      pixman_region32_t *damage,
+                                      struct wlr_texture *texture,
+                                      const struct wlr_fbox *source,
+                                      struct wlr_box *box, double opacity,
+                                      struct wlr_box *mask,
+                                      double corner_radius, double lock_perc) {
+
+#ifdef WM_CUSTOM_RENDERER
+    wm_renderer_flush_primitives(renderer);
+#endif
+
+    int ow, oh;
+    wlr_output_transformed_resolution(renderer->current->wlr_output, &ow, &oh);
+
+    enum wl_output_transform transform =
+        wlr_output_transform_invert(renderer->current->wlr_output->transform);
+
+    float matrix[9];
+    wlr_matrix_project_box(matrix, box, WL_OUTPUT_TRANSFORM_NORMAL, 0,
+                           renderer->current->wlr_output->transform_matrix);
+
     int nrects;
     pixman_box32_t *rects = pixman_region32_rectangles(damage, &nrects);
     for (int i = 0; i < nrects; i++) {
@@ -757,7 +1150,7 @@ void wm_renderer_render_texture_at(struct wm_renderer *renderer,
 #ifdef WM_CUSTOM_RENDERER
         if(renderer->mode != WM_RENDERER_WLR){
             render_subtexture_with_matrix(
-                renderer, texture, &fbox, matrix, opacity, box, mask->x - box->x,
+                renderer, texture, source, matrix, opacity, box, mask->x - box->x,
                 mask->y - box->y, box->x + box->width - mask->x - mask->width,
                 box->y + box->height - mask->y - mask->height, corner_radius,
                 lock_perc);
@@ -766,7 +1159,7 @@ void wm_renderer_render_texture_at(struct wm_renderer *renderer,
 
         if(renderer->mode == WM_RENDERER_WLR){
             wlr_render_subtexture_with_matrix(renderer->wlr_renderer, texture,
-                                              &fbox, matrix, opacity);
+                                              source, matrix, opacity);
         }
 
     }
@@ -777,6 +1170,14 @@ void wm_renderer_render_primitive(struct wm_renderer* renderer,
                                   struct wlr_box* box,
                                   double opacity, int* params_int, float* params_float){
 
+#ifdef WM_CUSTOM_RENDERER
+    if(renderer->mode != WM_RENDERER_WLR && renderer->primitive_shader_selected->instanced.shader){
+        wm_renderer_queue_primitive(renderer, damage, box, opacity, params_int, params_float);
+        return;
+    }
+    wm_renderer_flush_primitives(renderer);
+#endif
+
     int ow, oh;
     wlr_output_transformed_resolution(renderer->current->wlr_output, &ow, &oh);
 
@@ -827,6 +1228,8 @@ void wm_renderer_apply_blur(struct wm_renderer* renderer, pixman_region32_t* dam
     if(renderer->mode != WM_RENDERER_PYWM) return;
 
 #ifdef WM_CUSTOM_RENDERER
+    wm_renderer_flush_primitives(renderer);
+
     if(passes > WM_RENDERER_DOWNSAMPLE_BUFFERS) passes = WM_RENDERER_DOWNSAMPLE_BUFFERS;
 
     struct wlr_gles2_renderer *gles2_renderer = gles2_get_renderer(renderer->wlr_renderer);
@@ -879,11 +1282,8 @@ void wm_renderer_apply_blur(struct wm_renderer* renderer, pixman_region32_t* dam
         glUseProgram(renderer->downsample_shader.shader);
         glDisable(GL_BLEND);
 
-        glVertexAttribPointer(renderer->downsample_shader.pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, quad_verts);
-        glVertexAttribPointer(renderer->downsample_shader.tex_attrib, 2, GL_FLOAT, GL_FALSE, 0, quad_texcoord);
-
-        glEnableVertexAttribArray(renderer->downsample_shader.pos_attrib);
-        glEnableVertexAttribArray(renderer->downsample_shader.tex_attrib);
+        bind_vertex_array(renderer, renderer->downsample_shader.vao,
+                renderer->downsample_shader.pos_attrib, renderer->downsample_shader.tex_attrib, QUAD_VERTS_OFFSET);
 
         for(int i=0; i<passes; i++){
             glViewport(0, 0, renderer->current->renderer_buffers->downsample_buffers_width[i], renderer->current->renderer_buffers->downsample_buffers_height[i]);
@@ -916,8 +1316,7 @@ void wm_renderer_apply_blur(struct wm_renderer* renderer, pixman_region32_t* dam
             glBindTexture(GL_TEXTURE_2D, 0);
         }
 
-        glDisableVertexAttribArray(renderer->downsample_shader.pos_attrib);
-        glDisableVertexAttribArray(renderer->downsample_shader.tex_attrib);
+        unbind_vertex_array(renderer->downsample_shader.vao, renderer->downsample_shader.pos_attrib, renderer->downsample_shader.tex_attrib);
     }
     /*
      * Upsample
@@ -943,11 +1342,8 @@ void wm_renderer_apply_blur(struct wm_renderer* renderer, pixman_region32_t* dam
         glUseProgram(renderer->upsample_shader.shader);
         glDisable(GL_BLEND);
 
-        glVertexAttribPointer(renderer->upsample_shader.pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, quad_verts);
-        glVertexAttribPointer(renderer->upsample_shader.tex_attrib, 2, GL_FLOAT, GL_FALSE, 0, quad_texcoord);
-
-        glEnableVertexAttribArray(renderer->upsample_shader.pos_attrib);
-        glEnableVertexAttribArray(renderer->upsample_shader.tex_attrib);
+        bind_vertex_array(renderer, renderer->upsample_shader.vao,
+                renderer->upsample_shader.pos_attrib, renderer->upsample_shader.tex_attrib, QUAD_VERTS_OFFSET);
 
 
         for(int i=passes-1; i>=0; i--){
@@ -1009,8 +1405,7 @@ void wm_renderer_apply_blur(struct wm_renderer* renderer, pixman_region32_t* dam
             glBindTexture(GL_TEXTURE_2D, 0);
         }
 
-        glDisableVertexAttribArray(renderer->upsample_shader.pos_attrib);
-        glDisableVertexAttribArray(renderer->upsample_shader.tex_attrib);
+        unbind_vertex_array(renderer->upsample_shader.vao, renderer->upsample_shader.pos_attrib, renderer->upsample_shader.tex_attrib);
     }
 
     wm_renderer_scissor(renderer, NULL);
@@ -1025,6 +1420,8 @@ void wm_renderer_apply_blur(struct wm_renderer* renderer, pixman_region32_t* dam
 void wm_renderer_clear(struct wm_renderer* renderer, pixman_region32_t* damage, float* color){
 #ifdef WM_CUSTOM_RENDERER
     if(renderer->mode != WM_RENDERER_WLR){
+        wm_renderer_flush_primitives(renderer);
+
         int ow, oh;
         wlr_output_transformed_resolution(renderer->current->wlr_output, &ow, &oh);
 
@@ -1080,6 +1477,324 @@ void wm_renderer_clear(struct wm_renderer* renderer, pixman_region32_t* damage,
     }
 }
 
+#ifdef WM_CUSTOM_RENDERER
+static void ensure_cache_buffer(struct wm_renderer_buffers* buffers){
+    if(buffers->cache_buffer) return;
+
+    glGenFramebuffers(1, &buffers->cache_buffer);
+    glGenTextures(1, &buffers->cache_buffer_tex);
+
+    glBindTexture(GL_TEXTURE_2D, buffers->cache_buffer_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, buffers->width, buffers->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, buffers->cache_buffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, buffers->cache_buffer_tex, 0);
+    assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+}
+
+/* Output coordinates to buffer coordinates (as passed to scissor) */
+static void cache_buffer_box(struct wm_renderer* renderer, struct wlr_box* box, struct wlr_box* result){
+    int ow, oh;
+    wlr_output_transformed_resolution(renderer->current->wlr_output, &ow, &oh);
+
+    enum wl_output_transform transform =
+        wlr_output_transform_invert(renderer->current->wlr_output->transform);
+    wlr_box_transform(result, box, transform, ow, oh);
+}
+
+/* Buffer coordinates to GL window coordinates, as in wlroots' scissor */
+static void cache_gl_box(struct wm_renderer* renderer, struct wlr_box* box, struct wlr_box* result){
+    wlr_box_transform(result, box, WL_OUTPUT_TRANSFORM_FLIPPED_180,
+            renderer->current->wlr_output->width, renderer->current->wlr_output->height);
+}
+#endif
+
+#ifdef WM_CUSTOM_RENDERER
+static void begin_cache_buffer(struct wm_renderer* renderer, struct wlr_box* box){
+    wm_renderer_flush_primitives(renderer);
+    ensure_cache_buffer(renderer->current->renderer_buffers);
+    glBindFramebuffer(GL_FRAMEBUFFER, renderer->current->renderer_buffers->cache_buffer);
+
+    struct wlr_box buffer_box;
+    cache_buffer_box(renderer, box, &buffer_box);
+    wm_renderer_scissor(renderer, &buffer_box);
+    glClearColor(0., 0., 0., 0.);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+#endif
+
+bool wm_renderer_cache_begin(struct wm_renderer* renderer, struct wm_renderer_cache* cache, struct wlr_box* box){
+#ifdef WM_CUSTOM_RENDERER
+    if(renderer->mode != WM_RENDERER_PYWM) return false;
+
+    begin_cache_buffer(renderer, box);
+
+    cache->output = renderer->current;
+    cache->box = *box;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void wm_renderer_cache_end(struct wm_renderer* renderer, struct wm_renderer_cache* cache){
+#ifdef WM_CUSTOM_RENDERER
+    wm_renderer_flush_primitives(renderer);
+
+    struct wlr_box buffer_box, gl_box;
+    cache_buffer_box(renderer, &cache->box, &buffer_box);
+    cache_gl_box(renderer, &buffer_box, &gl_box);
+
+    if(!cache->texture){
+        glGenTextures(1, &cache->texture);
+    }
+    glBindTexture(GL_TEXTURE_2D, cache->texture);
+    if(cache->texture_width != buffer_box.width || cache->texture_height != buffer_box.height){
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, buffer_box.width, buffer_box.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        cache->texture_width = buffer_box.width;
+        cache->texture_height = buffer_box.height;
+    }
+
+    /* Cache buffer is still bound for reading */
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gl_box.x, gl_box.y, gl_box.width, gl_box.height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    wm_renderer_to_buffer(renderer, renderer->selected_buffer);
+    cache->valid = true;
+#endif
+}
+
+void wm_renderer_render_cache(struct wm_renderer* renderer, pixman_region32_t* damage, struct wm_renderer_cache* cache){
+#ifdef WM_CUSTOM_RENDERER
+    wm_renderer_flush_primitives(renderer);
+
+    int ow, oh;
+    wlr_output_transformed_resolution(renderer->current->wlr_output, &ow, &oh);
+
+    enum wl_output_transform transform =
+        wlr_output_transform_invert(renderer->current->wlr_output->transform);
+
+    struct wlr_box buffer_box, gl_box;
+    wlr_box_transform(&buffer_box, &cache->box, transform, ow, oh);
+    cache_gl_box(renderer, &buffer_box, &gl_box);
+
+    /* Contents are premultiplied and already carry opacity, mask and corners */
+    glUseProgram(renderer->quad_shader.shader);
+    glEnable(GL_BLEND);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, cache->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glUniform1i(renderer->quad_shader.tex, 0);
+
+    bind_vertex_array(renderer, renderer->quad_shader.vao,
+            renderer->quad_shader.pos_attrib, renderer->quad_shader.tex_attrib, QUAD_VERTS_OFFSET);
+
+    /* Texture rows are as copied from the cache buffer */
+    glViewport(gl_box.x, gl_box.y, gl_box.width, gl_box.height);
+
+    int nrects;
+    pixman_box32_t *rects = pixman_region32_rectangles(damage, &nrects);
+    for (int i = 0; i < nrects; i++) {
+        struct wlr_box damage_box = {.x = rects[i].x1,
+                                     .y = rects[i].y1,
+                                     .width = rects[i].x2 - rects[i].x1,
+                                     .height = rects[i].y2 - rects[i].y1};
+        struct wlr_box inters;
+        wlr_box_intersection(&inters, &cache->box, &damage_box);
+        if (wlr_box_empty(&inters))
+            continue;
+
+        wlr_box_transform(&inters, &inters, transform, ow, oh);
+        wm_renderer_scissor(renderer, &inters);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    glViewport(0, 0, renderer->current->wlr_output->width, renderer->current->wlr_output->height);
+
+    unbind_vertex_array(renderer->quad_shader.vao, renderer->quad_shader.pos_attrib, renderer->quad_shader.tex_attrib);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+#endif
+}
+
+void wm_renderer_cache_destroy(struct wm_renderer* renderer, struct wm_renderer_cache* cache){
+#ifdef WM_CUSTOM_RENDERER
+    if(!cache->texture) return;
+
+    /* Possibly called during rendering */
+    struct wlr_gles2_renderer *gles2_renderer = gles2_get_renderer(renderer->wlr_renderer);
+    if(!renderer->current) assert(wlr_egl_make_current(gles2_renderer->egl));
+
+    glDeleteTextures(1, &cache->texture);
+    cache->texture = 0;
+
+    if(!renderer->current) wlr_egl_unset_current(gles2_renderer->egl);
+#endif
+    cache->valid = false;
+}
+
+bool wm_renderer_snapshot_begin(struct wm_renderer* renderer, struct wlr_box* box){
+#ifdef WM_CUSTOM_RENDERER
+    if(renderer->mode != WM_RENDERER_PYWM) return false;
+
+    /* Rows are flipped while copying, which only holds for untransformed outputs */
+    if(renderer->current->wlr_output->transform != WL_OUTPUT_TRANSFORM_NORMAL) return false;
+
+    /* Flipping copy is a glBlitFramebuffer */
+    if(!renderer->framebuffer_blits) return false;
+
+    begin_cache_buffer(renderer, box);
+    return true;
+#else
+    return false;
+#endif
+}
+
+struct wlr_texture* wm_renderer_snapshot_end(struct wm_renderer* renderer, struct wlr_box* box){
+#ifdef WM_CUSTOM_RENDERER
+    wm_renderer_flush_primitives(renderer);
+
+    struct wlr_box buffer_box, gl_box;
+    cache_buffer_box(renderer, box, &buffer_box);
+    cache_gl_box(renderer, &buffer_box, &gl_box);
+
+    /* Allocate through wlroots to be able to render with the texture shaders */
+    void* pixels = calloc(buffer_box.width * buffer_box.height, 4);
+    struct wlr_texture* texture = wlr_texture_from_pixels(renderer->wlr_renderer,
+            DRM_FORMAT_ABGR8888, 4 * buffer_box.width, buffer_box.width, buffer_box.height, pixels);
+    free(pixels);
+
+    if(texture){
+        GLuint fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gles2_get_texture(texture)->tex, 0);
+
+        /* Cache buffer is still bound for reading - first texture row is the top row of box */
+        wm_renderer_scissor(renderer, NULL);
+        glBlitFramebuffer(gl_box.x, gl_box.y, gl_box.x + gl_box.width, gl_box.y + gl_box.height,
+                0, gl_box.height, gl_box.width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        glDeleteFramebuffers(1, &fbo);
+    }
+
+    wm_renderer_to_buffer(renderer, renderer->selected_buffer);
+    return texture;
+#else
+    return NULL;
+#endif
+}
+
+struct wlr_texture* wm_renderer_downscale_texture(struct wm_renderer* renderer, struct wlr_texture* wlr_texture, int level){
+#ifdef WM_CUSTOM_RENDERER
+    if(renderer->mode != WM_RENDERER_PYWM || level < 1) return NULL;
+
+    /* External textures cannot be read through a framebuffer */
+    struct wlr_gles2_texture* texture = gles2_get_texture(wlr_texture);
+    if(texture->target != GL_TEXTURE_2D) return NULL;
+
+    wm_renderer_flush_primitives(renderer);
+
+    /* May happen while rendering into the cache buffer - restore whatever is bound */
+    GLint prev_fbo;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fbo);
+
+    GLuint read_fbo = 0, draw_fbo;
+    glGenFramebuffers(1, &draw_fbo);
+
+    bool complete = true;
+    if(renderer->framebuffer_blits){
+        glGenFramebuffers(1, &read_fbo);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, read_fbo);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->tex, 0);
+        complete = glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }else{
+        glUseProgram(renderer->quad_shader.shader);
+        glDisable(GL_BLEND);
+        glUniform1i(renderer->quad_shader.tex, 0);
+        glActiveTexture(GL_TEXTURE0);
+        bind_vertex_array(renderer, renderer->quad_shader.vao,
+                renderer->quad_shader.pos_attrib, renderer->quad_shader.tex_attrib, QUAD_VERTS_OFFSET);
+    }
+
+    struct wlr_texture* result = NULL;
+    GLuint source = texture->tex;
+    GLuint intermediate = 0;
+
+    if(complete){
+        wm_renderer_scissor(renderer, NULL);
+
+        /* Halve repeatedly - linear sampling at exactly 2:1 averages 2x2 texels */
+        int width = wlr_texture->width;
+        int height = wlr_texture->height;
+        for(int i=1; i<=level; i++){
+            int w = width > 1 ? width / 2 : 1;
+            int h = height > 1 ? height / 2 : 1;
+
+            GLuint target;
+            if(i == level){
+                void* pixels = calloc(w * h, 4);
+                result = wlr_texture_from_pixels(renderer->wlr_renderer,
+                        texture->has_alpha ? DRM_FORMAT_ABGR8888 : DRM_FORMAT_XBGR8888, 4 * w, w, h, pixels);
+                free(pixels);
+                if(!result) break;
+
+                target = gles2_get_texture(result)->tex;
+            }else{
+                glGenTextures(1, &target);
+                glBindTexture(GL_TEXTURE_2D, target);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                glBindTexture(GL_TEXTURE_2D, 0);
+            }
+
+            if(renderer->framebuffer_blits){
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_fbo);
+                glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+                glBlitFramebuffer(0, 0, width, height, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+                /* Next pass reads what has just been written */
+                glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+            }else{
+                /* Texture rows map onto framebuffer rows as with the blit */
+                glBindFramebuffer(GL_FRAMEBUFFER, draw_fbo);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+                glViewport(0, 0, w, h);
+
+                glBindTexture(GL_TEXTURE_2D, source);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                glBindTexture(GL_TEXTURE_2D, 0);
+            }
+
+            if(intermediate) glDeleteTextures(1, &intermediate);
+            intermediate = i == level ? 0 : target;
+            source = target;
+
+            width = w;
+            height = h;
+        }
+    }
+
+    if(!renderer->framebuffer_blits){
+        unbind_vertex_array(renderer->quad_shader.vao, renderer->quad_shader.pos_attrib, renderer->quad_shader.tex_attrib);
+        glViewport(0, 0, renderer->current->wlr_output->width, renderer->current->wlr_output->height);
+    }
+
+    if(intermediate) glDeleteTextures(1, &intermediate);
+    if(read_fbo) glDeleteFramebuffers(1, &read_fbo);
+    glDeleteFramebuffers(1, &draw_fbo);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+    return result;
+#else
+    return NULL;
+#endif
+}
+
 void wm_renderer_ensure_mode(struct wm_renderer* renderer, enum wm_renderer_mode mode){
     if(mode == WM_RENDERER_WLR){
         wlr_log(WLR_INFO, "Disabling PyWM custom renderer");
@@ -91,6 +91,7 @@ void wm_seat_init(struct wm_seat* seat, struct wm_server* server, struct wm_layo
     seat->wm_server = server;
     wl_list_init(&seat->wm_keyboards);
     wl_list_init(&seat->wm_pointers);
+    wl_list_init(&seat->wm_drags);
 
     seat->wlr_seat = wlr_seat_create(server->wl_display, "default");
     assert(seat->wlr_seat);
@@ -312,14 +313,22 @@ void wm_seat_kill_seatop(struct wm_seat* seat){
     seat->seatop_down.active = false;
 }
 
-void wm_seat_reconfigure(struct wm_seat* seat){
+void wm_seat_reconfigure_keyboards(struct wm_seat* seat){
     struct wm_keyboard* keyboard;
     wl_list_for_each(keyboard, &seat->wm_keyboards, link){
         wm_keyboard_reconfigure(keyboard);
     }
+}
+
+void wm_seat_reconfigure_pointers(struct wm_seat* seat){
     struct wm_pointer* pointer;
     wl_list_for_each(pointer, &seat->wm_pointers, link){
         wm_pointer_reconfigure(pointer);
     }
+}
+
+void wm_seat_reconfigure(struct wm_seat* seat){
+    wm_seat_reconfigure_keyboards(seat);
+    wm_seat_reconfigure_pointers(seat);
     wm_cursor_reconfigure(seat->wm_cursor);
 }
@@ -36,6 +36,7 @@
 #include "wm/wm_view_layer.h"
 #ifdef WM_HAS_XWAYLAND
 #include "wm/wm_view_xwayland.h"
+#include "wm/wm_xwayland_index.h"
 #endif
 #include "wm/wm_layout.h"
 #include "wm/wm_widget.h"
@@ -43,6 +44,8 @@
 #include "wm/wm_output.h"
 #include "wm/wm_renderer.h"
 #include "wm/wm_idle_inhibit.h"
+#include "wm/wm_texture_cache.h"
+#include "wm/wm_transaction.h"
 #include "wm/wm_widget.h"
 #include "wm/wm_view.h"
 #include "wm/wm_drag.h"
@@ -191,6 +194,29 @@ static void handle_ready(struct wl_listener* listener, void* data){
     wm_callback_ready();
 }
 
+static int hidden_frame_done_timer_handler(void* data){
+    struct wm_server* server = data;
+    server->hidden_frame_done_armed = false;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    struct wm_content* content;
+    wl_list_for_each(content, &server->wm_contents, link){
+        if(!wm_content_is_view(content)) continue;
+        struct wm_view* view = wm_cast(wm_view, content);
+        if(!view->mapped || wm_view_is_visible(view)) continue;
+
+        wm_view_send_frame_done(view, &now);
+        server->hidden_frame_done_armed = true;
+    }
+
+    if(server->hidden_frame_done_armed){
+        wl_event_source_timer_update(server->hidden_frame_done_timer, WM_SERVER_HIDDEN_FRAME_DONE_MS);
+    }
+    return 0;
+}
+
 static int callback_timer_handler(void* data){
     struct wm_server* server = data;
 
@@ -199,6 +225,7 @@ static int callback_timer_handler(void* data){
         server->constant_damage_mode = 1;
     }else{
         DEBUG_PERFORMANCE(py_start, 0);
+        wm_cursor_flush_motion(server->wm_seat->wm_cursor);
         wm_layout_start_update(server->wm_layout);
         wm_callback_update();
         if(server->constant_damage_mode == 1 && wm_layout_get_refresh_output(server->wm_layout) < 0){
@@ -284,6 +311,8 @@ void wm_server_init(struct wm_server* server, struct wm_config* config){
 
 #ifdef WM_HAS_XWAYLAND
     server->wlr_xwayland = NULL;
+    server->wm_xwayland_index = calloc(1, sizeof(struct wm_xwayland_index));
+    wm_xwayland_index_init(server->wm_xwayland_index);
     if(config->enable_xwayland){
         server->wlr_xwayland = wlr_xwayland_create(server->wl_display, server->wlr_compositor, false);
         assert(server->wlr_xwayland);
@@ -312,6 +341,12 @@ void wm_server_init(struct wm_server* server, struct wm_config* config){
     server->wm_idle_inhibit = calloc(1, sizeof(struct wm_idle_inhibit));
     wm_idle_inhibit_init(server->wm_idle_inhibit, server);
 
+    server->wm_texture_cache = calloc(1, sizeof(struct wm_texture_cache));
+    wm_texture_cache_init(server->wm_texture_cache, server);
+
+    server->wm_transaction = calloc(1, sizeof(struct wm_transaction));
+    wm_transaction_init(server->wm_transaction, server);
+
 
     /* Additional headless backend for vnc */
     server->wlr_headless_backend = wlr_headless_backend_create(server->wl_display);
@@ -360,6 +395,11 @@ void wm_server_init(struct wm_server* server, struct wm_config* config){
     server->callback_timer = wl_event_loop_add_timer(
         server->wl_event_loop, callback_timer_handler, server);
 
+    server->hidden_frame_done_timer = wl_event_loop_add_timer(
+        server->wl_event_loop, hidden_frame_done_timer_handler, server);
+    server->hidden_frame_done_armed = false;
+    server->visibility_dirty = true;
+
     server->lock_perc = 0.0;
 
     server->wlr_xcursor_manager = NULL;
@@ -369,6 +409,13 @@ void wm_server_init(struct wm_server* server, struct wm_config* config){
 }
 
 void wm_server_destroy(struct wm_server* server){
+    /* Reduced copies, snapshots and render caches are textures of the renderer - views themselves go with their clients */
+    wm_texture_cache_destroy(server->wm_texture_cache);
+    struct wm_content* content;
+    wl_list_for_each(content, &server->wm_contents, link){
+        wm_content_free_render_cache(content);
+        if(wm_content_is_view(content)) wm_view_drop_snapshot(wm_cast(wm_view, content));
+    }
     wm_renderer_destroy(server->wm_renderer);
     wm_layout_destroy(server->wm_layout);
     wm_seat_destroy(server->wm_seat);
@@ -379,11 +426,18 @@ void wm_server_destroy(struct wm_server* server){
     free(server->wm_layout);
     free(server->wm_seat);
     free(server->wm_idle_inhibit);
+    free(server->wm_texture_cache);
 
 #ifdef WM_HAS_XWAYLAND
     wlr_xwayland_destroy(server->wlr_xwayland);
+    free(server->wm_xwayland_index);
 #endif
     wl_display_destroy_clients(server->wl_display);
+
+    /* Contents remove themselves on destroy */
+    wm_transaction_destroy(server->wm_transaction);
+    free(server->wm_transaction);
+
     wl_display_destroy(server->wl_display);
 }
 
@@ -541,12 +595,159 @@ void wm_server_update_contents(struct wm_server* server){
                 cur1 = cur1->prev;
                 cur2 = cur1;
                 swapped = 1;
+                server->visibility_dirty = true;
             }
         }
 
     } while(swapped);
 }
 
+struct visibility_rect {
+    double x1;
+    double y1;
+    double x2;
+    double y2;
+};
+
+static void visibility_rect_intersect(struct visibility_rect* rect, double x, double y, double width, double height){
+    if(x > rect->x1) rect->x1 = x;
+    if(y > rect->y1) rect->y1 = y;
+    if(x + width < rect->x2) rect->x2 = x + width;
+    if(y + height < rect->y2) rect->y2 = y + height;
+}
+
+static bool visibility_rect_get(struct wm_view* view, bool apply_mask, struct visibility_rect* rect){
+    double x, y, width, height;
+    wm_content_get_box(&view->super, &x, &y, &width, &height);
+    rect->x1 = x;
+    rect->y1 = y;
+    rect->x2 = x + width;
+    rect->y2 = y + height;
+
+    if(apply_mask){
+        double mask_x, mask_y, mask_w, mask_h;
+        wm_content_get_mask(&view->super, &mask_x, &mask_y, &mask_w, &mask_h);
+        visibility_rect_intersect(rect, x + mask_x, y + mask_y, mask_w, mask_h);
+    }
+
+    if(wm_content_has_workspace(&view->super)){
+        double ws_x, ws_y, ws_w, ws_h;
+        wm_content_get_workspace(&view->super, &ws_x, &ws_y, &ws_w, &ws_h);
+        visibility_rect_intersect(rect, ws_x, ws_y, ws_w, ws_h);
+    }
+
+    return rect->x2 > rect->x1 && rect->y2 > rect->y1;
+}
+
+struct opaque_data {
+    int width;
+    int height;
+    bool opaque;
+};
+
+static void check_opaque(struct wlr_surface *surface, int sx, int sy, bool constrained, void *data) {
+    struct opaque_data* odata = data;
+    if(sx != 0 || sy != 0) return;
+    if(surface->current.width < odata->width || surface->current.height < odata->height) return;
+
+    pixman_box32_t box = { .x1 = 0, .y1 = 0, .x2 = odata->width, .y2 = odata->height };
+    if(pixman_region32_contains_rectangle(&surface->opaque_region, &box) == PIXMAN_REGION_IN){
+        odata->opaque = true;
+    }
+}
+
+/* Conservative: only an opaque, unrounded view above covering the whole box hides a view */
+static bool view_is_occluded(struct wm_server* server, struct wm_view* view, struct visibility_rect* rect){
+    if(wm_server_is_locked(server)) return false;
+
+    struct wm_content* content;
+    wl_list_for_each(content, &server->wm_contents, link){
+        if(content == &view->super) break;
+        if(!wm_content_is_view(content)) continue;
+        if(wm_content_get_z_index(content) <= wm_content_get_z_index(&view->super)) continue;
+
+        struct wm_view* other = wm_cast(wm_view, content);
+        if(!other->mapped) continue;
+        if(wm_content_get_opacity(content) < 1. - 0.0001) continue;
+        if(wm_content_get_corner_radius(content) > 0.) continue;
+
+        struct visibility_rect other_rect;
+        if(!visibility_rect_get(other, true, &other_rect)) continue;
+        if(other_rect.x1 > rect->x1 || other_rect.y1 > rect->y1 ||
+                other_rect.x2 < rect->x2 || other_rect.y2 < rect->y2) continue;
+
+        struct opaque_data odata = { .opaque = false };
+        wm_view_get_size(other, &odata.width, &odata.height);
+        if(odata.width <= 0 || odata.height <= 0) continue;
+        wm_view_for_each_surface(other, check_opaque, &odata);
+
+        if(odata.opaque) return true;
+    }
+
+    return false;
+}
+
+static bool view_is_visible(struct wm_server* server, struct wm_view* view){
+    if(wm_content_get_opacity(&view->super) < 0.0001) return false;
+
+    struct visibility_rect rect;
+    if(!visibility_rect_get(view, false, &rect)) return false;
+
+    bool on_output = false;
+    struct wm_output* output;
+    wl_list_for_each(output, &server->wm_layout->wm_outputs, link){
+        if(wm_content_is_on_output(&view->super, output)){
+            on_output = true;
+            break;
+        }
+    }
+    if(!on_output) return false;
+
+    return !view_is_occluded(server, view, &rect);
+}
+
+void wm_server_invalidate_visibility(struct wm_server* server){
+    server->visibility_dirty = true;
+}
+
+void wm_server_update_visibility(struct wm_server* server){
+    if(!server->visibility_dirty) return;
+    server->visibility_dirty = false;
+
+    bool any_hidden = false;
+    bool any_changed = false;
+
+    struct wm_content* content;
+    wl_list_for_each(content, &server->wm_contents, link){
+        if(!wm_content_is_view(content)) continue;
+        struct wm_view* view = wm_cast(wm_view, content);
+        if(!view->mapped) continue;
+
+        bool visible = view_is_visible(server, view);
+        if(visible != wm_view_is_visible(view)){
+            wm_view_set_visible(view, visible);
+            view->visible_changed = true;
+            any_changed = true;
+        }
+        if(!visible) any_hidden = true;
+    }
+
+    /* After the pass, as python may change contents in turn */
+    struct wm_content* tmp;
+    if(any_changed) wl_list_for_each_safe(content, tmp, &server->wm_contents, link){
+        if(!wm_content_is_view(content)) continue;
+        struct wm_view* view = wm_cast(wm_view, content);
+        if(!view->visible_changed) continue;
+
+        view->visible_changed = false;
+        wm_callback_update_view(view);
+    }
+
+    if(any_hidden && !server->hidden_frame_done_armed){
+        wl_event_source_timer_update(server->hidden_frame_done_timer, WM_SERVER_HIDDEN_FRAME_DONE_MS);
+        server->hidden_frame_done_armed = true;
+    }
+}
 
 void wm_server_schedule_update(struct wm_server* server, struct wm_output* from_output){
     if(from_output->key == wm_layout_get_refresh_output(server->wm_layout)){
@@ -558,6 +759,7 @@ void wm_server_set_locked(struct wm_server* server, double lock_perc){
     if(fabs(lock_perc - server->lock_perc) < 0.001) return;
 
     server->lock_perc = lock_perc;
+    wm_server_invalidate_visibility(server);
     wm_layout_damage_whole(server->wm_layout);
 
     if(wm_server_is_locked(server)){
@@ -581,17 +783,41 @@ void wm_server_printf(FILE* file, struct wm_server* server){
         wm_content_printf(file, content);
     }
 
+    struct wm_texture_cache_stats* stats = &server->wm_texture_cache->stats;
+    fprintf(file, "Buffers: %ld commits, %ld imports (%.2fms avg, %.2fms max), %ld reuses (%.2fms avg), %ld downscales\n",
+            stats->n_commits,
+            stats->n_imports,
+            stats->n_imports ? stats->import_nsec / stats->n_imports / 1000000. : 0.,
+            stats->import_nsec_max / 1000000.,
+            stats->n_reuses,
+            stats->n_reuses ? stats->reuse_nsec / stats->n_reuses / 1000000. : 0.,
+            stats->n_downscales);
+
+    struct wm_transaction_stats* tstats = &server->wm_transaction->stats;
+    fprintf(file, "Transactions: %ld waited for clients (%.2fms avg, %.2fms max), %ld timed out\n",
+            tstats->n_transactions,
+            tstats->n_transactions ? tstats->latency_nsec / tstats->n_transactions / 1000000. : 0.,
+            tstats->latency_nsec_max / 1000000.,
+            tstats->n_timeouts);
+
     fprintf(file, "---- server end ------\n");
 
 }
 
 void wm_server_reconfigure(struct wm_server* server){
+    wm_server_reconfigure_decorations(server);
+    wm_server_reconfigure_xcursor(server);
+}
+
+void wm_server_reconfigure_decorations(struct wm_server* server){
     wlr_server_decoration_manager_set_default_mode(
         server->wlr_server_decoration_manager,
         server->wm_config->encourage_csd
             ? WLR_SERVER_DECORATION_MANAGER_MODE_CLIENT
             : WLR_SERVER_DECORATION_MANAGER_MODE_SERVER);
+}
 
+void wm_server_reconfigure_xcursor(struct wm_server* server){
     if(server->wlr_xcursor_manager){
         wlr_xcursor_manager_destroy(server->wlr_xcursor_manager);
     }
@@ -0,0 +1,199 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/log.h>
+
+#include "wm/wm_texture_cache.h"
+#include "wm/wm_server.h"
+#include "wm/wm_renderer.h"
+
+static long long nsec_diff(struct timespec t1, struct timespec t2){
+    return (t1.tv_sec - t2.tv_sec) * 1000000000LL + (t1.tv_nsec - t2.tv_nsec);
+}
+
+static void drop_reduced(struct wm_texture_cache_surface* surface){
+    if(surface->reduced){
+        wlr_texture_destroy(surface->reduced);
+    }
+    surface->reduced = NULL;
+    surface->reduced_source = NULL;
+}
+
+static void surface_destroy(struct wm_texture_cache_surface* surface){
+    drop_reduced(surface);
+    wlr_addon_finish(&surface->addon);
+
+    wl_list_remove(&surface->commit.link);
+    wl_list_remove(&surface->destroy.link);
+    wl_list_remove(&surface->link);
+    free(surface);
+}
+
+/* Lifetime is handled through the destroy listener */
+static void handle_addon_destroy(struct wlr_addon* addon){
+}
+
+static const struct wlr_addon_interface addon_impl = {
+    .name = "wm_texture_cache_surface",
+    .destroy = handle_addon_destroy,
+};
+
+/*
+ * Callbacks
+ */
+static void handle_surface_commit(struct wl_listener* listener, void* data){
+    struct wm_texture_cache_surface* surface = wl_container_of(listener, surface, commit);
+    struct wm_texture_cache* cache = surface->cache;
+
+    if(!(surface->wlr_surface->current.committed & WLR_SURFACE_STATE_BUFFER)) return;
+
+    /* Contents changed, even if the texture is the same */
+    drop_reduced(surface);
+    clock_gettime(CLOCK_MONOTONIC, &surface->committed);
+    if(!surface->wlr_surface->buffer) return;
+
+    struct wlr_texture* texture = surface->wlr_surface->buffer->texture;
+    if(!texture) return;
+
+    long long nsec = 0;
+    if(cache->pending_commit == surface->wlr_surface->resource){
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        nsec = nsec_diff(now, cache->pending_commit_start);
+    }
+    cache->pending_commit = NULL;
+    cache->stats.n_commits++;
+
+    int i = 0;
+    for(; i<surface->n_textures; i++){
+        if(surface->textures[i] == texture) break;
+    }
+
+    if(i < surface->n_textures){
+        cache->stats.n_reuses++;
+        cache->stats.reuse_nsec += nsec;
+    }else{
+        cache->stats.n_imports++;
+        cache->stats.import_nsec += nsec;
+        if(nsec > cache->stats.import_nsec_max) cache->stats.import_nsec_max = nsec;
+
+        if(surface->n_textures < WM_TEXTURE_CACHE_SIZE) surface->n_textures++;
+        i = surface->n_textures - 1;
+    }
+
+    /* Move to front */
+    memmove(&surface->textures[1], &surface->textures[0], i * sizeof(struct wlr_texture*));
+    surface->textures[0] = texture;
+}
+
+static void handle_surface_destroy(struct wl_listener* listener, void* data){
+    struct wm_texture_cache_surface* surface = wl_container_of(listener, surface, destroy);
+    if(surface->cache->pending_commit == surface->wlr_surface->resource){
+        surface->cache->pending_commit = NULL;
+    }
+
+    surface_destroy(surface);
+}
+
+static void handle_new_surface(struct wl_listener* listener, void* data){
+    struct wm_texture_cache* cache = wl_container_of(listener, cache, new_surface);
+    struct wlr_surface* wlr_surface = data;
+
+    struct wm_texture_cache_surface* surface = calloc(1, sizeof(struct wm_texture_cache_surface));
+    surface->cache = cache;
+    surface->wlr_surface = wlr_surface;
+    surface->n_textures = 0;
+    surface->reduced = NULL;
+    surface->reduced_source = NULL;
+    surface->reduced_level = 0;
+    clock_gettime(CLOCK_MONOTONIC, &surface->committed);
+
+    wlr_addon_init(&surface->addon, &wlr_surface->addons, cache, &addon_impl);
+
+    surface->commit.notify = &handle_surface_commit;
+    wl_signal_add(&wlr_surface->events.commit, &surface->commit);
+
+    surface->destroy.notify = &handle_surface_destroy;
+    wl_signal_add(&wlr_surface->events.destroy, &surface->destroy);
+
+    wl_list_insert(&cache->surfaces, &surface->link);
+}
+
+/* The import happens inside wlroots' commit handler - time it from the request. Sees every request of
+ * every client, therefore only installed with debug set */
+static void handle_protocol(void* user_data, enum wl_protocol_logger_type direction,
+        const struct wl_protocol_logger_message* message){
+    struct wm_texture_cache* cache = user_data;
+    if(direction != WL_PROTOCOL_LOGGER_REQUEST) return;
+    if(strcmp(message->message->name, "commit")) return;
+    if(strcmp(wl_resource_get_class(message->resource), "wl_surface")) return;
+
+    cache->pending_commit = message->resource;
+    clock_gettime(CLOCK_MONOTONIC, &cache->pending_commit_start);
+}
+
+/*
+ * Class implementation
+ */
+void wm_texture_cache_init(struct wm_texture_cache* cache, struct wm_server* server){
+    cache->wm_server = server;
+    wl_list_init(&cache->surfaces);
+    wm_texture_cache_reset_stats(cache);
+
+    cache->pending_commit = NULL;
+    cache->wl_protocol_logger = NULL;
+    if(server->wm_config->debug){
+        cache->wl_protocol_logger = wl_display_add_protocol_logger(server->wl_display, &handle_protocol, cache);
+    }
+
+    cache->new_surface.notify = &handle_new_surface;
+    wl_signal_add(&server->wlr_compositor->events.new_surface, &cache->new_surface);
+}
+
+void wm_texture_cache_destroy(struct wm_texture_cache* cache){
+    wl_list_remove(&cache->new_surface.link);
+    if(cache->wl_protocol_logger){
+        wl_protocol_logger_destroy(cache->wl_protocol_logger);
+    }
+
+    struct wm_texture_cache_surface* surface, *tmp;
+    wl_list_for_each_safe(surface, tmp, &cache->surfaces, link){
+        surface_destroy(surface);
+    }
+}
+
+void wm_texture_cache_reset_stats(struct wm_texture_cache* cache){
+    memset(&cache->stats, 0, sizeof(struct wm_texture_cache_stats));
+}
+
+struct wlr_texture* wm_texture_cache_get_reduced(struct wm_texture_cache* cache, struct wlr_surface* wlr_surface,
+        struct wlr_texture* texture, int level){
+    struct wlr_addon* addon = wlr_addon_find(&wlr_surface->addons, cache, &addon_impl);
+    if(!addon) return NULL;
+
+    struct wm_texture_cache_surface* surface = wl_container_of(addon, surface, addon);
+    if(level > WM_TEXTURE_CACHE_MAX_LEVEL) level = WM_TEXTURE_CACHE_MAX_LEVEL;
+
+    /* Static surfaces are downscaled once */
+    if(surface->reduced_source == texture && surface->reduced_level == level){
+        return surface->reduced;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(nsec_diff(now, surface->committed) < WM_TEXTURE_CACHE_STATIC_MSEC * 1000000LL){
+        return NULL;
+    }
+
+    drop_reduced(surface);
+    surface->reduced_source = texture;
+    surface->reduced_level = level;
+    surface->reduced = wm_renderer_downscale_texture(cache->wm_server->wm_renderer, texture, level);
+    if(surface->reduced) cache->stats.n_downscales++;
+
+    return surface->reduced;
+}
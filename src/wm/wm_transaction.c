@@ -0,0 +1,191 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server.h>
+#include <wlr/util/log.h>
+
+#include "wm/wm_transaction.h"
+#include "wm/wm_server.h"
+#include "wm/wm_config.h"
+#include "wm/wm_content.h"
+#include "wm/wm_view.h"
+
+static long long nsec_diff(struct timespec t1, struct timespec t2){
+    return (t1.tv_sec - t2.tv_sec) * 1000000000LL + (t1.tv_nsec - t2.tv_nsec);
+}
+
+static bool enabled(struct wm_transaction* transaction){
+    return transaction->wm_server->wm_config->transaction_timeout_ms > 0;
+}
+
+static struct wm_transaction_entry* find_entry(struct wm_transaction* transaction, struct wm_content* content, bool create){
+    for(int i=0; i<transaction->n_entries; i++){
+        if(transaction->entries[i].content == content) return &transaction->entries[i];
+    }
+    if(!create) return NULL;
+
+    if(transaction->n_entries == transaction->capacity){
+        transaction->capacity = transaction->capacity ? 2 * transaction->capacity : 16;
+        transaction->entries = realloc(transaction->entries, transaction->capacity * sizeof(struct wm_transaction_entry));
+    }
+
+    struct wm_transaction_entry* entry = &transaction->entries[transaction->n_entries++];
+    memset(entry, 0, sizeof(struct wm_transaction_entry));
+    entry->content = content;
+    return entry;
+}
+
+static void apply(struct wm_transaction* transaction, bool timed_out){
+    if(transaction->armed){
+        wl_event_source_timer_update(transaction->timeout, 0);
+        transaction->armed = false;
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long latency = nsec_diff(now, transaction->committed);
+
+        transaction->stats.n_transactions++;
+        transaction->stats.latency_nsec += latency;
+        if(latency > transaction->stats.latency_nsec_max) transaction->stats.latency_nsec_max = latency;
+
+        if(timed_out){
+            transaction->stats.n_timeouts++;
+            wlr_log(WLR_DEBUG, "Transaction: Timed out waiting for %d views", transaction->n_waiting);
+        }
+    }
+
+    for(int i=0; i<transaction->n_entries; i++){
+        struct wm_transaction_entry* entry = &transaction->entries[i];
+        if(!entry->box_pending) continue;
+        wm_content_set_box(entry->content, entry->x, entry->y, entry->width, entry->height);
+    }
+
+    transaction->n_entries = 0;
+    transaction->n_waiting = 0;
+}
+
+static void possibly_apply(struct wm_transaction* transaction){
+    if(transaction->collecting || transaction->n_waiting > 0) return;
+    apply(transaction, false);
+}
+
+/*
+ * Callbacks
+ */
+static int handle_timeout(void* data){
+    struct wm_transaction* transaction = data;
+    if(!transaction->collecting){
+        apply(transaction, true);
+    }else{
+        /* Apply on commit */
+        transaction->n_waiting = 0;
+        for(int i=0; i<transaction->n_entries; i++) transaction->entries[i].waiting = false;
+    }
+    return 0;
+}
+
+/*
+ * Class implementation
+ */
+void wm_transaction_init(struct wm_transaction* transaction, struct wm_server* server){
+    transaction->wm_server = server;
+    transaction->collecting = false;
+
+    transaction->entries = NULL;
+    transaction->n_entries = 0;
+    transaction->capacity = 0;
+    transaction->n_waiting = 0;
+
+    transaction->armed = false;
+    transaction->timeout = wl_event_loop_add_timer(server->wl_event_loop, handle_timeout, transaction);
+    wm_transaction_reset_stats(transaction);
+}
+
+void wm_transaction_destroy(struct wm_transaction* transaction){
+    wl_event_source_remove(transaction->timeout);
+    free(transaction->entries);
+}
+
+void wm_transaction_begin(struct wm_transaction* transaction){
+    if(!enabled(transaction)) return;
+    transaction->collecting = true;
+}
+
+void wm_transaction_commit(struct wm_transaction* transaction){
+    if(!transaction->collecting) return;
+    transaction->collecting = false;
+
+    /* Updates while waiting join the running transaction - the timeout is not extended */
+    if(transaction->n_waiting > 0 && !transaction->armed){
+        clock_gettime(CLOCK_MONOTONIC, &transaction->committed);
+        wl_event_source_timer_update(transaction->timeout, transaction->wm_server->wm_config->transaction_timeout_ms);
+        transaction->armed = true;
+    }
+
+    possibly_apply(transaction);
+}
+
+void wm_transaction_set_box(struct wm_transaction* transaction, struct wm_content* content,
+        double x, double y, double width, double height){
+    if(!transaction->collecting && transaction->n_entries == 0){
+        wm_content_set_box(content, x, y, width, height);
+        return;
+    }
+
+    struct wm_transaction_entry* entry = find_entry(transaction, content, true);
+    entry->box_pending = true;
+    entry->x = x;
+    entry->y = y;
+    entry->width = width;
+    entry->height = height;
+}
+
+void wm_transaction_add_configure(struct wm_transaction* transaction, struct wm_view* view, uint32_t serial){
+    if(!transaction->collecting) return;
+
+    /* Interactive resizes and views which do not commit are not waited for */
+    if(!view->mapped || view->resizing) return;
+
+    struct wm_transaction_entry* entry = find_entry(transaction, &view->super, true);
+    if(!entry->waiting) transaction->n_waiting++;
+    entry->waiting = true;
+    entry->serial = serial;
+}
+
+void wm_transaction_view_committed(struct wm_transaction* transaction, struct wm_view* view, uint32_t serial){
+    if(transaction->n_waiting == 0) return;
+
+    struct wm_transaction_entry* entry = find_entry(transaction, &view->super, false);
+    if(!entry || !entry->waiting) return;
+
+    /* Serials wrap around */
+    if((int32_t)(serial - entry->serial) < 0) return;
+
+    entry->waiting = false;
+    transaction->n_waiting--;
+    possibly_apply(transaction);
+}
+
+void wm_transaction_view_unmapped(struct wm_transaction* transaction, struct wm_view* view){
+    struct wm_transaction_entry* entry = find_entry(transaction, &view->super, false);
+    if(!entry || !entry->waiting) return;
+
+    entry->waiting = false;
+    transaction->n_waiting--;
+    possibly_apply(transaction);
+}
+
+void wm_transaction_remove_content(struct wm_transaction* transaction, struct wm_content* content){
+    struct wm_transaction_entry* entry = find_entry(transaction, content, false);
+    if(!entry) return;
+
+    if(entry->waiting) transaction->n_waiting--;
+    *entry = transaction->entries[--transaction->n_entries];
+
+    possibly_apply(transaction);
+}
+
+void wm_transaction_reset_stats(struct wm_transaction* transaction){
+    memset(&transaction->stats, 0, sizeof(struct wm_transaction_stats));
+}
@@ -1,6 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <assert.h>
+#include <math.h>
 #include <stdlib.h>
 #include <wayland-server.h>
 #include <wlr/types/wlr_xdg_shell.h>
@@ -13,6 +14,9 @@
 #include "wm/wm_renderer.h"
 #include "wm/wm_server.h"
 #include "wm/wm_layout.h"
+#include "wm/wm_config.h"
+#include "wm/wm_texture_cache.h"
+#include "wm/wm_transaction.h"
 #include "wm/wm.h"
 
 #include "wm/wm_util.h"
@@ -31,14 +35,46 @@ void wm_view_base_init(struct wm_view* view, struct wm_server* server){
     view->mapped = false;
     view->inhibiting_idle = false;
     view->accepts_input = true;
+    view->visible = true;
+    view->visible_changed = false;
+    view->occlusion.width = 0;
+    view->occlusion.height = 0;
+    view->occlusion.surface_width = 0;
+    view->occlusion.surface_height = 0;
+
+    view->input_map.valid = false;
+    view->input_map.entries = NULL;
+    view->input_map.n_entries = 0;
+    view->input_map.capacity = 0;
 
     view->shows_csd = false;
+
+    view->resize.pending = false;
+    view->resize.snapshot = NULL;
+    view->resize.snapshot_failed = false;
+    view->resize.reduced = NULL;
+    view->resize.reduced_level = 0;
+}
+
+void wm_view_drop_snapshot(struct wm_view* view){
+    if(view->resize.snapshot){
+        wlr_texture_destroy(view->resize.snapshot);
+    }
+    if(view->resize.reduced){
+        wlr_texture_destroy(view->resize.reduced);
+    }
+    view->resize.snapshot = NULL;
+    view->resize.reduced = NULL;
+    view->resize.reduced_level = 0;
+    view->resize.snapshot_failed = false;
 }
 
 static void wm_view_base_destroy(struct wm_content* super){
     struct wm_view* view = wm_cast(wm_view, super);
 
     (view->vtable->destroy)(view);
+    free(view->input_map.entries);
+    wm_view_drop_snapshot(view);
     wm_content_base_destroy(super);
 }
 
@@ -57,6 +93,137 @@ bool wm_view_is_inhibiting_idle(struct wm_view* view){
     return view->inhibiting_idle;
 }
 
+void wm_view_set_visible(struct wm_view* view, bool visible){
+    if(view->visible == visible) return;
+
+    wlr_log(WLR_DEBUG, "View: %s", visible ? "visible" : "hidden - throttling frame callbacks");
+    view->visible = visible;
+}
+bool wm_view_is_visible(struct wm_view* view){
+    return view->visible;
+}
+
+static void add_input_entry(struct wlr_surface *surface, int sx, int sy,
+        bool constrained, void *data) {
+    struct wm_view_input_map* map = data;
+
+    if(map->n_entries == map->capacity){
+        map->capacity = map->capacity ? 2 * map->capacity : 8;
+        map->entries = realloc(map->entries, map->capacity * sizeof(struct wm_view_input_entry));
+    }
+
+    struct wm_view_input_entry* entry = &map->entries[map->n_entries++];
+    entry->surface = surface;
+    entry->x = sx;
+    entry->y = sy;
+    entry->width = surface->current.width;
+    entry->height = surface->current.height;
+}
+
+static void build_input_map(struct wm_view* view){
+    struct wm_view_input_map* map = &view->input_map;
+
+    /* for_each_surface iterates bottom to top */
+    map->n_entries = 0;
+    wm_view_for_each_surface(view, add_input_entry, map);
+
+    for(int i=0, j=map->n_entries - 1; i<j; i++, j--){
+        struct wm_view_input_entry tmp = map->entries[i];
+        map->entries[i] = map->entries[j];
+        map->entries[j] = tmp;
+    }
+
+    map->valid = true;
+}
+
+void wm_view_set_mapped(struct wm_view* view, bool mapped){
+    view->mapped = mapped;
+    wm_server_invalidate_visibility(view->super.wm_server);
+
+    if(!mapped){
+        wm_transaction_view_unmapped(view->super.wm_server->wm_transaction, view);
+    }
+}
+
+void wm_view_root_committed(struct wm_view* view, struct wlr_surface* surface){
+    int width, height;
+    wm_view_get_size(view, &width, &height);
+
+    struct wm_view_occlusion* o = &view->occlusion;
+    if(!(surface->current.committed & WLR_SURFACE_STATE_OPAQUE_REGION) &&
+            o->width == width && o->height == height &&
+            o->surface_width == surface->current.width && o->surface_height == surface->current.height) return;
+
+    o->width = width;
+    o->height = height;
+    o->surface_width = surface->current.width;
+    o->surface_height = surface->current.height;
+    wm_server_invalidate_visibility(view->super.wm_server);
+}
+
+void wm_view_invalidate_input_map(struct wm_view* view){
+    view->input_map.valid = false;
+}
+
+struct wlr_surface* wm_view_surface_at(struct wm_view* view, double at_x, double at_y, double* sx, double* sy){
+    if(!view->input_map.valid){
+        build_input_map(view);
+    }
+
+    struct wm_view_input_entry* entries = view->input_map.entries;
+    for(int i=0; i<view->input_map.n_entries; i++){
+        double x = at_x - entries[i].x;
+        double y = at_y - entries[i].y;
+
+        if(x < 0 || y < 0 || x >= entries[i].width || y >= entries[i].height) continue;
+        if(!pixman_region32_contains_point(&entries[i].surface->input_region, floor(x), floor(y), NULL)) continue;
+
+        *sx = x;
+        *sy = y;
+        return entries[i].surface;
+    }
+
+    return NULL;
+}
+
+void wm_view_begin_resize(struct wm_view* view, int width, int height){
+    if(view->resize.pending && view->resize.width == width && view->resize.height == height) return;
+
+    /* A snapshot of an earlier outstanding resize is kept until the client commits newer contents */
+    view->resize.pending = true;
+    view->resize.width = width;
+    view->resize.height = height;
+
+    wm_layout_damage_from(view->super.wm_server->wm_layout, &view->super, NULL);
+}
+
+void wm_view_resize_committed(struct wm_view* view){
+    if(!view->resize.pending) return;
+
+    /* Retaken from the new contents on the next render */
+    wm_view_drop_snapshot(view);
+    wm_layout_damage_from(view->super.wm_server->wm_layout, &view->super, NULL);
+}
+
+void wm_view_end_resize(struct wm_view* view){
+    if(!view->resize.pending) return;
+
+    view->resize.pending = false;
+    wm_view_drop_snapshot(view);
+
+    wm_layout_damage_from(view->super.wm_server->wm_layout, &view->super, NULL);
+    wm_callback_view_event(view, "resize_caught_up");
+}
+
+static void send_frame_done(struct wlr_surface *surface, int sx, int sy,
+        bool constrained, void *data) {
+    wlr_surface_send_frame_done(surface, data);
+}
+
+void wm_view_send_frame_done(struct wm_view* view, struct timespec* when){
+    wm_view_for_each_surface(view, send_frame_done, when);
+}
+
 struct render_data {
     struct wm_output *output;
     pixman_region32_t* damage;
@@ -75,6 +242,40 @@ struct render_data {
 };
 
 
+/* 0 if box samples source at sufficient density, otherwise the number of halvings of source still covering box */
+static int minification_level(struct wm_output* output, struct wlr_box* box, double source_width, double source_height){
+    double threshold = output->wm_server->wm_config->downscale_threshold;
+    if(source_width < 1 || source_height < 1) return 0;
+
+    double ratio = fmax(abs(box->width) / source_width, abs(box->height) / source_height);
+    if(ratio >= threshold || ratio <= 0.) return 0;
+
+    return floor(log2(1. / ratio));
+}
+
+/*
+ * Box of a (sub)surface on output - the offset is snapped on its own so subsurfaces keep their
+ * pixel distance to the parent while it moves, and a size within a pixel of the buffer is drawn 1:1
+ */
+static void surface_box(struct wm_output* output, struct wlr_surface* surface, double x, double y,
+        int sx, int sy, double x_scale, double y_scale, struct wlr_box* box){
+    wm_output_snap_box(output, x, y, surface->current.width * x_scale, surface->current.height * y_scale, box);
+
+    struct wlr_box offset;
+    wm_output_snap_box(output, sx * x_scale, sy * y_scale, 0., 0., &offset);
+    box->x += offset.x;
+    box->y += offset.y;
+
+    if(!output->wm_server->wm_config->native_buffer_scale) return;
+
+    struct wlr_fbox source;
+    wlr_surface_get_buffer_source_box(surface, &source);
+    if(fabs(box->width - source.width) <= 1. && fabs(box->height - source.height) <= 1.){
+        box->width = round(source.width);
+        box->height = round(source.height);
+    }
+}
+
 static void render_surface(struct wlr_surface *surface, int sx, int sy,
         bool constrained, void *data) {
     struct render_data *rdata = data;
@@ -85,18 +286,10 @@ static void render_surface(struct wlr_surface *surface, int sx, int sy,
         return;
     }
 
-    struct wlr_box box = {
-        .x = round((rdata->x + sx * rdata->x_scale) * output->wlr_output->scale),
-        .y = round((rdata->y + sy * rdata->y_scale) * output->wlr_output->scale),
-        .width = round(surface->current.width * rdata->x_scale *
-                output->wlr_output->scale),
-        .height = round(surface->current.height * rdata->y_scale *
-                output->wlr_output->scale)};
-    struct wlr_box mask = {
-        .x = round(rdata->mask_x * output->wlr_output->scale),
-        .y = round(rdata->mask_y * output->wlr_output->scale),
-        .width = round(rdata->mask_w * output->wlr_output->scale),
-        .height = round(rdata->mask_h * output->wlr_output->scale)};
+    struct wlr_box box;
+    surface_box(output, surface, rdata->x, rdata->y, sx, sy, rdata->x_scale, rdata->y_scale, &box);
+    struct wlr_box mask;
+    wm_output_snap_box(output, rdata->mask_x, rdata->mask_y, rdata->mask_w, rdata->mask_h, &mask);
 
     double corner_radius = rdata->corner_radius * output->wlr_output->scale;
     if(!constrained){
@@ -122,20 +315,138 @@ static void render_surface(struct wlr_surface *surface, int sx, int sy,
         return;
     }
 
-    wm_renderer_render_texture_at(output->wm_server->wm_renderer, rdata->damage, surface, texture, &box,
-                                  rdata->opacity,
-                                  &mask,
-                                  corner_radius, rdata->lock_perc);
+    /* Heavily minified (e.g. overviews) - sample from a reduced copy */
+    struct wlr_fbox source;
+    wlr_surface_get_buffer_source_box(surface, &source);
+
+    int level = minification_level(output, &box, source.width, source.height);
+    struct wlr_texture* reduced = level > 0 ?
+        wm_texture_cache_get_reduced(output->wm_server->wm_texture_cache, surface, texture, level) : NULL;
+
+    if(reduced){
+        double fx = (double)reduced->width / texture->width;
+        double fy = (double)reduced->height / texture->height;
+        source.x *= fx;
+        source.y *= fy;
+        source.width *= fx;
+        source.height *= fy;
+
+        wm_renderer_render_subtexture_at(output->wm_server->wm_renderer, rdata->damage, reduced, &source, &box,
+                                         rdata->opacity,
+                                         &mask,
+                                         corner_radius, rdata->lock_perc);
+    }else{
+        wm_renderer_render_texture_at(output->wm_server->wm_renderer, rdata->damage, surface, texture, &box,
+                                      rdata->opacity,
+                                      &mask,
+                                      corner_radius, rdata->lock_perc);
+    }
 
     /* Notify client */
     wlr_surface_send_frame_done(surface, &rdata->when);
 }
 
 
+/* Render the view unscaled (or shrunk to fit the output) once - drawing it later is a single quad */
+static void take_snapshot(struct wm_view* view, struct wm_output* output, struct timespec now, int width, int height){
+    struct wm_renderer* renderer = view->super.wm_server->wm_renderer;
+    double scale = output->wlr_output->scale;
+
+    int ow, oh;
+    wlr_output_transformed_resolution(output->wlr_output, &ow, &oh);
+
+    double f = fmin(1., fmin(ow / (width * scale), oh / (height * scale)));
+    struct wlr_box box = {
+        .x = 0,
+        .y = 0,
+        .width = floor(width * scale * f),
+        .height = floor(height * scale * f)
+    };
+
+    if(wlr_box_empty(&box) || !wm_renderer_snapshot_begin(renderer, &box)){
+        view->resize.snapshot_failed = true;
+        return;
+    }
+
+    pixman_region32_t full;
+    pixman_region32_init_rect(&full, box.x, box.y, box.width, box.height);
+
+    struct render_data rdata = {
+        .output = output,
+        .when = now,
+        .damage = &full,
+        .x = 0,
+        .y = 0,
+        .opacity = 1.,
+        .x_scale = f,
+        .y_scale = f,
+        .corner_radius = 0.,
+        .lock_perc = 0.,
+        .mask_x = 0,
+        .mask_y = 0,
+        .mask_w = width * f,
+        .mask_h = height * f
+    };
+    wm_view_for_each_surface(view, render_surface, &rdata);
+    pixman_region32_fini(&full);
+
+    view->resize.snapshot = wm_renderer_snapshot_end(renderer, &box);
+    view->resize.snapshot_failed = !view->resize.snapshot;
+}
+
+/* Returns false if the view is to be rendered as usual */
+static bool render_resize_placeholder(struct wm_view* view, struct wm_output* output, pixman_region32_t* damage,
+        struct timespec now, struct render_data* rdata, int width, int height, double display_width, double display_height){
+    struct wm_server* server = view->super.wm_server;
+    enum wm_config_resize_placeholder mode = wm_config_get_resize_placeholder(server->wm_config);
+    if(mode == WM_CONFIG_RESIZE_NONE) return false;
+
+    double scale = output->wlr_output->scale;
+    struct wlr_box box;
+    wm_output_snap_box(output, rdata->x, rdata->y, display_width, display_height, &box);
+    struct wlr_box mask;
+    wm_output_snap_box(output, rdata->mask_x, rdata->mask_y, rdata->mask_w, rdata->mask_h, &mask);
+    if(wlr_box_empty(&box)) return false;
+
+    if(mode == WM_CONFIG_RESIZE_SNAPSHOT){
+        if(!view->resize.snapshot && !view->resize.snapshot_failed && width > 1 && height > 1){
+            take_snapshot(view, output, now, width, height);
+        }
+        if(!view->resize.snapshot) return false;
+
+        /* Snapshots do not change - the reduced copy is kept as long as the level fits */
+        struct wlr_texture* snapshot = view->resize.snapshot;
+        int level = minification_level(output, &box, snapshot->width, snapshot->height);
+        if(level != view->resize.reduced_level){
+            if(view->resize.reduced) wlr_texture_destroy(view->resize.reduced);
+            view->resize.reduced = level > 0 ? wm_renderer_downscale_texture(server->wm_renderer, snapshot, level) : NULL;
+            view->resize.reduced_level = level;
+        }
+
+        wm_renderer_render_texture_at(server->wm_renderer, damage, NULL,
+                view->resize.reduced ? view->resize.reduced : snapshot, &box,
+                rdata->opacity, &mask, rdata->corner_radius * scale, rdata->lock_perc);
+    }else{
+        pixman_region32_t region;
+        pixman_region32_init_rect(&region, box.x, box.y, box.width, box.height);
+        pixman_region32_intersect_rect(&region, &region, mask.x, mask.y, mask.width, mask.height);
+        pixman_region32_intersect(&region, &region, damage);
+
+        float color[4] = { 0.2, 0.2, 0.2, 1. };
+        wm_renderer_clear(server->wm_renderer, &region, color);
+        pixman_region32_fini(&region);
+    }
+
+    /* The client waits for frame callbacks to draw at the new size */
+    wm_view_send_frame_done(view, &now);
+    return true;
+}
+
 static void wm_view_render(struct wm_content* super, struct wm_output* output, pixman_region32_t* output_damage, struct timespec now){
     struct wm_view* view = wm_cast(wm_view, super);
 
-    if (!view->mapped) {
+    /* Hidden views get their frame callbacks from wm_server */
+    if (!view->mapped || !view->visible) {
         return;
     }
 
@@ -147,7 +458,7 @@ static void wm_view_render(struct wm_content* super, struct wm_output* output, p
             &display_height);
     double mask_x, mask_y, mask_w, mask_h;
     wm_content_get_mask(&view->super, &mask_x, &mask_y, &mask_w, &mask_h);
-    double corner_radius = wm_content_get_corner_radius(&view->super);
+    double corner_radius = wm_output_renders_corners(output) ? wm_content_get_corner_radius(&view->super) : 0.;
 
     double x_scale = width > 1 ? display_width / width : 0;
     double y_scale = width > 1 ? display_height / height : 0;
@@ -171,6 +482,10 @@ static void wm_view_render(struct wm_content* super, struct wm_output* output, p
         .mask_h = mask_h
     };
 
+    if(view->resize.pending && render_resize_placeholder(view, output, output_damage, now, &rdata,
+                width, height, display_width, display_height)){
+        return;
+    }
 
     wm_view_for_each_surface(view, render_surface, &rdata);
 }
@@ -202,6 +517,10 @@ static void damage_surface(struct wlr_surface *surface, int sx, int sy,
     double width = surface->current.width * ddata->x_scale * output->wlr_output->scale;
     double height = surface->current.height * ddata->y_scale * output->wlr_output->scale;
 
+    /* As rendered */
+    struct wlr_box snapped;
+    surface_box(output, surface, ddata->x, ddata->y, sx, sy, ddata->x_scale, ddata->y_scale, &snapped);
+
     double ws_x = ddata->ws_x * output->wlr_output->scale;
     double ws_y = ddata->ws_y * output->wlr_output->scale;
     double ws_w = ddata->ws_w * output->wlr_output->scale;
@@ -226,6 +545,8 @@ static void damage_surface(struct wlr_surface *surface, int sx, int sy,
 
         pixman_region32_union_rect(&region, &region,
                 box.x, box.y, box.width, box.height);
+        pixman_region32_union_rect(&region, &region,
+                snapped.x, snapped.y, snapped.width, snapped.height);
 
         if(ws_w > 0.){
             pixman_region32_intersect_rect(&region, &region,
@@ -243,10 +564,10 @@ static void damage_surface(struct wlr_surface *surface, int sx, int sy,
     /* effective damage might go beyond box, so do this even if origin == NULL */
     if(pixman_region32_not_empty(&region)){
         wlr_region_scale_xy(&region, &region,
-                            ddata->x_scale * output->wlr_output->scale,
-                            ddata->y_scale * output->wlr_output->scale);
+                            surface->current.width > 0 ? (double)snapped.width / surface->current.width : 0.,
+                            surface->current.height > 0 ? (double)snapped.height / surface->current.height : 0.);
 
-        pixman_region32_translate(&region, box.x, box.y);
+        pixman_region32_translate(&region, snapped.x, snapped.y);
 
         if(ws_w > 0.){
             pixman_region32_intersect_rect(&region, &region,
@@ -296,6 +617,62 @@ static void wm_view_damage_output(struct wm_content* super, struct wm_output* ou
     wm_view_for_each_surface(view, damage_surface, &ddata);
 }
 
+struct extents_data {
+    struct wm_output *output;
+    double x;
+    double y;
+    double x_scale;
+    double y_scale;
+    pixman_region32_t* region;
+};
+
+static void extents_surface(struct wlr_surface *surface, int sx, int sy,
+        bool constrained, void *data) {
+    struct extents_data *edata = data;
+    struct wm_output *output = edata->output;
+
+    double x = (edata->x + sx * edata->x_scale) * output->wlr_output->scale;
+    double y = (edata->y + sy * edata->y_scale) * output->wlr_output->scale;
+    double width = surface->current.width * edata->x_scale * output->wlr_output->scale;
+    double height = surface->current.height * edata->y_scale * output->wlr_output->scale;
+
+    pixman_region32_union_rect(edata->region, edata->region,
+            floor(x), floor(y),
+            ceil(x + width) - floor(x), ceil(y + height) - floor(y));
+
+    struct wlr_box snapped;
+    surface_box(output, surface, edata->x, edata->y, sx, sy, edata->x_scale, edata->y_scale, &snapped);
+    pixman_region32_union_rect(edata->region, edata->region,
+            snapped.x, snapped.y, snapped.width, snapped.height);
+}
+
+/* Popups and subsurfaces may extend beyond the box */
+static void wm_view_extents(struct wm_content* super, struct wm_output* output, pixman_region32_t* region){
+    struct wm_view* view = wm_cast(wm_view, super);
+
+    int width, height;
+    wm_view_get_size(view, &width, &height);
+
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    double display_x, display_y, display_width, display_height;
+    wm_content_get_box(&view->super, &display_x, &display_y, &display_width,
+            &display_height);
+
+    struct extents_data edata = {
+        .output = output,
+        .x = display_x - output->layout_x,
+        .y = display_y - output->layout_y,
+        .x_scale = display_width / width,
+        .y_scale = display_height / height,
+        .region = region
+    };
+
+    wm_view_for_each_surface(view, extents_surface, &edata);
+}
+
 static void print_surface(struct wlr_surface *surface, int sx, int sy, bool constrained,
         void *data) {
     FILE* file = data;
@@ -333,5 +710,6 @@ struct wm_content_vtable wm_view_vtable = {
     .destroy = &wm_view_base_destroy,
     .render = &wm_view_render,
     .damage_output = &wm_view_damage_output,
+    .extents = &wm_view_extents,
     .printf = &wm_view_printf
 };
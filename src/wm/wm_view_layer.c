@@ -7,11 +7,13 @@
 #include <wlr/types/wlr_subcompositor.h>
 
 #include "wm/wm_view_layer.h"
+#include "wm/wm_layer_arrange.h"
 #include "wm/wm_layout.h"
 #include "wm/wm_output.h"
 #include "wm/wm_server.h"
 #include "wm/wm_util.h"
 #include "wm/wm_seat.h"
+#include "wm/wm_cursor.h"
 #include "wm/wm.h"
 
 struct wm_view_vtable wm_view_layer_vtable;
@@ -21,6 +23,7 @@ struct wm_view_vtable wm_view_layer_vtable;
  */
 static void subsurface_handle_map(struct wl_listener* listener, void* data){
     struct wm_layer_subsurface* subsurface = wl_container_of(listener, subsurface, map);
+    wm_view_invalidate_input_map(&subsurface->root->super);
 
     wm_layout_damage_from(
         subsurface->root->super.super.wm_server->wm_layout,
@@ -30,12 +33,14 @@ static void subsurface_handle_map(struct wl_listener* listener, void* data){
 
 static void subsurface_handle_unmap(struct wl_listener* listener, void* data){
     struct wm_layer_subsurface* subsurface = wl_container_of(listener, subsurface, unmap);
+    wm_view_invalidate_input_map(&subsurface->root->super);
 
     wm_layout_damage_whole(subsurface->root->super.super.wm_server->wm_layout);
 }
 
 static void subsurface_handle_destroy(struct wl_listener* listener, void* data){
     struct wm_layer_subsurface* subsurface = wl_container_of(listener, subsurface, destroy);
+    wm_view_invalidate_input_map(&subsurface->root->super);
     wm_layer_subsurface_destroy(subsurface);
     free(subsurface);
 }
@@ -51,6 +56,7 @@ static void subsurface_handle_new_subsurface(struct wl_listener* listener, void*
 
 static void subsurface_handle_surface_commit(struct wl_listener* listener, void* data){
     struct wm_layer_subsurface* subsurface = wl_container_of(listener, subsurface, surface_commit);
+    wm_view_invalidate_input_map(&subsurface->root->super);
 
     wm_layout_damage_from(
             subsurface->root->super.super.wm_server->wm_layout,
@@ -60,6 +66,7 @@ static void subsurface_handle_surface_commit(struct wl_listener* listener, void*
 }
 static void popup_handle_map(struct wl_listener* listener, void* data){
     struct wm_popup_layer* popup = wl_container_of(listener, popup, map);
+    wm_view_invalidate_input_map(&popup->root->super);
 
     wm_layout_damage_from(
         popup->root->super.super.wm_server->wm_layout,
@@ -69,12 +76,14 @@ static void popup_handle_map(struct wl_listener* listener, void* data){
 
 static void popup_handle_unmap(struct wl_listener* listener, void* data){
     struct wm_popup_layer* popup = wl_container_of(listener, popup, unmap);
+    wm_view_invalidate_input_map(&popup->root->super);
 
     wm_layout_damage_whole(popup->root->super.super.wm_server->wm_layout);
 }
 
 static void popup_handle_destroy(struct wl_listener* listener, void* data){
     struct wm_popup_layer* popup = wl_container_of(listener, popup, destroy);
+    wm_view_invalidate_input_map(&popup->root->super);
     wm_popup_layer_destroy(popup);
     free(popup);
 }
@@ -99,6 +108,7 @@ static void popup_handle_new_subsurface(struct wl_listener* listener, void* data
 
 static void popup_handle_surface_commit(struct wl_listener* listener, void* data){
     struct wm_popup_layer* popup = wl_container_of(listener, popup, surface_commit);
+    wm_view_invalidate_input_map(&popup->root->super);
 
     wm_layout_damage_from(
             popup->root->super.super.wm_server->wm_layout,
@@ -110,7 +120,8 @@ static void popup_handle_surface_commit(struct wl_listener* listener, void* data
 static void handle_map(struct wl_listener* listener, void* data){
     struct wm_view_layer* view = wl_container_of(listener, view, map);
 
-    view->super.mapped = true;
+    wm_view_set_mapped(&view->super, true);
+    wm_view_invalidate_input_map(&view->super);
 
     wm_layout_damage_from(
         view->super.super.wm_server->wm_layout,
@@ -120,8 +131,15 @@ static void handle_map(struct wl_listener* listener, void* data){
 
 static void handle_unmap(struct wl_listener* listener, void* data){
     struct wm_view_layer* view = wl_container_of(listener, view, unmap);
-    view->super.mapped = false;
+    wm_view_set_mapped(&view->super, false);
+    wm_view_invalidate_input_map(&view->super);
     wm_layout_damage_whole(view->super.super.wm_server->wm_layout);
+
+    /* Exclusive zone is released */
+    if(view->arranged_mapped){
+        view->arranged_mapped = false;
+        wm_layer_arrange_view(view);
+    }
 }
 
 static void handle_destroy(struct wl_listener* listener, void* data){
@@ -153,6 +171,7 @@ static void handle_new_subsurface(struct wl_listener* listener, void* data){
 
 static void handle_surface_commit(struct wl_listener* listener, void* data){
     struct wm_view_layer* view = wl_container_of(listener, view, surface_commit);
+    wm_view_root_committed(&view->super, view->wlr_layer_surface->surface);
 
     int width = view->wlr_layer_surface->surface->current.width;
     int height = view->wlr_layer_surface->surface->current.height;
@@ -160,20 +179,22 @@ static void handle_surface_commit(struct wl_listener* listener, void* data){
     if(width != view->width || height != view->height){
         view->width = width;
         view->height = height;
-        wm_callback_update_view(&view->super);
-    }else{
-        view->width = width;
-        view->height = height;
+        view->update_pending = true;
     }
 
-    /*
-     * A bit hacky: Take care of setting output here
-     */
-    struct wm_output* output = wm_content_get_output(&view->super.super);
-    if(output){
-        view->wlr_layer_surface->output = output->wlr_output;
+    /* Anchors, margins, exclusive zone, ... or mapped state changed - includes the initial commit */
+    bool mapped = view->wlr_layer_surface->mapped;
+    if(view->wlr_layer_surface->current.committed || mapped != view->arranged_mapped){
+        view->arranged_mapped = mapped;
+        wm_layer_arrange_view(view);
     }
 
+    if(view->update_pending){
+        view->update_pending = false;
+        wm_callback_update_view(&view->super);
+    }
+
+    wm_view_invalidate_input_map(&view->super);
     wm_layout_damage_from(
             view->super.super.wm_server->wm_layout,
             &view->super.super, view->wlr_layer_surface->surface);
@@ -299,6 +320,28 @@ void wm_view_layer_init(struct wm_view_layer* view, struct wm_server* server, st
 
     view->wlr_layer_surface = surface;
 
+    view->arranged = false;
+    view->configured_width = -1;
+    view->configured_height = -1;
+    view->arranged_mapped = false;
+    view->update_pending = false;
+
+    /* Output is fixed for the lifetime of the surface - pick one if the client leaves it to us */
+    if(!surface->output){
+        struct wlr_cursor* cursor = server->wm_seat->wm_cursor->wlr_cursor;
+        surface->output = wlr_output_layout_output_at(server->wm_layout->wlr_output_layout, cursor->x, cursor->y);
+    }
+    if(!surface->output){
+        struct wm_output* output;
+        wl_list_for_each(output, &server->wm_layout->wm_outputs, link){
+            surface->output = output->wlr_output;
+            break;
+        }
+    }
+
+    /* Panels and backgrounds mostly stay unchanged */
+    wm_content_set_cacheable(&view->super.super, true);
+
     wl_list_init(&view->popups);
     wl_list_init(&view->subsurfaces);
 
@@ -374,8 +417,14 @@ static void wm_view_layer_get_size_constraints(struct wm_view* super, int** size
     view->size_constraints[8] = view->wlr_layer_surface->current.margin.bottom;
     view->size_constraints[9] = view->wlr_layer_surface->current.keyboard_interactive;
 
+    /* Native arrangement - width 0 if not (yet) arranged */
+    view->size_constraints[10] = view->arranged ? view->arranged_box.x : 0;
+    view->size_constraints[11] = view->arranged ? view->arranged_box.y : 0;
+    view->size_constraints[12] = view->arranged ? view->arranged_box.width : 0;
+    view->size_constraints[13] = view->arranged ? view->arranged_box.height : 0;
+
     *size_constraints = view->size_constraints;
-    *n_constraints = 10;
+    *n_constraints = 14;
 
 }
 
@@ -398,6 +447,10 @@ static void wm_view_layer_get_size(struct wm_view* super, int* width, int* heigh
 
 static void wm_view_layer_request_size(struct wm_view* super, int width, int height){
     struct wm_view_layer* view = wm_cast(wm_view_layer, super);
+
+    /* Size is negotiated by wm_layer_arrange */
+    if(view->arranged) return;
+
     wlr_layer_surface_v1_configure(view->wlr_layer_surface, width, height);
 }
 
@@ -429,11 +482,6 @@ static void wm_view_layer_set_activated(struct wm_view* super, bool activated){
     }
 }
 
-static struct wlr_surface* wm_view_layer_surface_at(struct wm_view* super, double at_x, double at_y, double* sx, double* sy){
-    struct wm_view_layer* view = wm_cast(wm_view_layer, super);
-    return wlr_layer_surface_v1_surface_at(view->wlr_layer_surface, at_x, at_y, sx, sy);
-}
-
 static wm_surface_iterator_func_t __iterator;
 static void call_surface_iterator(struct wlr_surface* surface, int sx, int sy, void* data){
     __iterator(surface, sx, sy, false, data);
@@ -503,9 +551,12 @@ struct wm_view_vtable wm_view_layer_vtable = {
     .set_fullscreen = wm_view_layer_set_fullscreen,
     .set_maximized = wm_view_layer_set_maximized,
     .set_activated = wm_view_layer_set_activated,
-    .surface_at = wm_view_layer_surface_at,
     .for_each_surface = wm_view_layer_for_each_surface,
     .set_floating = wm_view_layer_set_floating,
     .get_parent = wm_view_layer_get_parent,
     .structure_printf = wm_view_layer_structure_printf
 };
+
+int wm_view_is_layer(struct wm_view* view){
+    return view->vtable == &wm_view_layer_vtable;
+}
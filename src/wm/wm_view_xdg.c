@@ -16,6 +16,7 @@
 #include "wm/wm_seat.h"
 #include "wm/wm_server.h"
 #include "wm/wm_layout.h"
+#include "wm/wm_transaction.h"
 #include "wm/wm.h"
 
 struct wm_view_vtable wm_view_xdg_vtable;
@@ -36,6 +37,7 @@ static void subsurface_handle_map(struct wl_listener* listener, void* data){
     struct wm_xdg_subsurface* subsurface = wl_container_of(listener, subsurface, map);
 
     if(!subsurface->toplevel) return;
+    wm_view_invalidate_input_map(&subsurface->toplevel->super);
 
     wm_layout_damage_from(
         subsurface->toplevel->super.super.wm_server->wm_layout,
@@ -47,11 +49,13 @@ static void subsurface_handle_unmap(struct wl_listener* listener, void* data){
     struct wm_xdg_subsurface* subsurface = wl_container_of(listener, subsurface, unmap);
 
     if(!subsurface->toplevel) return;
+    wm_view_invalidate_input_map(&subsurface->toplevel->super);
     wm_layout_damage_whole(subsurface->toplevel->super.super.wm_server->wm_layout);
 }
 
 static void subsurface_handle_destroy(struct wl_listener* listener, void* data){
     struct wm_xdg_subsurface* subsurface = wl_container_of(listener, subsurface, destroy);
+    if(subsurface->toplevel) wm_view_invalidate_input_map(&subsurface->toplevel->super);
     wm_xdg_subsurface_destroy(subsurface);
     free(subsurface);
 }
@@ -71,6 +75,7 @@ static void subsurface_handle_surface_commit(struct wl_listener* listener, void*
     struct wm_xdg_subsurface* subsurface = wl_container_of(listener, subsurface, surface_commit);
 
     if(!subsurface->toplevel) return;
+    wm_view_invalidate_input_map(&subsurface->toplevel->super);
 
     wm_layout_damage_from(
             subsurface->toplevel->super.super.wm_server->wm_layout,
@@ -82,6 +87,7 @@ static void popup_handle_map(struct wl_listener* listener, void* data){
     struct wm_popup_xdg* popup = wl_container_of(listener, popup, map);
 
     if(!popup->toplevel) return;
+    wm_view_invalidate_input_map(&popup->toplevel->super);
 
     wm_layout_damage_from(
         popup->toplevel->super.super.wm_server->wm_layout,
@@ -93,11 +99,13 @@ static void popup_handle_unmap(struct wl_listener* listener, void* data){
     struct wm_popup_xdg* popup = wl_container_of(listener, popup, unmap);
 
     if(!popup->toplevel) return;
+    wm_view_invalidate_input_map(&popup->toplevel->super);
     wm_layout_damage_whole(popup->toplevel->super.super.wm_server->wm_layout);
 }
 
 static void popup_handle_destroy(struct wl_listener* listener, void* data){
     struct wm_popup_xdg* popup = wl_container_of(listener, popup, destroy);
+    if(popup->toplevel) wm_view_invalidate_input_map(&popup->toplevel->super);
     wm_popup_xdg_destroy(popup);
     free(popup);
 }
@@ -128,6 +136,7 @@ static void popup_handle_surface_commit(struct wl_listener* listener, void* data
     struct wm_popup_xdg* popup = wl_container_of(listener, popup, surface_commit);
 
     if(!popup->toplevel) return;
+    wm_view_invalidate_input_map(&popup->toplevel->super);
 
     wm_layout_damage_from(
             popup->toplevel->super.super.wm_server->wm_layout,
@@ -141,7 +150,8 @@ static void popup_handle_surface_commit(struct wl_listener* listener, void* data
 static void handle_map(struct wl_listener* listener, void* data){
     struct wm_view_xdg* view = wl_container_of(listener, view, map);
 
-    view->super.mapped = true;
+    wm_view_set_mapped(&view->super, true);
+    wm_view_invalidate_input_map(&view->super);
 
     wm_layout_damage_from(
         view->super.super.wm_server->wm_layout,
@@ -151,7 +161,8 @@ static void handle_map(struct wl_listener* listener, void* data){
 
 static void handle_unmap(struct wl_listener* listener, void* data){
     struct wm_view_xdg* view = wl_container_of(listener, view, unmap);
-    view->super.mapped = false;
+    wm_view_set_mapped(&view->super, false);
+    wm_view_invalidate_input_map(&view->super);
 
     wm_layout_damage_whole(view->super.super.wm_server->wm_layout);
 }
@@ -272,11 +283,27 @@ static void handle_surface_commit(struct wl_listener* listener, void* data){
 #endif
 
     update |= possibly_update_size(view);
+    wm_view_root_committed(&view->super, view->wlr_xdg_surface->surface);
+
+    wm_transaction_view_committed(view->super.super.wm_server->wm_transaction,
+            &view->super, view->wlr_xdg_surface->current.configure_serial);
+
+    /* Serials wrap around */
+    uint32_t serial = view->wlr_xdg_surface->current.configure_serial;
+    if(view->super.resize.pending){
+        if((int32_t)(serial - view->resize_serial) >= 0){
+            wm_view_end_resize(&view->super);
+        }else if(serial != view->committed_serial){
+            wm_view_resize_committed(&view->super);
+        }
+    }
+    view->committed_serial = serial;
 
     if(update){
         wm_callback_update_view(&view->super);
     }
 
+    wm_view_invalidate_input_map(&view->super);
     wm_layout_damage_from(
             view->super.super.wm_server->wm_layout,
             &view->super.super, view->wlr_xdg_surface->surface);
@@ -594,7 +621,13 @@ static void wm_view_xdg_request_size(struct wm_view* super, int width, int heigh
             wlr_log(WLR_DEBUG, "DEBUG_SIZE: Request %dx%d", width, height);
         }
 #endif
-        wlr_xdg_toplevel_set_size(view->wlr_xdg_surface->toplevel, width, height);
+        uint32_t serial = wlr_xdg_toplevel_set_size(view->wlr_xdg_surface->toplevel, width, height);
+        wm_transaction_add_configure(view->super.super.wm_server->wm_transaction, super, serial);
+
+        if(view->super.mapped && (width != view->width || height != view->height || super->resize.pending)){
+            view->resize_serial = serial;
+            wm_view_begin_resize(super, width, height);
+        }
     }else{
         wlr_log(WLR_DEBUG, "Warning: Not toplevel");
     }
@@ -700,11 +733,6 @@ static void wm_view_xdg_focus(struct wm_view* super, struct wm_seat* seat){
     wm_seat_focus_surface(seat, view->wlr_xdg_surface->surface);
 }
 
-static struct wlr_surface* wm_view_xdg_surface_at(struct wm_view* super, double at_x, double at_y, double* sx, double* sy){
-    struct wm_view_xdg* view = wm_cast(wm_view_xdg, super);
-    return wlr_xdg_surface_surface_at(view->wlr_xdg_surface, at_x, at_y, sx, sy);
-}
-
 struct for_each_surface_data {
     wm_surface_iterator_func_t iterator;
     void* user_data;
@@ -884,7 +912,6 @@ struct wm_view_vtable wm_view_xdg_vtable = {
     .set_fullscreen = wm_view_xdg_set_fullscreen,
     .set_maximized = wm_view_xdg_set_maximized,
     .set_activated = wm_view_xdg_set_activated,
-    .surface_at = wm_view_xdg_surface_at,
     .for_each_surface = wm_view_xdg_for_each_surface,
     .set_floating = wm_view_xdg_set_floating,
     .get_parent = wm_view_xdg_get_parent,
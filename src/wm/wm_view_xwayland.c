@@ -18,51 +18,17 @@
 struct wm_view_vtable wm_view_xwayland_vtable;
 
 static void try_to_find_parent(struct wm_view_xwayland* view){
+    struct wm_xwayland_index* index = view->super.super.wm_server->wm_xwayland_index;
     struct wm_view_xwayland* parent = NULL;
-    
+
     if(view->wlr_xwayland_surface->parent){
-        unsigned int parent_id = view->wlr_xwayland_surface->parent->window_id;
-        struct wm_content* it;
-        wl_list_for_each(it, &view->super.super.wm_server->wm_contents, link){
-            if(it->vtable != view->super.super.vtable) continue;
-            struct wm_view* it_view = wm_cast(wm_view, it);
-            if(it_view->vtable != view->super.vtable) continue;
-            struct wm_view_xwayland* it_xwayland = wm_cast(wm_view_xwayland, it_view);
-            if(it_xwayland->wlr_xwayland_surface->window_id == parent_id){
-                parent = it_xwayland;
-                goto Found;
-            }
-
-            struct wm_view_xwayland_child* sibling;
-            wl_list_for_each(sibling, &it_xwayland->children, link){
-                if(sibling->wlr_xwayland_surface->window_id == parent_id){
-                    parent = it_xwayland;
-                    goto Found;
-                }
-            }
-        }
+        parent = wm_xwayland_index_find_window(index, view->wlr_xwayland_surface->parent->window_id);
     }
 
-    if(view->wlr_xwayland_surface->pid){
-        struct wm_content* it;
-        wl_list_for_each(it, &view->super.super.wm_server->wm_contents, link){
-            if(it->vtable != view->super.super.vtable) continue;
-            struct wm_view* it_view = wm_cast(wm_view, it);
-            if(!it_view->mapped) continue;
-
-            if(it_view->vtable != view->super.vtable) continue;
-            struct wm_view_xwayland* it_xwayland = wm_cast(wm_view_xwayland, it_view);
-            if(it_xwayland == view) continue;
-
-            if(it_xwayland->wlr_xwayland_surface->pid == view->wlr_xwayland_surface->pid){
-                parent = it_xwayland;
-                goto Found;
-            }
-        }
+    if(!parent && view->wlr_xwayland_surface->pid){
+        parent = wm_xwayland_index_find_pid(index, view->wlr_xwayland_surface->pid, view);
     }
 
-Found:
-
     if(parent){
         if(!view->wlr_xwayland_surface->override_redirect){
             /* Child view */
@@ -87,6 +53,7 @@ Found:
 static void child_handle_map(struct wl_listener* listener, void* data){
     struct wm_view_xwayland_child* child = wl_container_of(listener, child, map);
     child->mapped = true;
+    wm_view_invalidate_input_map(&child->parent->super);
 
     wm_layout_damage_from(
         child->parent->super.super.wm_server->wm_layout,
@@ -101,11 +68,23 @@ static void child_handle_request_configure(struct wl_listener* listener, void* d
     struct wlr_xwayland_surface_configure_event* event = data;
 
     wlr_xwayland_surface_configure(child->wlr_xwayland_surface, event->x, event->y, event->width, event->height);
+    wm_view_invalidate_input_map(&child->parent->super);
+}
+
+/* Override-redirect windows move themselves, possibly without a new commit */
+static void child_handle_set_geometry(struct wl_listener* listener, void* data){
+    struct wm_view_xwayland_child* child = wl_container_of(listener, child, set_geometry);
+    wm_view_invalidate_input_map(&child->parent->super);
+
+    if(child->mapped){
+        wm_layout_damage_whole(child->parent->super.super.wm_server->wm_layout);
+    }
 }
 
 static void child_handle_unmap(struct wl_listener* listener, void* data){
     struct wm_view_xwayland_child* child = wl_container_of(listener, child, unmap);
     child->mapped = false;
+    wm_view_invalidate_input_map(&child->parent->super);
 
     wm_layout_damage_whole(
         child->parent->super.super.wm_server->wm_layout);
@@ -113,11 +92,13 @@ static void child_handle_unmap(struct wl_listener* listener, void* data){
 
 static void child_handle_destroy(struct wl_listener* listener, void* data){
     struct wm_view_xwayland_child* child = wl_container_of(listener, child, destroy);
+    wm_view_invalidate_input_map(&child->parent->super);
     wm_view_xwayland_child_destroy(child);
 }
 
 static void child_handle_surface_commit(struct wl_listener* listener, void* data){
     struct wm_view_xwayland_child* child = wl_container_of(listener, child, surface_commit);
+    wm_view_invalidate_input_map(&child->parent->super);
 
     wm_layout_damage_from(
         child->parent->super.super.wm_server->wm_layout,
@@ -131,11 +112,26 @@ static void handle_request_configure(struct wl_listener* listener, void* data){
     struct wlr_box box;
     wlr_output_layout_get_box(view->super.super.wm_server->wm_layout->wlr_output_layout, NULL, &box);
     wlr_xwayland_surface_configure(view->wlr_xwayland_surface, box.x, box.y, event->width, event->height);
+
+    /* Children are positioned relative to the view */
+    wm_view_invalidate_input_map(&view->super);
+}
+
+static void handle_set_geometry(struct wl_listener* listener, void* data){
+    struct wm_view_xwayland* view = wl_container_of(listener, view, set_geometry);
+
+    /* Children are positioned relative to the view */
+    wm_view_invalidate_input_map(&view->super);
 }
 
 static void handle_set_pid(struct wl_listener* listener, void* data){
     struct wm_view_xwayland* view = wl_container_of(listener, view, set_pid);
 
+    if(view->super.mapped){
+        wm_xwayland_index_add_pid(view->super.super.wm_server->wm_xwayland_index,
+                &view->pid_entry, view->wlr_xwayland_surface->pid, view);
+    }
+
     try_to_find_parent(view);
 }
 
@@ -155,7 +151,13 @@ static void handle_map(struct wl_listener* listener, void* data){
     wlr_log(WLR_DEBUG, "New wm_view (xwayland): %s, %s, %s", title, app_id, role);
 
     wm_callback_init_view(&view->super);
-    view->super.mapped = true;
+    wm_view_set_mapped(&view->super, true);
+    wm_view_invalidate_input_map(&view->super);
+
+    if(view->wlr_xwayland_surface->pid){
+        wm_xwayland_index_add_pid(view->super.super.wm_server->wm_xwayland_index,
+                &view->pid_entry, view->wlr_xwayland_surface->pid, view);
+    }
 
     wm_layout_damage_from(
         view->super.super.wm_server->wm_layout,
@@ -167,7 +169,9 @@ static void handle_map(struct wl_listener* listener, void* data){
 
 static void handle_unmap(struct wl_listener* listener, void* data){
     struct wm_view_xwayland* view = wl_container_of(listener, view, unmap);
-    view->super.mapped = false;
+    wm_view_set_mapped(&view->super, false);
+    wm_view_invalidate_input_map(&view->super);
+    wm_xwayland_index_remove(&view->pid_entry);
 
     wm_layout_damage_whole(view->super.super.wm_server->wm_layout);
 }
@@ -182,6 +186,8 @@ static void handle_destroy(struct wl_listener* listener, void* data){
 
 static void handle_surface_commit(struct wl_listener* listener, void* data){
     struct wm_view_xwayland* view = wl_container_of(listener, view, surface_commit);
+    wm_view_invalidate_input_map(&view->super);
+    wm_view_root_committed(&view->super, view->wlr_xwayland_surface->surface);
 
     wm_layout_damage_from(
             view->super.super.wm_server->wm_layout,
@@ -202,6 +208,9 @@ void wm_view_xwayland_child_init(struct wm_view_xwayland_child* child, struct wm
     child->request_configure.notify = &child_handle_request_configure;
     wl_signal_add(&surface->events.request_configure, &child->request_configure);
 
+    child->set_geometry.notify = &child_handle_set_geometry;
+    wl_signal_add(&surface->events.set_geometry, &child->set_geometry);
+
     child->unmap.notify = &child_handle_unmap;
     wl_signal_add(&surface->events.unmap, &child->unmap);
 
@@ -212,16 +221,23 @@ void wm_view_xwayland_child_init(struct wm_view_xwayland_child* child, struct wm
     /* Signal is added on map */
 
     wl_list_insert(&parent->children, &child->link);
+    wm_view_invalidate_input_map(&parent->super);
+
+    wm_xwayland_index_entry_init(&child->window_entry);
+    wm_xwayland_index_add_window(parent->super.super.wm_server->wm_xwayland_index,
+            &child->window_entry, surface->window_id, parent);
 }
 
 void wm_view_xwayland_child_destroy(struct wm_view_xwayland_child* child){
     wl_list_remove(&child->request_configure.link);
+    wl_list_remove(&child->set_geometry.link);
     wl_list_remove(&child->map.link);
     wl_list_remove(&child->unmap.link);
     wl_list_remove(&child->destroy.link);
     if(child->mapped) wl_list_remove(&child->surface_commit.link);
 
     wl_list_remove(&child->link);
+    wm_xwayland_index_remove(&child->window_entry);
 }
 
 void wm_view_xwayland_init(struct wm_view_xwayland* view, struct wm_server* server, struct wlr_xwayland_surface* surface){
@@ -238,6 +254,9 @@ void wm_view_xwayland_init(struct wm_view_xwayland* view, struct wm_server* serv
     view->request_configure.notify = &handle_request_configure;
     wl_signal_add(&surface->events.request_configure, &view->request_configure);
 
+    view->set_geometry.notify = &handle_set_geometry;
+    wl_signal_add(&surface->events.set_geometry, &view->set_geometry);
+
     view->set_parent.notify = &handle_set_parent;
     wl_signal_add(&surface->events.set_parent, &view->set_parent);
 
@@ -256,18 +275,31 @@ void wm_view_xwayland_init(struct wm_view_xwayland* view, struct wm_server* serv
     view->surface_commit.notify = &handle_surface_commit;
     /* signal is added on map */
 
+    wm_xwayland_index_entry_init(&view->window_entry);
+    wm_xwayland_index_entry_init(&view->pid_entry);
+    wm_xwayland_index_add_window(server->wm_xwayland_index, &view->window_entry, surface->window_id, view);
 }
 
 static void wm_view_xwayland_destroy(struct wm_view* super){
     struct wm_view_xwayland* view = wm_cast(wm_view_xwayland, super);
 
     wl_list_remove(&view->request_configure.link);
+    wl_list_remove(&view->set_geometry.link);
     wl_list_remove(&view->set_pid.link);
     wl_list_remove(&view->set_parent.link);
     wl_list_remove(&view->map.link);
     wl_list_remove(&view->unmap.link);
     wl_list_remove(&view->destroy.link);
     if(view->super.mapped) wl_list_remove(&view->surface_commit.link);
+
+    wm_xwayland_index_remove(&view->window_entry);
+    wm_xwayland_index_remove(&view->pid_entry);
+
+    /* Children outliving the view must not resolve to it */
+    struct wm_view_xwayland_child* child;
+    wl_list_for_each(child, &view->children, link){
+        wm_xwayland_index_remove(&child->window_entry);
+    }
 }
 
 static void wm_view_xwayland_get_credentials(struct wm_view* super, pid_t* pid, uid_t* uid, gid_t* gid){
@@ -366,32 +398,6 @@ static void wm_view_xwayland_focus(struct wm_view* super, struct wm_seat* seat){
     wm_view_xwayland_set_activated(super, true);
 }
 
-static struct wlr_surface* wm_view_xwayland_surface_at(struct wm_view* super, double at_x, double at_y, double* sx, double* sy){
-    struct wm_view_xwayland* view = wm_cast(wm_view_xwayland, super);
-
-    struct wm_view_xwayland_child* child;
-    wl_list_for_each(child, &view->children, link){
-        if(!child->wlr_xwayland_surface->surface) continue;
-
-        int child_x = child->wlr_xwayland_surface->x - view->wlr_xwayland_surface->x;
-        int child_y = child->wlr_xwayland_surface->y - view->wlr_xwayland_surface->y;
-        struct wlr_surface* surface = wlr_surface_surface_at(child->wlr_xwayland_surface->surface, 
-                at_x - child_x, at_y - child_y, sx, sy);
-
-        if(surface){
-            return surface;
-        }
-    }
-
-    struct wlr_surface* surface = wlr_surface_surface_at(view->wlr_xwayland_surface->surface, at_x, at_y, sx, sy);
-    if(surface){
-        return surface;
-    }
-
-    return NULL;
-}
-
-
 struct child_iterator_data {
     void* user_data;
     struct wm_view_xwayland_child* child;
@@ -465,7 +471,6 @@ struct wm_view_vtable wm_view_xwayland_vtable = {
     .set_fullscreen = wm_view_xwayland_set_fullscreen,
     .set_maximized = wm_view_xwayland_set_maximized,
     .set_activated = wm_view_xwayland_set_activated,
-    .surface_at = wm_view_xwayland_surface_at,
     .for_each_surface = wm_view_xwayland_for_each_surface,
     .set_floating = wm_view_xwayland_set_floating,
     .get_parent = wm_view_xwayland_get_parent,
@@ -7,6 +7,7 @@
 #include "wm/wm_output.h"
 #include "wm/wm_renderer.h"
 #include "wm/wm_layout.h"
+#include "wm/wm_atlas.h"
 
 #include "wm/wm_util.h"
 
@@ -17,6 +18,7 @@ void wm_widget_init(struct wm_widget* widget, struct wm_server* server){
     widget->super.vtable = &wm_widget_vtable;
 
     widget->wlr_texture = NULL;
+    widget->atlas_region = NULL;
 
     widget->primitive.name = NULL;
     widget->primitive.params_int = NULL;
@@ -26,6 +28,9 @@ void wm_widget_init(struct wm_widget* widget, struct wm_server* server){
 static void wm_widget_destroy(struct wm_content* super){
     struct wm_widget* widget = wm_cast(wm_widget, super);
     wlr_texture_destroy(widget->wlr_texture);
+    if(widget->atlas_region){
+        wm_atlas_remove(widget->super.wm_server->wm_renderer->wm_atlas, widget->atlas_region);
+    }
 
     free(widget->primitive.name);
     free(widget->primitive.params_int);
@@ -35,11 +40,32 @@ static void wm_widget_destroy(struct wm_content* super){
 }
 
 void wm_widget_set_pixels(struct wm_widget* widget, uint32_t format, uint32_t stride, uint32_t width, uint32_t height, const void* data){
-    if(widget->wlr_texture){
-        wlr_texture_write_pixels(widget->wlr_texture, stride, width, height, 0, 0, 0, 0, data);
-    }else{
-        widget->wlr_texture = wlr_texture_from_pixels(widget->super.wm_server->wm_renderer->wlr_renderer,
-                format, stride, width, height, data);
+    struct wm_atlas* atlas = widget->super.wm_server->wm_renderer->wm_atlas;
+
+    /* Try to update in place */
+    bool updated = false;
+    if(widget->atlas_region){
+        updated = wm_atlas_update(atlas, widget->atlas_region, format, stride, width, height, data);
+        if(!updated){
+            wm_atlas_remove(atlas, widget->atlas_region);
+            widget->atlas_region = NULL;
+        }
+    }else if(widget->wlr_texture && widget->wlr_texture->width == width && widget->wlr_texture->height == height){
+        updated = wlr_texture_write_pixels(widget->wlr_texture, stride, width, height, 0, 0, 0, 0, data);
+    }
+
+    if(!updated){
+        if(widget->wlr_texture){
+            wlr_texture_destroy(widget->wlr_texture);
+            widget->wlr_texture = NULL;
+        }
+
+        /* Small buffers share atlas pages, large ones get their own texture */
+        widget->atlas_region = wm_atlas_add(atlas, format, stride, width, height, data);
+        if(!widget->atlas_region){
+            widget->wlr_texture = wlr_texture_from_pixels(widget->super.wm_server->wm_renderer->wlr_renderer,
+                    format, stride, width, height, data);
+        }
     }
     wm_widget_set_primitive(widget, NULL, 0, NULL, 0, NULL);
 
@@ -66,6 +92,10 @@ void wm_widget_set_primitive(struct wm_widget* widget, char* name, int n_params_
         wlr_texture_destroy(widget->wlr_texture);
         widget->wlr_texture = NULL;
     }
+    if(name && widget->atlas_region){
+        wm_atlas_remove(widget->super.wm_server->wm_renderer->wm_atlas, widget->atlas_region);
+        widget->atlas_region = NULL;
+    }
 
     wm_layout_damage_from(widget->super.wm_server->wm_layout, &widget->super, NULL);
 }
@@ -77,31 +107,36 @@ static void wm_widget_render(struct wm_content* super, struct wm_output* output,
     double display_x, display_y, display_w, display_h;
     wm_content_get_box(&widget->super, &display_x, &display_y, &display_w, &display_h);
 
-    struct wlr_box box = {
-        .x = round((display_x - output->layout_x) * output->wlr_output->scale),
-        .y = round((display_y - output->layout_y) * output->wlr_output->scale),
-        .width = round(display_w * output->wlr_output->scale),
-        .height = round(display_h * output->wlr_output->scale)};
+    struct wlr_box box;
+    wm_output_snap_box(output, display_x - output->layout_x, display_y - output->layout_y, display_w, display_h, &box);
 
-    if (widget->wlr_texture){
+    if (widget->wlr_texture || widget->atlas_region){
 
         double mask_x, mask_y, mask_w, mask_h;
         wm_content_get_mask(&widget->super, &mask_x, &mask_y, &mask_w, &mask_h);
 
-        struct wlr_box mask = {
-            .x = round((display_x - output->layout_x + mask_x) * output->wlr_output->scale),
-            .y = round((display_y - output->layout_y + mask_y) * output->wlr_output->scale),
-            .width = round(mask_w * output->wlr_output->scale),
-            .height = round(mask_h * output->wlr_output->scale)};
+        struct wlr_box mask;
+        wm_output_snap_box(output, display_x - output->layout_x + mask_x, display_y - output->layout_y + mask_y,
+                mask_w, mask_h, &mask);
 
-        double corner_radius =
+        double corner_radius = !wm_output_renders_corners(output) ? 0. :
             wm_content_get_corner_radius(&widget->super) * output->wlr_output->scale;
 
-        wm_renderer_render_texture_at(
-                output->wm_server->wm_renderer, output_damage,
-                NULL, widget->wlr_texture, &box,
-                wm_content_get_opacity(super), &mask, corner_radius,
-                super->lock_enabled ? 0.0 : super->wm_server->lock_perc);
+        if(widget->atlas_region){
+            struct wlr_fbox source;
+            wm_atlas_region_get_source_box(widget->atlas_region, &source);
+            wm_renderer_render_subtexture_at(
+                    output->wm_server->wm_renderer, output_damage,
+                    wm_atlas_region_get_texture(widget->atlas_region), &source, &box,
+                    wm_content_get_opacity(super), &mask, corner_radius,
+                    super->lock_enabled ? 0.0 : super->wm_server->lock_perc);
+        }else{
+            wm_renderer_render_texture_at(
+                    output->wm_server->wm_renderer, output_damage,
+                    NULL, widget->wlr_texture, &box,
+                    wm_content_get_opacity(super), &mask, corner_radius,
+                    super->lock_enabled ? 0.0 : super->wm_server->lock_perc);
+        }
     }else if(widget->primitive.name){
 #ifdef WM_CUSTOM_RENDERER
         wm_renderer_select_primitive_shader(output->wm_server->wm_renderer, widget->primitive.name);
@@ -124,5 +159,6 @@ struct wm_content_vtable wm_widget_vtable = {
     .destroy = &wm_widget_destroy,
     .render = &wm_widget_render,
     .damage_output = NULL,
+    .extents = NULL,
     .printf = &wm_widget_printf
 };
@@ -0,0 +1,70 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <wayland-server.h>
+
+#include "wm/wm_xwayland_index.h"
+
+static struct wl_list* bucket(struct wl_list* buckets, uint32_t key){
+    /* Fibonacci hashing - window ids are sequential per client */
+    return &buckets[(uint32_t)(key * 2654435761u) >> (32 - WM_XWAYLAND_INDEX_BITS)];
+}
+
+static void add(struct wl_list* buckets, struct wm_xwayland_index_entry* entry, uint32_t key, struct wm_view_xwayland* view){
+    wm_xwayland_index_remove(entry);
+
+    entry->key = key;
+    entry->view = view;
+    entry->indexed = true;
+    wl_list_insert(bucket(buckets, key), &entry->link);
+}
+
+/*
+ * Class implementation
+ */
+void wm_xwayland_index_init(struct wm_xwayland_index* index){
+    for(int i=0; i<WM_XWAYLAND_INDEX_BUCKETS; i++){
+        wl_list_init(&index->window_buckets[i]);
+        wl_list_init(&index->pid_buckets[i]);
+    }
+}
+
+void wm_xwayland_index_entry_init(struct wm_xwayland_index_entry* entry){
+    entry->indexed = false;
+    entry->key = 0;
+    entry->view = NULL;
+}
+
+void wm_xwayland_index_add_window(struct wm_xwayland_index* index, struct wm_xwayland_index_entry* entry,
+        uint32_t window_id, struct wm_view_xwayland* view){
+    add(index->window_buckets, entry, window_id, view);
+}
+
+void wm_xwayland_index_add_pid(struct wm_xwayland_index* index, struct wm_xwayland_index_entry* entry,
+        pid_t pid, struct wm_view_xwayland* view){
+    add(index->pid_buckets, entry, pid, view);
+}
+
+void wm_xwayland_index_remove(struct wm_xwayland_index_entry* entry){
+    if(!entry->indexed) return;
+
+    wl_list_remove(&entry->link);
+    entry->indexed = false;
+}
+
+struct wm_view_xwayland* wm_xwayland_index_find_window(struct wm_xwayland_index* index, uint32_t window_id){
+    struct wm_xwayland_index_entry* entry;
+    wl_list_for_each(entry, bucket(index->window_buckets, window_id), link){
+        if(entry->key == window_id) return entry->view;
+    }
+    return NULL;
+}
+
+struct wm_view_xwayland* wm_xwayland_index_find_pid(struct wm_xwayland_index* index, pid_t pid,
+        struct wm_view_xwayland* exclude){
+    struct wm_xwayland_index_entry* entry;
+    wl_list_for_each(entry, bucket(index->pid_buckets, pid), link){
+        if(entry->key == (uint32_t)pid && entry->view != exclude) return entry->view;
+    }
+    return NULL;
+}